@@ -0,0 +1,106 @@
+#include "adpcm.h"
+
+// Tablas estándar IMA (iguales en hello_world_small.c)
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const uint16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+void adpcm_reset(adpcm_state_t state[2]) {
+    state[0].predictor = 0;
+    state[0].index = 0;
+    state[1] = state[0];
+}
+
+uint32_t adpcm_encoded_size(uint32_t frames) {
+    uint32_t blocks = (frames + ADPCM_BLOCK_FRAMES - 1) / ADPCM_BLOCK_FRAMES;
+    return blocks * ADPCM_HEADER_SIZE + frames;
+}
+
+int16_t adpcm_decode_nibble(adpcm_state_t *state, uint32_t nibble) {
+    int32_t step = step_table[state->index];
+    int32_t diff = step >> 3;
+
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+
+    if (nibble & 8) {
+        state->predictor -= diff;
+        if (state->predictor < -32768) state->predictor = -32768;
+    } else {
+        state->predictor += diff;
+        if (state->predictor > 32767) state->predictor = 32767;
+    }
+
+    state->index += index_table[nibble];
+    if (state->index < 0) state->index = 0;
+    if (state->index > 88) state->index = 88;
+
+    return (int16_t)state->predictor;
+}
+
+// Elige el nibble y avanza el estado con el mismo cálculo que el decodificador,
+// así encoder y Nios nunca divergen
+static uint32_t encode_sample(adpcm_state_t *state, int32_t sample) {
+    int32_t step = step_table[state->index];
+    int32_t delta = sample - state->predictor;
+    uint32_t nibble = 0;
+
+    if (delta < 0) {
+        nibble = 8;
+        delta = -delta;
+    }
+    if (delta >= step) {
+        nibble |= 4;
+        delta -= step;
+    }
+    if (delta >= (step >> 1)) {
+        nibble |= 2;
+        delta -= step >> 1;
+    }
+    if (delta >= (step >> 2)) {
+        nibble |= 1;
+    }
+
+    adpcm_decode_nibble(state, nibble);
+    return nibble;
+}
+
+static void write_header(const adpcm_state_t *state, uint8_t *out) {
+    out[0] = (uint8_t)(state->predictor & 0xFF);
+    out[1] = (uint8_t)((state->predictor >> 8) & 0xFF);
+    out[2] = (uint8_t)state->index;
+    out[3] = 0;
+}
+
+uint32_t adpcm_encode_stereo(adpcm_state_t state[2], const int16_t *in,
+                             uint32_t frames, uint8_t *out) {
+    uint32_t written = 0;
+
+    for (uint32_t i = 0; i < frames; i++) {
+        if ((i % ADPCM_BLOCK_FRAMES) == 0) {
+            write_header(&state[0], out + written);
+            write_header(&state[1], out + written + 4);
+            written += ADPCM_HEADER_SIZE;
+        }
+
+        uint32_t left = encode_sample(&state[0], in[2 * i]);
+        uint32_t right = encode_sample(&state[1], in[2 * i + 1]);
+        out[written++] = (uint8_t)(left | (right << 4));
+    }
+
+    return written;
+}
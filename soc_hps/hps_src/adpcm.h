@@ -0,0 +1,35 @@
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#include <stdint.h>
+
+// Transporte IMA-ADPCM 4:1 hacia el Nios.
+// El chunk se divide en bloques de 1 KB autocontenidos para que el Nios
+// pueda resincronizar el estado al inicio de cada bloque:
+//   [pred L int16][idx L u8][0][pred R int16][idx R u8][0]  (8 bytes)
+//   1016 bytes: un byte por frame, nibble bajo = L, nibble alto = R
+// El estado de cabecera es el del predictor ANTES del primer frame del bloque.
+
+#define ADPCM_BLOCK_SIZE         1024
+#define ADPCM_HEADER_SIZE        8
+#define ADPCM_BLOCK_FRAMES       (ADPCM_BLOCK_SIZE - ADPCM_HEADER_SIZE)
+
+typedef struct {
+    int32_t predictor;
+    int32_t index;
+} adpcm_state_t;
+
+void adpcm_reset(adpcm_state_t state[2]);
+
+// Bytes que ocupan 'frames' frames estéreo codificados
+uint32_t adpcm_encoded_size(uint32_t frames);
+
+// Codifica 'frames' frames estéreo de 16 bits. El estado se conserva entre
+// llamadas. Devuelve los bytes escritos en 'out'.
+uint32_t adpcm_encode_stereo(adpcm_state_t state[2], const int16_t *in,
+                             uint32_t frames, uint8_t *out);
+
+// Decodificador de referencia, idéntico al del Nios (solo sumas y shifts)
+int16_t adpcm_decode_nibble(adpcm_state_t *state, uint32_t nibble);
+
+#endif /* ADPCM_H */
@@ -0,0 +1,446 @@
+#include <string.h>
+#include "audio_dsp.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+static int32_t volume_to_gain(uint32_t volume_percent) {
+    if (volume_percent > VOLUME_MAX) {
+        volume_percent = VOLUME_MAX;
+    }
+    return (int32_t)((volume_percent * LIMITER_UNITY_GAIN) / 100);
+}
+
+// Ganancia máxima (Q12) que mantiene el pico por debajo del techo
+static int32_t safe_gain(int32_t peak) {
+    if (peak <= 0) {
+        return INT32_MAX;
+    }
+    return (int32_t)(((int64_t)LIMITER_CEILING * LIMITER_UNITY_GAIN) / peak);
+}
+
+// --- Kernels ---
+
+int32_t dsp_peak_s16(const int16_t *samples, uint32_t count) {
+    uint32_t i = 0;
+    int32_t peak = 0;
+
+#ifdef __ARM_NEON
+    int16x8_t vmax = vdupq_n_s16(0);
+    for (; i + 8 <= count; i += 8) {
+        vmax = vmaxq_s16(vmax, vqabsq_s16(vld1q_s16(samples + i)));
+    }
+    int16x4_t m = vmax_s16(vget_low_s16(vmax), vget_high_s16(vmax));
+    m = vpmax_s16(m, m);
+    m = vpmax_s16(m, m);
+    peak = vget_lane_s16(m, 0);
+#endif
+
+    for (; i < count; i++) {
+        int32_t v = samples[i];
+        if (v < 0) v = -v;
+        if (v > peak) peak = v;
+    }
+    return peak;
+}
+
+void dsp_minmax_s16(const int16_t *samples, uint32_t count, int16_t *min, int16_t *max) {
+    uint32_t i = 0;
+    int16_t lo = INT16_MAX, hi = INT16_MIN;
+
+#ifdef __ARM_NEON
+    if (count >= 8) {
+        int16x8_t vmin = vdupq_n_s16(INT16_MAX);
+        int16x8_t vmax = vdupq_n_s16(INT16_MIN);
+        for (; i + 8 <= count; i += 8) {
+            int16x8_t x = vld1q_s16(samples + i);
+            vmin = vminq_s16(vmin, x);
+            vmax = vmaxq_s16(vmax, x);
+        }
+        int16x4_t m = vmin_s16(vget_low_s16(vmin), vget_high_s16(vmin));
+        m = vpmin_s16(m, m);
+        m = vpmin_s16(m, m);
+        lo = vget_lane_s16(m, 0);
+        int16x4_t n = vmax_s16(vget_low_s16(vmax), vget_high_s16(vmax));
+        n = vpmax_s16(n, n);
+        n = vpmax_s16(n, n);
+        hi = vget_lane_s16(n, 0);
+    }
+#endif
+
+    for (; i < count; i++) {
+        if (samples[i] < lo) lo = samples[i];
+        if (samples[i] > hi) hi = samples[i];
+    }
+    *min = lo;
+    *max = hi;
+}
+
+// Aplica una rampa lineal de ganancia (Q12) por frame: el frame i recibe
+// gain_start + (gain_end - gain_start) * (i + 1) / frames. Satura a 16 bits.
+void dsp_gain_ramp_stereo_s16(const int16_t *in, int16_t *out, uint32_t frames,
+                              int32_t gain_start, int32_t gain_end) {
+    if (frames == 0) {
+        return;
+    }
+
+    // Rampa interna en Q20 para no perder resolución en el paso
+    int32_t g = gain_start << 8;
+    int32_t step = ((gain_end - gain_start) << 8) / (int32_t)frames;
+    uint32_t i = 0;
+
+#ifdef __ARM_NEON
+    int32x4_t vg = { g + step, g + 2 * step, g + 3 * step, g + 4 * step };
+    int32x4_t vstep = vdupq_n_s32(4 * step);
+    for (; i + 4 <= frames; i += 4) {
+        int16x4_t g4 = vshrn_n_s32(vg, 8);
+        int16x4x2_t gz = vzip_s16(g4, g4);      // L/R comparten ganancia
+        int16x8_t x = vld1q_s16(in + 2 * i);
+        int32x4_t lo = vmull_s16(vget_low_s16(x), gz.val[0]);
+        int32x4_t hi = vmull_s16(vget_high_s16(x), gz.val[1]);
+        vst1q_s16(out + 2 * i, vcombine_s16(vqrshrn_n_s32(lo, 12), vqrshrn_n_s32(hi, 12)));
+        vg = vaddq_s32(vg, vstep);
+    }
+    g += (int32_t)i * step;
+#endif
+
+    for (; i < frames; i++) {
+        g += step;
+        int32_t g12 = g >> 8;
+        for (int ch = 0; ch < 2; ch++) {
+            int32_t v = ((int32_t)in[2 * i + ch] * g12 + (1 << 11)) >> 12;
+            if (v > 32767) v = 32767;
+            if (v < -32768) v = -32768;
+            out[2 * i + ch] = (int16_t)v;
+        }
+    }
+}
+
+// Suma de dos entradas, cada una con su rampa lineal (Q12, mismo criterio
+// que dsp_gain_ramp_stereo_s16). 'out' puede ser 'b'.
+void dsp_mix_ramp_stereo_s16(const int16_t *a, const int16_t *b, int16_t *out, uint32_t frames,
+                             int32_t a_start, int32_t a_end, int32_t b_start, int32_t b_end) {
+    if (frames == 0) {
+        return;
+    }
+
+    int32_t ga = a_start << 8, gb = b_start << 8;
+    int32_t step_a = ((a_end - a_start) << 8) / (int32_t)frames;
+    int32_t step_b = ((b_end - b_start) << 8) / (int32_t)frames;
+    uint32_t i = 0;
+
+#ifdef __ARM_NEON
+    int32x4_t vga = { ga + step_a, ga + 2 * step_a, ga + 3 * step_a, ga + 4 * step_a };
+    int32x4_t vgb = { gb + step_b, gb + 2 * step_b, gb + 3 * step_b, gb + 4 * step_b };
+    int32x4_t vstep_a = vdupq_n_s32(4 * step_a);
+    int32x4_t vstep_b = vdupq_n_s32(4 * step_b);
+    for (; i + 4 <= frames; i += 4) {
+        int16x4_t ga4 = vshrn_n_s32(vga, 8);
+        int16x4_t gb4 = vshrn_n_s32(vgb, 8);
+        int16x4x2_t gaz = vzip_s16(ga4, ga4);
+        int16x4x2_t gbz = vzip_s16(gb4, gb4);
+        int16x8_t xa = vld1q_s16(a + 2 * i);
+        int16x8_t xb = vld1q_s16(b + 2 * i);
+        int32x4_t lo = vmull_s16(vget_low_s16(xa), gaz.val[0]);
+        int32x4_t hi = vmull_s16(vget_high_s16(xa), gaz.val[1]);
+        lo = vmlal_s16(lo, vget_low_s16(xb), gbz.val[0]);
+        hi = vmlal_s16(hi, vget_high_s16(xb), gbz.val[1]);
+        vst1q_s16(out + 2 * i, vcombine_s16(vqrshrn_n_s32(lo, 12), vqrshrn_n_s32(hi, 12)));
+        vga = vaddq_s32(vga, vstep_a);
+        vgb = vaddq_s32(vgb, vstep_b);
+    }
+    ga += (int32_t)i * step_a;
+    gb += (int32_t)i * step_b;
+#endif
+
+    for (; i < frames; i++) {
+        ga += step_a;
+        gb += step_b;
+        int32_t ga12 = ga >> 8, gb12 = gb >> 8;
+        for (int ch = 0; ch < 2; ch++) {
+            int32_t v = ((int32_t)a[2 * i + ch] * ga12 + (int32_t)b[2 * i + ch] * gb12 + (1 << 11)) >> 12;
+            if (v > 32767) v = 32767;
+            if (v < -32768) v = -32768;
+            out[2 * i + ch] = (int16_t)v;
+        }
+    }
+}
+
+// Acumula 'in' con rampa lineal (Q12) en 'acc', que queda en Q12. La suma
+// satura a 32 bits: con varias fuentes a +12 dB se puede pasar.
+void dsp_mix_accumulate_s16(int32_t *acc, const int16_t *in, uint32_t frames,
+                            int32_t gain_start, int32_t gain_end) {
+    if (frames == 0) {
+        return;
+    }
+
+    int32_t g = gain_start << 8;
+    int32_t step = ((gain_end - gain_start) << 8) / (int32_t)frames;
+    uint32_t i = 0;
+
+#ifdef __ARM_NEON
+    int32x4_t vg = { g + step, g + 2 * step, g + 3 * step, g + 4 * step };
+    int32x4_t vstep = vdupq_n_s32(4 * step);
+    for (; i + 4 <= frames; i += 4) {
+        int16x4_t g4 = vshrn_n_s32(vg, 8);
+        int16x4x2_t gz = vzip_s16(g4, g4);
+        int16x8_t x = vld1q_s16(in + 2 * i);
+        int32x4_t lo = vqaddq_s32(vld1q_s32(acc + 2 * i), vmull_s16(vget_low_s16(x), gz.val[0]));
+        int32x4_t hi = vqaddq_s32(vld1q_s32(acc + 2 * i + 4), vmull_s16(vget_high_s16(x), gz.val[1]));
+        vst1q_s32(acc + 2 * i, lo);
+        vst1q_s32(acc + 2 * i + 4, hi);
+        vg = vaddq_s32(vg, vstep);
+    }
+    g += (int32_t)i * step;
+#endif
+
+    for (; i < frames; i++) {
+        g += step;
+        int32_t g12 = g >> 8;
+        for (int ch = 0; ch < 2; ch++) {
+            int64_t v = (int64_t)acc[2 * i + ch] + (int32_t)in[2 * i + ch] * g12;
+            if (v > INT32_MAX) v = INT32_MAX;
+            if (v < INT32_MIN) v = INT32_MIN;
+            acc[2 * i + ch] = (int32_t)v;
+        }
+    }
+}
+
+// Mezcla acumulada (Q12) a 16 bits con redondeo y saturación
+void dsp_mix_store_s16(const int32_t *acc, int16_t *out, uint32_t samples) {
+    uint32_t i = 0;
+
+#ifdef __ARM_NEON
+    for (; i + 8 <= samples; i += 8) {
+        int16x4_t lo = vqrshrn_n_s32(vld1q_s32(acc + i), 12);
+        int16x4_t hi = vqrshrn_n_s32(vld1q_s32(acc + i + 4), 12);
+        vst1q_s16(out + i, vcombine_s16(lo, hi));
+    }
+#endif
+
+    for (; i < samples; i++) {
+        int64_t v = ((int64_t)acc[i] + (1 << 11)) >> 12;
+        if (v > 32767) v = 32767;
+        if (v < -32768) v = -32768;
+        out[i] = (int16_t)v;
+    }
+}
+
+// sin(π/2 · i/64) en Q12
+static const int16_t quarter_sine[65] = {
+    0, 101, 201, 301, 401, 501, 601, 700, 799, 897, 995, 1092, 1189,
+    1285, 1380, 1474, 1567, 1660, 1751, 1842, 1931, 2019, 2106, 2191, 2276, 2359,
+    2440, 2520, 2598, 2675, 2751, 2824, 2896, 2967, 3035, 3102, 3166, 3229, 3290,
+    3349, 3406, 3461, 3513, 3564, 3612, 3659, 3703, 3745, 3784, 3822, 3857, 3889,
+    3920, 3948, 3973, 3996, 4017, 4036, 4052, 4065, 4076, 4085, 4091, 4095, 4096,
+};
+
+// sin(π/2 · position/length) en Q12, interpolando la tabla
+static int32_t equal_power_gain(uint32_t position, uint32_t length) {
+    if (position >= length) {
+        return LIMITER_UNITY_GAIN;
+    }
+    uint64_t x = ((uint64_t)position << 22) / length;     // Índice en Q16
+    uint32_t i = (uint32_t)(x >> 16);
+    int32_t frac = (int32_t)(x & 0xFFFF);
+    return quarter_sine[i] + (((quarter_sine[i + 1] - quarter_sine[i]) * frac) >> 16);
+}
+
+void dsp_crossfade_stereo_s16(const int16_t *out_going, const int16_t *in_coming, int16_t *out,
+                              uint32_t frames, uint32_t position, uint32_t length) {
+    for (uint32_t done = 0; done < frames; ) {
+        uint32_t n = frames - done;
+        if (n > CROSSFADE_SEGMENT_FRAMES) {
+            n = CROSSFADE_SEGMENT_FRAMES;
+        }
+        uint32_t p0 = position + done, p1 = p0 + n;
+        uint32_t q0 = (p0 < length) ? length - p0 : 0, q1 = (p1 < length) ? length - p1 : 0;
+        dsp_mix_ramp_stereo_s16(out_going + 2 * done, in_coming + 2 * done, out + 2 * done, n,
+                                equal_power_gain(q0, length), equal_power_gain(q1, length),
+                                equal_power_gain(p0, length), equal_power_gain(p1, length));
+        done += n;
+    }
+}
+
+void dsp_gain_s24(int32_t *samples, uint32_t count, int32_t gain) {
+    if (gain == LIMITER_UNITY_GAIN) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t v = (int32_t)(((int64_t)samples[i] * gain + (1 << 11)) >> 12);
+        if (v > 0x7FFFFF) v = 0x7FFFFF;
+        if (v < -0x800000) v = -0x800000;
+        samples[i] = v;
+    }
+}
+
+// --- Conversión de tasa ---
+
+void resampler_init(resampler_t *rs, uint32_t in_rate, uint32_t out_rate) {
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->step = ((uint64_t)in_rate << 32) / out_rate;
+    resampler_reset(rs);
+}
+
+// Historia en silencio; la primera salida cae sobre el primer frame de entrada
+void resampler_reset(resampler_t *rs) {
+    memset(rs->history, 0, sizeof(rs->history));
+    rs->pos = (uint64_t)3 << 32;
+}
+
+uint32_t resampler_input_frames(const resampler_t *rs, uint32_t out_frames) {
+    // Margen de 2 frames por la fase arrastrada entre llamadas
+    uint64_t frames = (uint64_t)out_frames * rs->in_rate / rs->out_rate;
+    return frames > 2 ? (uint32_t)frames - 2 : 0;
+}
+
+static inline int16_t hermite(float xm1, float x0, float x1, float x2, float t) {
+    float c1 = 0.5f * (x1 - xm1);
+    float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+    float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    float y = ((c3 * t + c2) * t + c1) * t + x0;
+    if (y > 32767.0f) return 32767;
+    if (y < -32768.0f) return -32768;
+    return (int16_t)(y >= 0.0f ? y + 0.5f : y - 0.5f);
+}
+
+uint32_t resampler_process(resampler_t *rs, const int16_t *in, uint32_t frames,
+                           int16_t *out, uint32_t max_out) {
+    // Índice i de [historia(3) | entrada]: i < 3 lee la historia
+    #define RS_SAMPLE(i, ch) ((i) < 3 ? rs->history[2 * (i) + (ch)] : in[2 * ((i) - 3) + (ch)])
+    uint32_t total = frames + 3;
+    uint32_t produced = 0;
+
+    while (produced < max_out) {
+        uint32_t i = (uint32_t)(rs->pos >> 32);
+        if (i + 2 >= total) {
+            break;
+        }
+        float t = (float)(uint32_t)rs->pos * (1.0f / 4294967296.0f);
+        for (int ch = 0; ch < 2; ch++) {
+            out[2 * produced + ch] = hermite(RS_SAMPLE(i - 1, ch), RS_SAMPLE(i, ch),
+                                             RS_SAMPLE(i + 1, ch), RS_SAMPLE(i + 2, ch), t);
+        }
+        produced++;
+        rs->pos += rs->step;
+    }
+
+    // Los últimos 3 frames pasan a ser la historia de la próxima llamada
+    int16_t history[3 * 2];
+    for (uint32_t i = 0; i < 3; i++) {
+        for (int ch = 0; ch < 2; ch++) {
+            history[2 * i + ch] = RS_SAMPLE(total - 3 + i, ch);
+        }
+    }
+    memcpy(rs->history, history, sizeof(history));
+    rs->pos -= (uint64_t)frames << 32;
+    #undef RS_SAMPLE
+    return produced;
+}
+
+// --- Limitador ---
+
+void limiter_init(limiter_t *lim, uint32_t volume_percent) {
+    limiter_set_volume(lim, volume_percent);
+    limiter_reset(lim);
+}
+
+// Bajar el volumen es inmediato (rampa de un bloque); subirlo usa el release
+void limiter_set_volume(limiter_t *lim, uint32_t volume_percent) {
+    lim->volume_gain = volume_to_gain(volume_percent);
+    lim->release_step = lim->volume_gain / LIMITER_RELEASE_BLOCKS;
+    if (lim->release_step < 1) {
+        lim->release_step = 1;
+    }
+}
+
+void limiter_reset(limiter_t *lim) {
+    // Sin bloque retenido: el primero que se complete no sale hasta tener
+    // look-ahead, así no se antepone silencio
+    lim->pending_frames = 0;
+    lim->incoming_frames = 0;
+    lim->pending_safe = INT32_MAX;
+    lim->gain = lim->volume_gain;
+    lim->min_gain = lim->volume_gain;
+}
+
+// Emite el bloque retenido usando como look-ahead el bloque entrante.
+// Ambos extremos de la rampa son <= safe(pending), así que ninguna muestra
+// intermedia puede superar el techo.
+static void limiter_emit_block(limiter_t *lim, int16_t *out, uint32_t frames, int32_t incoming_safe) {
+    int32_t target = lim->volume_gain;
+
+    if (lim->gain + lim->release_step < target) {
+        target = lim->gain + lim->release_step;
+    }
+    if (lim->pending_safe < target) {
+        target = lim->pending_safe;
+    }
+    if (incoming_safe < target) {
+        target = incoming_safe;
+    }
+
+    dsp_gain_ramp_stereo_s16(lim->pending, out, frames, lim->gain, target);
+
+    lim->gain = target;
+    if (target < lim->min_gain) {
+        lim->min_gain = target;
+    }
+}
+
+uint32_t limiter_process(limiter_t *lim, const int16_t *in, int16_t *out, uint32_t frames) {
+    uint32_t produced = 0;
+
+    while (frames > 0) {
+        uint32_t space = LIMITER_BLOCK_FRAMES - lim->incoming_frames;
+        uint32_t n = (frames < space) ? frames : space;
+
+        memcpy(lim->incoming + 2 * lim->incoming_frames, in, n * 2 * sizeof(int16_t));
+        lim->incoming_frames += n;
+        in += 2 * n;
+        frames -= n;
+
+        if (lim->incoming_frames < LIMITER_BLOCK_FRAMES) {
+            break;
+        }
+
+        int32_t incoming_safe = safe_gain(dsp_peak_s16(lim->incoming, LIMITER_BLOCK_FRAMES * 2));
+        if (lim->pending_frames) {
+            limiter_emit_block(lim, out + 2 * produced, LIMITER_BLOCK_FRAMES, incoming_safe);
+            produced += LIMITER_BLOCK_FRAMES;
+        }
+
+        memcpy(lim->pending, lim->incoming, sizeof(lim->pending));
+        lim->pending_frames = LIMITER_BLOCK_FRAMES;
+        lim->pending_safe = incoming_safe;
+        lim->incoming_frames = 0;
+    }
+
+    return produced;
+}
+
+uint32_t limiter_flush(limiter_t *lim, int16_t *out) {
+    uint32_t produced = 0;
+    uint32_t partial = lim->incoming_frames;
+    int32_t incoming_safe = safe_gain(dsp_peak_s16(lim->incoming, partial * 2));
+
+    if (lim->pending_frames) {
+        limiter_emit_block(lim, out, LIMITER_BLOCK_FRAMES, incoming_safe);
+        produced = LIMITER_BLOCK_FRAMES;
+    }
+    // El parcial no tiene look-ahead: su propio pico acota la rampa
+    if (partial) {
+        memcpy(lim->pending, lim->incoming, partial * 2 * sizeof(int16_t));
+        lim->pending_safe = incoming_safe;
+        limiter_emit_block(lim, out + 2 * produced, partial, INT32_MAX);
+        produced += partial;
+    }
+
+    lim->pending_frames = 0;
+    lim->incoming_frames = 0;
+    lim->pending_safe = INT32_MAX;
+    return produced;
+}
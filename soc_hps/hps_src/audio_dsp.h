@@ -0,0 +1,94 @@
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#include <stdint.h>
+
+// Procesamiento de audio en el HPS (estéreo intercalado, 16 bits).
+// Todo el trabajo por muestra se hace aquí para que el Nios II/tiny
+// solo copie palabras al FIFO del codec.
+
+// Volumen en porcentaje (100 = ganancia unitaria)
+#define VOLUME_DEFAULT          100
+#define VOLUME_MAX              400         // +12 dB
+
+// Limitador con look-ahead de un bloque
+#define LIMITER_BLOCK_FRAMES    32          // 0.67 ms a 48 kHz
+#define LIMITER_UNITY_GAIN      4096        // Ganancias en Q12
+#define LIMITER_RELEASE_BLOCKS  300         // ~200 ms para recuperar la ganancia
+#define LIMITER_CEILING         32767
+
+typedef struct {
+    int16_t pending[LIMITER_BLOCK_FRAMES * 2];   // Bloque retenido (retardo)
+    int16_t incoming[LIMITER_BLOCK_FRAMES * 2];  // Bloque en acumulación
+    uint32_t pending_frames;                     // 0 hasta el primer bloque completo
+    uint32_t incoming_frames;                    // Frames en incoming
+    int32_t pending_safe;      // Ganancia máxima sin recorte para pending (Q12)
+    int32_t gain;              // Ganancia al final del último bloque emitido (Q12)
+    int32_t volume_gain;       // Ganancia pedida por el volumen (Q12)
+    int32_t release_step;      // Incremento máximo por bloque (Q12)
+    int32_t min_gain;          // Menor ganancia aplicada desde el último reset
+} limiter_t;
+
+void limiter_init(limiter_t *lim, uint32_t volume_percent);
+void limiter_set_volume(limiter_t *lim, uint32_t volume_percent);
+void limiter_reset(limiter_t *lim);
+
+// Procesa 'frames' frames de 'in' y escribe en 'out' los bloques completos
+// retrasados un bloque. 'out' debe tener espacio para frames + LIMITER_BLOCK_FRAMES.
+// Devuelve el número de frames escritos en 'out'.
+uint32_t limiter_process(limiter_t *lim, const int16_t *in, int16_t *out, uint32_t frames);
+
+// Fin de canción o de stream: emite lo retenido (bloque y parcial entrante)
+// y deja el limitador vacío, conservando la ganancia. 'out' debe tener
+// espacio para 2 * LIMITER_BLOCK_FRAMES. Devuelve los frames escritos.
+uint32_t limiter_flush(limiter_t *lim, int16_t *out);
+
+// Conversión de tasa para material que el codec no puede reproducir nativo
+// (44.1 kHz con MCLK de 12.288 MHz). Interpolación Hermite de 4 puntos,
+// por streaming: conserva los últimos 3 frames entre llamadas.
+typedef struct {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint64_t step;             // Avance por frame de salida (Q32, en frames de entrada)
+    uint64_t pos;              // Posición en [historia | entrada] (Q32)
+    int16_t history[3 * 2];    // Últimos 3 frames de la llamada anterior
+} resampler_t;
+
+void resampler_init(resampler_t *rs, uint32_t in_rate, uint32_t out_rate);
+void resampler_reset(resampler_t *rs);
+
+// Frames de entrada que producen como máximo 'out_frames' frames de salida
+uint32_t resampler_input_frames(const resampler_t *rs, uint32_t out_frames);
+
+// Convierte 'frames' frames de 'in' y devuelve los escritos en 'out'.
+// 'max_out' debe alcanzar para toda la entrada: con frames <=
+// resampler_input_frames(rs, max_out) siempre alcanza.
+uint32_t resampler_process(resampler_t *rs, const int16_t *in, uint32_t frames,
+                           int16_t *out, uint32_t max_out);
+
+// Kernels vectorizados (NEON si está disponible)
+int32_t dsp_peak_s16(const int16_t *samples, uint32_t count);
+// Mínimo y máximo (count = 0 deja min > max)
+void dsp_minmax_s16(const int16_t *samples, uint32_t count, int16_t *min, int16_t *max);
+void dsp_gain_ramp_stereo_s16(const int16_t *in, int16_t *out, uint32_t frames,
+                              int32_t gain_start, int32_t gain_end);
+void dsp_mix_ramp_stereo_s16(const int16_t *a, const int16_t *b, int16_t *out, uint32_t frames,
+                             int32_t a_start, int32_t a_end, int32_t b_start, int32_t b_end);
+
+// Mezcla de N fuentes: acumular cada una (rampa Q12, misma convención) en
+// 'acc' puesto a cero, después dsp_mix_store_s16
+void dsp_mix_accumulate_s16(int32_t *acc, const int16_t *in, uint32_t frames,
+                            int32_t gain_start, int32_t gain_end);
+void dsp_mix_store_s16(const int32_t *acc, int16_t *out, uint32_t samples);
+
+// Crossfade de igual potencia (sin/cos): 'position' es el frame del fade en
+// que empieza este tramo, de 'length' en total. La curva se aproxima con
+// rampas lineales de CROSSFADE_SEGMENT_FRAMES. 'out' puede ser 'in_coming'.
+#define CROSSFADE_SEGMENT_FRAMES    64
+void dsp_crossfade_stereo_s16(const int16_t *out_going, const int16_t *in_coming, int16_t *out,
+                              uint32_t frames, uint32_t position, uint32_t length);
+
+// Ganancia fija (Q12) sobre palabras de 24 bits del codec, con saturación
+void dsp_gain_s24(int32_t *samples, uint32_t count, int32_t gain);
+
+#endif /* AUDIO_DSP_H */
@@ -0,0 +1,155 @@
+#include <string.h>
+#include "audio_mixer.h"
+
+static int32_t percent_to_gain(uint32_t volume_percent) {
+    if (volume_percent > VOLUME_MAX) {
+        volume_percent = VOLUME_MAX;
+    }
+    return (int32_t)((volume_percent * LIMITER_UNITY_GAIN) / 100);
+}
+
+void mixer_init(mixer_t *mix, uint32_t rate) {
+    memset(mix, 0, sizeof(*mix));
+    mix->rate = rate;
+    mix->duck = LIMITER_UNITY_GAIN;
+    mix->duck_release = (int32_t)((int64_t)(LIMITER_UNITY_GAIN - MIXER_DUCK_GAIN) * MIXER_BLOCK_FRAMES * 1000 /
+                                  ((int64_t)rate * MIXER_DUCK_RELEASE_MS));
+    if (mix->duck_release < 1) {
+        mix->duck_release = 1;
+    }
+}
+
+void mixer_restart(mixer_t *mix) {
+    mix->frames = 0;
+    for (int i = 0; i < MIXER_SOURCES; i++) {
+        mixer_source_t *src = &mix->source[i];
+        src->started = 0;
+        src->mixed = 0;
+        src->gaps = 0;
+        src->pending_gap = 0;
+    }
+}
+
+void mixer_source_start(mixer_t *mix, int index, uint32_t in_rate, uint32_t flags, uint32_t volume_percent) {
+    mixer_source_t *src = &mix->source[index];
+
+    memset(src, 0, sizeof(*src) - sizeof(src->staged));
+    src->active = 1;
+    src->flags = flags;
+    src->in_rate = in_rate;
+    src->resample = (in_rate != mix->rate);
+    resampler_init(&src->rs, in_rate, mix->rate);
+    src->gain = percent_to_gain(volume_percent);
+    src->applied = src->gain;
+}
+
+void mixer_source_stop(mixer_t *mix, int index) {
+    mix->source[index].active = 0;
+}
+
+void mixer_source_volume(mixer_t *mix, int index, uint32_t volume_percent) {
+    mix->source[index].gain = percent_to_gain(volume_percent);
+}
+
+uint32_t mixer_source_space(const mixer_t *mix, int index) {
+    const mixer_source_t *src = &mix->source[index];
+    uint32_t free = MIXER_STAGING_FRAMES - src->staged_frames;
+
+    return src->resample ? resampler_input_frames(&src->rs, free) : free;
+}
+
+void mixer_source_push(mixer_t *mix, int index, const int16_t *pcm, uint32_t frames) {
+    mixer_source_t *src = &mix->source[index];
+    int16_t *dst = src->staged + src->staged_frames * 2;
+    uint32_t free = MIXER_STAGING_FRAMES - src->staged_frames;
+
+    if (src->resample) {
+        src->staged_frames += resampler_process(&src->rs, pcm, frames, dst, free);
+    } else {
+        if (frames > free) {
+            frames = free;
+        }
+        memcpy(dst, pcm, frames * 4);
+        src->staged_frames += frames;
+    }
+}
+
+// Frames de la fuente (a la tasa de la mezcla) ya reproducidos
+static uint64_t source_played_out(const mixer_source_t *src, uint64_t mix_played) {
+    if (!src->started || mix_played <= src->start_frame + src->gaps) {
+        return 0;
+    }
+    uint64_t played = mix_played - src->start_frame - src->gaps;
+    return (played > src->mixed) ? src->mixed : played;
+}
+
+uint64_t mixer_source_played(const mixer_t *mix, int index, uint64_t mix_played) {
+    const mixer_source_t *src = &mix->source[index];
+    return source_played_out(src, mix_played) * src->in_rate / mix->rate;
+}
+
+int mixer_source_drained(const mixer_t *mix, int index, uint64_t mix_played) {
+    const mixer_source_t *src = &mix->source[index];
+    return src->staged_frames == 0 && source_played_out(src, mix_played) == src->mixed;
+}
+
+void mixer_mix(mixer_t *mix, int16_t *out, uint32_t frames) {
+    int ducking = 0;
+
+    if (frames > MIXER_BLOCK_FRAMES) {
+        frames = MIXER_BLOCK_FRAMES;
+    }
+    memset(mix->acc, 0, frames * 2 * sizeof(int32_t));
+
+    // Una alerta con audio en este bloque baja a las demás en el mismo bloque;
+    // al terminar suben de a poco
+    for (int i = 0; i < MIXER_SOURCES; i++) {
+        const mixer_source_t *src = &mix->source[i];
+        if (src->active && (src->flags & MIXER_FLAG_DUCK) && src->staged_frames > 0) {
+            ducking = 1;
+        }
+    }
+    if (ducking) {
+        mix->duck = MIXER_DUCK_GAIN;
+    } else if (mix->duck < LIMITER_UNITY_GAIN) {
+        mix->duck += (int32_t)((int64_t)mix->duck_release * frames / MIXER_BLOCK_FRAMES);
+        if (mix->duck > LIMITER_UNITY_GAIN) {
+            mix->duck = LIMITER_UNITY_GAIN;
+        }
+    }
+
+    for (int i = 0; i < MIXER_SOURCES; i++) {
+        mixer_source_t *src = &mix->source[i];
+        if (!src->active) {
+            continue;
+        }
+        uint32_t n = (src->staged_frames < frames) ? src->staged_frames : frames;
+        if (!src->started) {
+            if (n == 0) {
+                continue;
+            }
+            // Empieza en este bloque: el silencio previo no es un hueco suyo
+            src->started = 1;
+            src->start_frame = mix->frames;
+        }
+
+        int32_t target = (src->flags & MIXER_FLAG_DUCK) ? src->gain :
+                         (int32_t)(((int64_t)src->gain * mix->duck) >> 12);
+        dsp_mix_accumulate_s16(mix->acc, src->staged, n, src->applied, target);
+        src->applied = target;
+
+        // El silencio cuenta como hueco cuando vuelve a llegar audio: el del
+        // final (la fuente terminó) no corre su posición
+        if (n > 0) {
+            src->gaps += src->pending_gap;
+            src->pending_gap = 0;
+        }
+        src->staged_frames -= n;
+        memmove(src->staged, src->staged + n * 2, src->staged_frames * 4);
+        src->mixed += n;
+        src->pending_gap += frames - n;
+    }
+
+    dsp_mix_store_s16(mix->acc, out, frames * 2);
+    mix->frames += frames;
+}
@@ -0,0 +1,71 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <stdint.h>
+#include "audio_dsp.h"
+
+// Mezcla de varias fuentes PCM (estéreo, 16 bits) en un solo stream para el
+// Nios. Cada fuente se convierte a la tasa de la mezcla al entrar y espera
+// en su staging; mixer_mix toma de todas a la vez, cada una con su volumen
+// y, mientras suena una fuente que pide ducking (alertas), las demás bajan
+// a MIXER_DUCK_GAIN. Las ganancias cambian con rampas dentro del bloque.
+// Lo usa un solo hilo.
+
+#define MIXER_SOURCES           4
+#define MIXER_BLOCK_FRAMES      2048        // Máximo por mixer_mix
+#define MIXER_STAGING_FRAMES    4096        // Por fuente, ya a la tasa de la mezcla
+#define MIXER_DUCK_GAIN         1024        // -12 dB (Q12)
+#define MIXER_DUCK_RELEASE_MS   400         // Vuelta a ganancia unitaria al terminar la alerta
+
+#define MIXER_FLAG_DUCK         1           // La fuente baja a las demás mientras tiene audio
+
+typedef struct {
+    int active;
+    uint32_t flags;
+    uint32_t in_rate;
+    int resample;
+    resampler_t rs;
+    int32_t gain;               // Volumen pedido (Q12)
+    int32_t applied;            // Ganancia al final del último bloque (volumen × ducking)
+    int started;                // Ya cayó algún frame suyo en la mezcla
+    uint64_t start_frame;       // Frame de la mezcla donde cayó el primero
+    uint64_t mixed;             // Frames suyos mezclados
+    uint64_t gaps;              // Frames de silencio por falta de datos entre los suyos
+    uint64_t pending_gap;       // Silencio desde su último frame
+    uint32_t staged_frames;
+    int16_t staged[MIXER_STAGING_FRAMES * 2];
+} mixer_source_t;
+
+typedef struct {
+    uint32_t rate;
+    uint64_t frames;            // Frames mezclados desde mixer_restart
+    int32_t duck;               // Ganancia del ducking en curso (Q12)
+    int32_t duck_release;       // Subida por bloque de MIXER_BLOCK_FRAMES (Q12)
+    mixer_source_t source[MIXER_SOURCES];
+    int32_t acc[MIXER_BLOCK_FRAMES * 2];
+} mixer_t;
+
+void mixer_init(mixer_t *mix, uint32_t rate);
+
+// Stream nuevo hacia el Nios: las posiciones vuelven a contar desde 0
+void mixer_restart(mixer_t *mix);
+
+void mixer_source_start(mixer_t *mix, int index, uint32_t in_rate, uint32_t flags, uint32_t volume_percent);
+void mixer_source_stop(mixer_t *mix, int index);
+void mixer_source_volume(mixer_t *mix, int index, uint32_t volume_percent);
+
+// Frames de entrada (a in_rate) que entran ahora en el staging
+uint32_t mixer_source_space(const mixer_t *mix, int index);
+void mixer_source_push(mixer_t *mix, int index, const int16_t *pcm, uint32_t frames);
+
+// Frames de la fuente reproducidos (a in_rate), dados los de la mezcla
+uint64_t mixer_source_played(const mixer_t *mix, int index, uint64_t mix_played);
+
+// Todo lo que entró de la fuente ya se mezcló y se reprodujo
+int mixer_source_drained(const mixer_t *mix, int index, uint64_t mix_played);
+
+// Mezcla 'frames' (hasta MIXER_BLOCK_FRAMES) en 'out'. Las fuentes que no
+// llegan aportan silencio por lo que les falta.
+void mixer_mix(mixer_t *mix, int16_t *out, uint32_t frames);
+
+#endif /* AUDIO_MIXER_H */
@@ -0,0 +1,390 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include "audio_server.h"
+
+#define SERVER_HELLO_TIMEOUT_MS     200     // El cliente manda el hello junto con connect()
+#define SERVER_MIN_RATE             8000
+#define SERVER_MAX_RATE             192000
+
+static void signal_event(int fd) {
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0) {
+        // Contador saturado: el otro lado ya tiene avisos pendientes
+    }
+}
+
+static void drain_event(int fd) {
+    uint64_t counter;
+    if (read(fd, &counter, sizeof(counter)) < 0) {
+        // EAGAIN: ya estaba en cero
+    }
+}
+
+static int send_reply(int fd, int status, uint32_t ring_frames, uint32_t codec_rate, const int *fds) {
+    fpga_audio_reply_t reply = {
+        .magic = FPGA_AUDIO_MAGIC, .status = status,
+        .ring_frames = ring_frames, .codec_rate = codec_rate,
+    };
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov = { .iov_base = &reply, .iov_len = sizeof(reply) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+    if (fds) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+    }
+    return (sendmsg(fd, &msg, MSG_NOSIGNAL) == sizeof(reply)) ? 0 : -1;
+}
+
+static int receive_hello(int fd, fpga_audio_hello_t *hello) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    if (poll(&pfd, 1, SERVER_HELLO_TIMEOUT_MS) <= 0) {
+        return -1;
+    }
+    if (recv(fd, hello, sizeof(*hello), MSG_WAITALL) != sizeof(*hello) ||
+        hello->magic != FPGA_AUDIO_MAGIC || hello->version != FPGA_AUDIO_VERSION) {
+        return -1;
+    }
+    return 0;
+}
+
+static void end_session(audio_session_t *session) {
+    if (session->ring) {
+        munmap(session->ring, session->map_size);
+        session->ring = NULL;
+    }
+    if (session->data_fd >= 0) {
+        close(session->data_fd);
+    }
+    if (session->space_fd >= 0) {
+        close(session->space_fd);
+    }
+    if (session->client_fd >= 0) {
+        close(session->client_fd);
+    }
+    session->data_fd = -1;
+    session->space_fd = -1;
+    session->client_fd = -1;
+}
+
+// Sesiones que la mezcla ya soltó
+static void reclaim_sessions(audio_server_t *srv) {
+    for (int i = 0; i < FPGA_AUDIO_MAX_CLIENTS; i++) {
+        audio_session_t *session = &srv->session[i];
+        if (atomic_load_explicit(&session->state, memory_order_acquire) == AUDIO_SESSION_DONE) {
+            end_session(session);
+            atomic_store_explicit(&session->state, AUDIO_SESSION_FREE, memory_order_relaxed);
+        }
+    }
+}
+
+static uint32_t ring_frames_for(uint32_t requested) {
+    uint32_t frames = FPGA_AUDIO_RING_MIN;
+
+    if (requested == 0) {
+        requested = FPGA_AUDIO_RING_DEFAULT;
+    }
+    while (frames < requested && frames < FPGA_AUDIO_RING_MAX) {
+        frames <<= 1;
+    }
+    return frames;
+}
+
+// Anillo y eventfds del cliente, y la respuesta con los descriptores
+static int start_session(audio_server_t *srv, audio_session_t *session, int fd,
+                         const fpga_audio_hello_t *hello, uint32_t codec_rate) {
+    uint32_t ring_frames = ring_frames_for(hello->ring_frames);
+    int memfd = memfd_create("fpga_audio_ring", MFD_CLOEXEC);
+
+    session->client_fd = fd;
+    session->map_size = fpga_audio_ring_size(ring_frames);
+    session->data_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    session->space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (memfd < 0 || session->data_fd < 0 || session->space_fd < 0 ||
+        ftruncate(memfd, session->map_size) != 0) {
+        goto fail;
+    }
+    session->ring = mmap(NULL, session->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (session->ring == MAP_FAILED) {
+        session->ring = NULL;
+        goto fail;
+    }
+
+    session->ring->magic = FPGA_AUDIO_MAGIC;
+    session->ring->sample_rate = hello->sample_rate;
+    session->ring->ring_frames = ring_frames;
+    atomic_init(&session->ring->volume, FPGA_AUDIO_VOLUME_UNSET);
+    session->mask = ring_frames - 1;
+    session->sample_rate = hello->sample_rate;
+    session->flags = hello->flags;
+    session->volume = FPGA_AUDIO_VOLUME_UNSET;
+    atomic_store_explicit(&session->hung_up, 0, memory_order_relaxed);
+
+    int fds[3] = { memfd, session->data_fd, session->space_fd };
+    if (send_reply(fd, 0, ring_frames, codec_rate, fds) != 0) {
+        goto fail;
+    }
+    close(memfd);
+    session->id = atomic_fetch_add_explicit(&srv->sessions, 1, memory_order_relaxed) + 1;
+    return 0;
+
+fail:
+    send_reply(fd, errno ? errno : EIO, 0, 0, NULL);
+    if (memfd >= 0) {
+        close(memfd);
+    }
+    end_session(session);
+    return -1;
+}
+
+int audio_server_open(audio_server_t *srv, const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct stat st;
+    int saved;
+
+    memset(srv, 0, sizeof(*srv));
+    srv->listen_fd = -1;
+    srv->wake_fd = -1;
+    for (int i = 0; i < FPGA_AUDIO_MAX_CLIENTS; i++) {
+        srv->session[i].client_fd = -1;
+        srv->session[i].data_fd = -1;
+        srv->session[i].space_fd = -1;
+    }
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    snprintf(srv->path, sizeof(srv->path), "%s", path);
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    srv->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (srv->wake_fd < 0) {
+        goto fail;
+    }
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);       // De una ejecución anterior
+    }
+    srv->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (srv->listen_fd < 0 || bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        goto fail;
+    }
+    srv->bound = 1;
+    // Cualquier usuario local puede reproducir: es el punto de no pedir root
+    if (chmod(path, 0666) != 0 || listen(srv->listen_fd, 4) != 0) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    saved = errno;
+    audio_server_close(srv);
+    errno = saved;
+    return -1;
+}
+
+int audio_server_accept(audio_server_t *srv, int timeout_ms, uint32_t codec_rate) {
+    struct pollfd pfd[1 + FPGA_AUDIO_MAX_CLIENTS] = { { .fd = srv->listen_fd, .events = POLLIN } };
+    int watched[FPGA_AUDIO_MAX_CLIENTS];
+    fpga_audio_hello_t hello;
+    int count = 1;
+    char byte;
+
+    reclaim_sessions(srv);
+
+    // Los clientes no mandan nada después del hello: un evento es que cerraron
+    for (int i = 0; i < FPGA_AUDIO_MAX_CLIENTS; i++) {
+        audio_session_t *session = &srv->session[i];
+        if (atomic_load_explicit(&session->state, memory_order_acquire) == AUDIO_SESSION_ACTIVE &&
+            !atomic_load_explicit(&session->hung_up, memory_order_relaxed)) {
+            watched[count - 1] = i;
+            pfd[count++] = (struct pollfd){ .fd = session->client_fd, .events = POLLIN };
+        }
+    }
+
+    if (poll(pfd, count, timeout_ms) <= 0) {
+        return -1;
+    }
+    for (int k = 1; k < count; k++) {
+        if (pfd[k].revents) {
+            ssize_t n = recv(pfd[k].fd, &byte, 1, MSG_DONTWAIT);
+            if (n == 0 || (n < 0 && errno != EAGAIN)) {
+                atomic_store_explicit(&srv->session[watched[k - 1]].hung_up, 1, memory_order_relaxed);
+                signal_event(srv->wake_fd);
+            }
+        }
+    }
+    if (!(pfd[0].revents & POLLIN)) {
+        return -1;
+    }
+
+    int fd = accept4(srv->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (receive_hello(fd, &hello) != 0) {
+        send_reply(fd, EPROTO, 0, 0, NULL);
+        close(fd);
+        return -1;
+    }
+    if (hello.sample_rate < SERVER_MIN_RATE || hello.sample_rate > SERVER_MAX_RATE) {
+        send_reply(fd, EINVAL, 0, 0, NULL);
+        close(fd);
+        return -1;
+    }
+
+    reclaim_sessions(srv);
+    for (int i = 0; i < FPGA_AUDIO_MAX_CLIENTS; i++) {
+        audio_session_t *session = &srv->session[i];
+        if (atomic_load_explicit(&session->state, memory_order_relaxed) != AUDIO_SESSION_FREE) {
+            continue;
+        }
+        errno = 0;
+        if (start_session(srv, session, fd, &hello, codec_rate) != 0) {
+            return -1;
+        }
+        atomic_store_explicit(&session->state, AUDIO_SESSION_ACTIVE, memory_order_release);
+        signal_event(srv->wake_fd);
+        return i;
+    }
+
+    send_reply(fd, EBUSY, 0, 0, NULL);
+    close(fd);
+    atomic_fetch_add_explicit(&srv->rejected, 1, memory_order_relaxed);
+    return -1;
+}
+
+void audio_server_wait(audio_server_t *srv, int timeout_ms) {
+    struct pollfd pfd[1 + FPGA_AUDIO_MAX_CLIENTS] = { { .fd = srv->wake_fd, .events = POLLIN } };
+    int count = 1;
+
+    for (int i = 0; i < FPGA_AUDIO_MAX_CLIENTS; i++) {
+        audio_session_t *session = &srv->session[i];
+        if (atomic_load_explicit(&session->state, memory_order_acquire) == AUDIO_SESSION_ACTIVE) {
+            pfd[count++] = (struct pollfd){ .fd = session->data_fd, .events = POLLIN };
+        }
+    }
+
+    if (poll(pfd, count, timeout_ms) <= 0) {
+        return;
+    }
+    for (int k = 0; k < count; k++) {
+        if (pfd[k].revents & POLLIN) {
+            drain_event(pfd[k].fd);
+        }
+    }
+}
+
+// Frames en el anillo, o -1 si el cliente escribió de más el contador. El
+// tamaño sale de la sesión: ring->ring_frames lo puede pisar el cliente.
+static int64_t ring_available(const audio_session_t *session, uint64_t *head) {
+    fpga_audio_ring_t *ring = session->ring;
+    uint64_t tail = atomic_load_explicit(&ring->write_frames, memory_order_acquire);
+
+    *head = atomic_load_explicit(&ring->read_frames, memory_order_relaxed);
+    return (tail - *head > (uint64_t)session->mask + 1) ? -1 : (int64_t)(tail - *head);
+}
+
+int audio_server_read(audio_server_t *srv, int index, int16_t *out, uint32_t frames) {
+    audio_session_t *session = &srv->session[index];
+    fpga_audio_ring_t *ring = session->ring;
+    uint64_t head;
+
+    // Primero hung_up: lo que el cliente escribió antes de cerrar ya se ve
+    int hung_up = atomic_load_explicit(&session->hung_up, memory_order_relaxed);
+    int64_t available = ring_available(session, &head);
+    if (available < 0) {
+        printf("⚠ Cliente de audio %u con el anillo corrupto: se corta la sesión\n", session->id);
+        return -1;
+    }
+
+    uint32_t count = (available < frames) ? (uint32_t)available : frames;
+    if (count == 0) {
+        return hung_up ? -1 : 0;
+    }
+
+    uint32_t start = (uint32_t)head & session->mask;
+    uint32_t first = session->mask + 1 - start;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(out, &ring->samples[start * 2], first * 4);
+    memcpy(out + first * 2, &ring->samples[0], (count - first) * 4);
+
+    atomic_store_explicit(&ring->read_frames, head + count, memory_order_release);
+    atomic_fetch_add_explicit(&srv->frames, count, memory_order_relaxed);
+    signal_event(session->space_fd);
+    return (int)count;
+}
+
+uint32_t audio_server_queued(audio_server_t *srv, int index) {
+    uint64_t head;
+    int64_t available = ring_available(&srv->session[index], &head);
+    return (available > 0) ? (uint32_t)available : 0;
+}
+
+void audio_server_release(audio_server_t *srv, int index) {
+    atomic_store_explicit(&srv->session[index].state, AUDIO_SESSION_DONE, memory_order_release);
+}
+
+int audio_server_volume(audio_server_t *srv, int index) {
+    audio_session_t *session = &srv->session[index];
+    uint32_t volume = atomic_load_explicit(&session->ring->volume, memory_order_relaxed);
+
+    if (volume == session->volume || volume > FPGA_AUDIO_VOLUME_MAX) {
+        return -1;
+    }
+    session->volume = volume;
+    return (int)volume;
+}
+
+void audio_server_played(audio_server_t *srv, int index, uint64_t frames) {
+    audio_session_t *session = &srv->session[index];
+    fpga_audio_ring_t *ring = session->ring;
+
+    uint64_t read = atomic_load_explicit(&ring->read_frames, memory_order_relaxed);
+    if (frames > read) {
+        frames = read;
+    }
+    if (frames > atomic_load_explicit(&ring->played_frames, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->played_frames, frames, memory_order_release);
+        signal_event(session->space_fd);
+    }
+}
+
+// Al salir: ningún otro hilo usa ya el servidor
+void audio_server_close(audio_server_t *srv) {
+    for (int i = 0; i < FPGA_AUDIO_MAX_CLIENTS; i++) {
+        end_session(&srv->session[i]);
+        atomic_store_explicit(&srv->session[i].state, AUDIO_SESSION_FREE, memory_order_relaxed);
+    }
+    if (srv->listen_fd >= 0) {
+        close(srv->listen_fd);
+    }
+    if (srv->wake_fd >= 0) {
+        close(srv->wake_fd);
+    }
+    if (srv->bound) {
+        unlink(srv->path);
+    }
+    srv->listen_fd = -1;
+    srv->wake_fd = -1;
+    srv->bound = 0;
+}
@@ -0,0 +1,79 @@
+#ifndef AUDIO_SERVER_H
+#define AUDIO_SERVER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "fpga_audio_proto.h"
+
+// Lado del loader de libfpgaaudio (--serve): escucha en un socket Unix,
+// crea para cada cliente el anillo (memfd) y los dos eventfd y se los pasa
+// por SCM_RIGHTS. Hasta FPGA_AUDIO_MAX_CLIENTS sesiones a la vez; las demás
+// conexiones reciben EBUSY.
+//
+// Dos hilos, sin locks: el de aceptación (audio_server_accept) publica cada
+// sesión nueva pasando su estado a ACTIVE, y el que mezcla (el resto de las
+// funciones) la devuelve con DONE; aceptación cierra sus descriptores y la
+// deja FREE. Mientras está ACTIVE nadie cierra nada de ella.
+
+enum { AUDIO_SESSION_FREE, AUDIO_SESSION_ACTIVE, AUDIO_SESSION_DONE };
+
+typedef struct {
+    _Atomic int state;
+    int client_fd;
+    int data_fd;
+    int space_fd;
+    fpga_audio_ring_t *ring;
+    uint64_t map_size;
+    uint32_t mask;              // Frames del anillo - 1 (la copia del loader, no la del memfd)
+    uint32_t sample_rate;
+    uint32_t flags;             // FPGA_AUDIO_FLAG_*
+    uint32_t id;                // Número de sesión desde el arranque
+    _Atomic int hung_up;        // El cliente cerró: se termina de tocar lo que dejó
+    uint32_t volume;            // Último pedido visto
+} audio_session_t;
+
+typedef struct {
+    int listen_fd;
+    int wake_fd;                // Aceptación → mezcla: sesión nueva o cliente que cerró
+    char path[108];             // sun_path
+    int bound;                  // El socket es nuestro: se borra al cerrar
+    audio_session_t session[FPGA_AUDIO_MAX_CLIENTS];
+
+    _Atomic uint32_t sessions;
+    _Atomic uint32_t rejected;
+    _Atomic uint64_t frames;
+} audio_server_t;
+
+// Devuelve 0 o -1 (errno)
+int audio_server_open(audio_server_t *srv, const char *path);
+
+// Hilo de aceptación: espera hasta timeout_ms un cliente o que alguno
+// cierre, y libera las sesiones terminadas. Devuelve el índice de la
+// sesión nueva o -1. 'codec_rate' va en la respuesta (tasa de la mezcla).
+int audio_server_accept(audio_server_t *srv, int timeout_ms, uint32_t codec_rate);
+
+// Hilo de mezcla: espera hasta timeout_ms datos de cualquier sesión activa
+// o un aviso de aceptación
+void audio_server_wait(audio_server_t *srv, int timeout_ms);
+
+// Hasta 'frames' frames del anillo de la sesión, sin esperar. Devuelve los
+// leídos, 0 si no hay o -1 si la sesión terminó (el cliente cerró y el
+// anillo quedó vacío, o lo corrompió).
+int audio_server_read(audio_server_t *srv, int index, int16_t *out, uint32_t frames);
+
+// Frames esperando en el anillo
+uint32_t audio_server_queued(audio_server_t *srv, int index);
+
+// Devuelve la sesión a aceptación (DONE)
+void audio_server_release(audio_server_t *srv, int index);
+
+// Volumen pedido por el cliente desde la última llamada, o -1
+int audio_server_volume(audio_server_t *srv, int index);
+
+// Publica los frames reproducidos (a la tasa del cliente; nunca más de los
+// leídos del anillo) y lo despierta
+void audio_server_played(audio_server_t *srv, int index, uint64_t frames);
+
+void audio_server_close(audio_server_t *srv);
+
+#endif /* AUDIO_SERVER_H */
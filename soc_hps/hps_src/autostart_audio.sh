@@ -5,7 +5,7 @@ echo "Checking for hps_audio_loader..."
 
 if [ -f /usr/bin/hps_audio_loader ]; then
     echo "Starting HPS Audio Streamer..."
-    /usr/bin/hps_audio_loader &
+    /usr/bin/hps_audio_loader --realtime &
     echo "Audio Streamer started in background (PID: $!)"
     echo "Ready for FPGA control via buttons/switches"
 else
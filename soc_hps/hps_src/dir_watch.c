@@ -0,0 +1,66 @@
+#include <unistd.h>
+#include <errno.h>
+#include <sys/inotify.h>
+#include "dir_watch.h"
+
+#define DIR_WATCH_MASK  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | \
+                         IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_ONLYDIR)
+
+int dir_watch_open(dir_watch_t *watch, const char *dir) {
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    watch->wd = -1;
+    if (watch->fd < 0) {
+        return -1;
+    }
+    watch->wd = inotify_add_watch(watch->fd, dir, DIR_WATCH_MASK);
+    if (watch->wd < 0) {
+        dir_watch_close(watch);
+        return -1;
+    }
+    return 0;
+}
+
+int dir_watch_poll(dir_watch_t *watch, dir_watch_fn fn, void *ctx) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int events = 0;
+
+    if (watch->fd < 0) {
+        return -1;
+    }
+
+    for (;;) {
+        ssize_t length = read(watch->fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            // EAGAIN: no hay más
+            return (length < 0 && errno != EAGAIN && errno != EINTR) ? -1 : events;
+        }
+
+        for (char *p = buffer; p < buffer + length; ) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+            events++;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                fn(DIR_WATCH_OVERFLOW, NULL, ctx);
+            } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_IGNORED)) {
+                fn(DIR_WATCH_GONE, NULL, ctx);
+                dir_watch_close(watch);
+                return events;
+            } else if (event->len == 0 || (event->mask & IN_ISDIR)) {
+                continue;
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                fn(DIR_WATCH_ADDED, event->name, ctx);
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                fn(DIR_WATCH_REMOVED, event->name, ctx);
+            }
+        }
+    }
+}
+
+void dir_watch_close(dir_watch_t *watch) {
+    if (watch->fd >= 0) {
+        close(watch->fd);
+    }
+    watch->fd = -1;
+    watch->wd = -1;
+}
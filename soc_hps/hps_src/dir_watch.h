@@ -0,0 +1,31 @@
+#ifndef DIR_WATCH_H
+#define DIR_WATCH_H
+
+// Cambios en un directorio (no recursivo) con inotify, sin bloquear: quien
+// lo usa lo consulta periódicamente desde su propio loop.
+//
+// Un archivo cuenta como agregado o reemplazado cuando termina de escribirse
+// (IN_CLOSE_WRITE) o cuando entra por rename (IN_MOVED_TO): una copia a
+// medias nunca se reporta.
+
+#define DIR_WATCH_ADDED     0   // Nuevo o reemplazado
+#define DIR_WATCH_REMOVED   1   // Borrado o movido afuera
+#define DIR_WATCH_OVERFLOW  2   // Se perdieron eventos: revisar el directorio entero
+#define DIR_WATCH_GONE      3   // El directorio ya no existe (SD desmontada)
+
+typedef void (*dir_watch_fn)(int kind, const char *name, void *ctx);
+
+typedef struct {
+    int fd;
+    int wd;
+} dir_watch_t;
+
+int dir_watch_open(dir_watch_t *watch, const char *dir);
+
+// Despacha los eventos pendientes (name es NULL en OVERFLOW/GONE).
+// Devuelve cuántos hubo, 0 si ninguno o -1 si el watch no está activo.
+int dir_watch_poll(dir_watch_t *watch, dir_watch_fn fn, void *ctx);
+
+void dir_watch_close(dir_watch_t *watch);
+
+#endif /* DIR_WATCH_H */
@@ -0,0 +1,680 @@
+#include <stdlib.h>
+#include <string.h>
+#include "flac_decoder.h"
+
+#define FLAC_META_STREAMINFO    0
+#define FLAC_META_SEEKTABLE     3
+#define FLAC_SEEKPOINT_PLACEHOLDER  0xFFFFFFFFFFFFFFFFULL
+
+// --- Lector de bits ---
+
+static int reader_load(flac_decoder_t *dec) {
+    dec->buf_file_offset += dec->buf_len;
+    dec->buf_len = fread(dec->buf, 1, FLAC_READ_BUFFER_SIZE, dec->file);
+    dec->buf_pos = 0;
+    return dec->buf_len > 0 ? 0 : -1;
+}
+
+static inline void reader_refill(flac_decoder_t *dec) {
+    while (dec->cache_bits <= 56) {
+        if (dec->buf_pos >= dec->buf_len && reader_load(dec) != 0) {
+            return;
+        }
+        dec->cache |= (uint64_t)dec->buf[dec->buf_pos++] << (56 - dec->cache_bits);
+        dec->cache_bits += 8;
+    }
+}
+
+static inline uint32_t read_bits(flac_decoder_t *dec, int n) {
+    if (n == 0) {
+        return 0;
+    }
+    if (dec->cache_bits < n) {
+        reader_refill(dec);
+        if (dec->cache_bits < n) {
+            dec->read_error = 1;
+            return 0;
+        }
+    }
+    uint32_t v = (uint32_t)(dec->cache >> (64 - n));
+    dec->cache <<= n;
+    dec->cache_bits -= n;
+    return v;
+}
+
+static inline int32_t read_signed(flac_decoder_t *dec, int n) {
+    if (n == 0) {
+        return 0;
+    }
+    uint32_t v = read_bits(dec, n);
+    return (int32_t)(v << (32 - n)) >> (32 - n);
+}
+
+static inline uint32_t read_unary(flac_decoder_t *dec) {
+    uint32_t count = 0;
+
+    for (;;) {
+        if (dec->cache_bits == 0) {
+            reader_refill(dec);
+            if (dec->cache_bits == 0) {
+                dec->read_error = 1;
+                return 0;
+            }
+        }
+        int lz = dec->cache ? __builtin_clzll(dec->cache) : 64;
+        if (lz >= dec->cache_bits) {
+            count += dec->cache_bits;
+            dec->cache = 0;
+            dec->cache_bits = 0;
+            continue;
+        }
+        count += lz;
+        dec->cache = (lz == 63) ? 0 : dec->cache << (lz + 1);
+        dec->cache_bits -= lz + 1;
+        return count;
+    }
+}
+
+static void reader_align(flac_decoder_t *dec) {
+    read_bits(dec, dec->cache_bits & 7);
+}
+
+// Offset en el archivo del siguiente byte (el lector debe estar alineado)
+static long reader_tell(flac_decoder_t *dec) {
+    return dec->buf_file_offset + (long)dec->buf_pos - dec->cache_bits / 8;
+}
+
+static int reader_seek(flac_decoder_t *dec, long offset) {
+    if (fseek(dec->file, offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    dec->buf_file_offset = offset;
+    dec->buf_len = 0;
+    dec->buf_pos = 0;
+    dec->cache = 0;
+    dec->cache_bits = 0;
+    dec->read_error = 0;
+    return 0;
+}
+
+// --- Tabla de búsqueda ---
+
+static void seekpoint_insert(flac_decoder_t *dec, uint64_t sample, uint64_t offset) {
+    uint32_t lo = 0, hi = dec->num_seekpoints;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (dec->seekpoints[mid].sample < sample) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < dec->num_seekpoints && dec->seekpoints[lo].sample == sample) {
+        return;
+    }
+
+    if (dec->num_seekpoints == dec->seekpoints_capacity) {
+        uint32_t capacity = dec->seekpoints_capacity ? dec->seekpoints_capacity * 2 : 64;
+        flac_seekpoint_t *points = realloc(dec->seekpoints, capacity * sizeof(*points));
+        if (!points) {
+            return;
+        }
+        dec->seekpoints = points;
+        dec->seekpoints_capacity = capacity;
+    }
+
+    memmove(&dec->seekpoints[lo + 1], &dec->seekpoints[lo],
+            (dec->num_seekpoints - lo) * sizeof(flac_seekpoint_t));
+    dec->seekpoints[lo].sample = sample;
+    dec->seekpoints[lo].offset = offset;
+    dec->num_seekpoints++;
+}
+
+// Último punto con sample <= target (o NULL)
+static const flac_seekpoint_t *seekpoint_find(flac_decoder_t *dec, uint64_t target) {
+    uint32_t lo = 0, hi = dec->num_seekpoints;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (dec->seekpoints[mid].sample <= target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? &dec->seekpoints[lo - 1] : NULL;
+}
+
+// --- Metadata ---
+
+static int parse_metadata(flac_decoder_t *dec) {
+    uint8_t id[4];
+
+    if (fread(id, 1, 4, dec->file) != 4) {
+        return -1;
+    }
+
+    // Saltar etiqueta ID3v2 si existe
+    if (memcmp(id, "ID3", 3) == 0) {
+        uint8_t hdr[6];
+        if (fread(hdr, 1, 6, dec->file) != 6) {
+            return -1;
+        }
+        long size = ((long)(hdr[2] & 0x7F) << 21) | ((hdr[3] & 0x7F) << 14) |
+                    ((hdr[4] & 0x7F) << 7) | (hdr[5] & 0x7F);
+        if (fseek(dec->file, 10 + size, SEEK_SET) != 0 || fread(id, 1, 4, dec->file) != 4) {
+            return -1;
+        }
+    }
+
+    if (memcmp(id, "fLaC", 4) != 0) {
+        return -1;
+    }
+
+    reader_seek(dec, ftell(dec->file));
+
+    int last = 0;
+    int have_streaminfo = 0;
+    while (!last) {
+        last = read_bits(dec, 1);
+        uint32_t type = read_bits(dec, 7);
+        uint32_t length = read_bits(dec, 24);
+        long block_start = reader_tell(dec);
+
+        if (dec->read_error) {
+            return -1;
+        }
+
+        if (type == FLAC_META_STREAMINFO) {
+            dec->min_blocksize = read_bits(dec, 16);
+            dec->max_blocksize = read_bits(dec, 16);
+            read_bits(dec, 24);                         // min framesize
+            read_bits(dec, 24);                         // max framesize
+            dec->sample_rate = read_bits(dec, 20);
+            dec->channels = read_bits(dec, 3) + 1;
+            dec->bits_per_sample = read_bits(dec, 5) + 1;
+            dec->total_samples = (uint64_t)read_bits(dec, 4) << 32;
+            dec->total_samples |= read_bits(dec, 32);
+            have_streaminfo = 1;
+        } else if (type == FLAC_META_SEEKTABLE) {
+            for (uint32_t i = 0; i < length / 18; i++) {
+                uint64_t sample = (uint64_t)read_bits(dec, 32) << 32;
+                sample |= read_bits(dec, 32);
+                uint64_t offset = (uint64_t)read_bits(dec, 32) << 32;
+                offset |= read_bits(dec, 32);
+                read_bits(dec, 16);                     // samples en el frame
+                if (sample != FLAC_SEEKPOINT_PLACEHOLDER) {
+                    seekpoint_insert(dec, sample, offset);
+                }
+            }
+        }
+
+        if (reader_seek(dec, block_start + (long)length) != 0) {
+            return -1;
+        }
+    }
+
+    dec->first_frame_offset = reader_tell(dec);
+    return have_streaminfo ? 0 : -1;
+}
+
+// --- Subframes ---
+
+static int decode_residual(flac_decoder_t *dec, int32_t *out, uint32_t blocksize, uint32_t order) {
+    uint32_t method = read_bits(dec, 2);
+    if (method > 1) {
+        return -1;
+    }
+
+    int param_bits = method == 0 ? 4 : 5;
+    uint32_t escape = method == 0 ? 15 : 31;
+    uint32_t partition_order = read_bits(dec, 4);
+    uint32_t partition_size = blocksize >> partition_order;
+
+    if ((partition_size << partition_order) != blocksize || partition_size < order) {
+        return -1;
+    }
+
+    uint32_t idx = order;
+    for (uint32_t p = 0; p < (1u << partition_order); p++) {
+        uint32_t n = (p == 0) ? partition_size - order : partition_size;
+        uint32_t k = read_bits(dec, param_bits);
+
+        if (k == escape) {
+            int raw_bits = read_bits(dec, 5);
+            for (uint32_t i = 0; i < n; i++) {
+                out[idx++] = read_signed(dec, raw_bits);
+            }
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t u = read_unary(dec) << k;
+                u |= read_bits(dec, k);
+                out[idx++] = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+            }
+        }
+
+        if (dec->read_error) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void predict_fixed(int32_t *s, uint32_t blocksize, uint32_t order) {
+    uint32_t i;
+
+    switch (order) {
+        case 1:
+            for (i = 1; i < blocksize; i++)
+                s[i] += s[i - 1];
+            break;
+        case 2:
+            for (i = 2; i < blocksize; i++)
+                s[i] += 2 * s[i - 1] - s[i - 2];
+            break;
+        case 3:
+            for (i = 3; i < blocksize; i++)
+                s[i] += 3 * (s[i - 1] - s[i - 2]) + s[i - 3];
+            break;
+        case 4:
+            for (i = 4; i < blocksize; i++)
+                s[i] += 4 * (s[i - 1] + s[i - 3]) - 6 * s[i - 2] - s[i - 4];
+            break;
+        default:
+            break;
+    }
+}
+
+static void predict_lpc(int32_t *s, uint32_t blocksize, const int32_t *coefs,
+                        uint32_t order, int shift, int wide) {
+    for (uint32_t i = order; i < blocksize; i++) {
+        if (wide) {
+            int64_t sum = 0;
+            for (uint32_t j = 0; j < order; j++)
+                sum += (int64_t)coefs[j] * s[i - 1 - j];
+            s[i] += (int32_t)(sum >> shift);
+        } else {
+            int32_t sum = 0;
+            for (uint32_t j = 0; j < order; j++)
+                sum += coefs[j] * s[i - 1 - j];
+            s[i] += sum >> shift;
+        }
+    }
+}
+
+static int decode_subframe(flac_decoder_t *dec, int32_t *out, uint32_t blocksize, int bps) {
+    if (read_bits(dec, 1) != 0) {
+        return -1;
+    }
+
+    uint32_t type = read_bits(dec, 6);
+    int wasted = 0;
+    if (read_bits(dec, 1)) {
+        wasted = read_unary(dec) + 1;
+        bps -= wasted;
+    }
+    if (bps <= 0 || bps > 32) {
+        return -1;
+    }
+
+    if (type == 0) {
+        int32_t v = read_signed(dec, bps);
+        for (uint32_t i = 0; i < blocksize; i++)
+            out[i] = v;
+    } else if (type == 1) {
+        for (uint32_t i = 0; i < blocksize; i++)
+            out[i] = read_signed(dec, bps);
+    } else if (type >= 8 && type <= 12) {
+        uint32_t order = type - 8;
+        if (order > blocksize) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < order; i++)
+            out[i] = read_signed(dec, bps);
+        if (decode_residual(dec, out, blocksize, order) != 0) {
+            return -1;
+        }
+        predict_fixed(out, blocksize, order);
+    } else if (type >= 32) {
+        uint32_t order = (type & 31) + 1;
+        int32_t coefs[32];
+        if (order > blocksize) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < order; i++)
+            out[i] = read_signed(dec, bps);
+        int precision = read_bits(dec, 4) + 1;
+        int shift = read_signed(dec, 5);
+        if (precision == 16 || shift < 0) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < order; i++)
+            coefs[i] = read_signed(dec, precision);
+        if (decode_residual(dec, out, blocksize, order) != 0) {
+            return -1;
+        }
+        int order_bits = 32 - __builtin_clz(order);
+        predict_lpc(out, blocksize, coefs, order, shift, bps + precision + order_bits > 32);
+    } else {
+        return -1;
+    }
+
+    if (wasted) {
+        for (uint32_t i = 0; i < blocksize; i++)
+            out[i] <<= wasted;
+    }
+    return dec->read_error ? -1 : 0;
+}
+
+// --- Frames ---
+
+static int read_utf8_number(flac_decoder_t *dec, uint64_t *value) {
+    uint32_t first = read_bits(dec, 8);
+    int extra;
+    uint64_t v;
+
+    if (!(first & 0x80)) {
+        *value = first;
+        return 0;
+    } else if ((first & 0xE0) == 0xC0) {
+        extra = 1; v = first & 0x1F;
+    } else if ((first & 0xF0) == 0xE0) {
+        extra = 2; v = first & 0x0F;
+    } else if ((first & 0xF8) == 0xF0) {
+        extra = 3; v = first & 0x07;
+    } else if ((first & 0xFC) == 0xF8) {
+        extra = 4; v = first & 0x03;
+    } else if ((first & 0xFE) == 0xFC) {
+        extra = 5; v = first & 0x01;
+    } else if (first == 0xFE) {
+        extra = 6; v = 0;
+    } else {
+        return -1;
+    }
+
+    while (extra--) {
+        uint32_t b = read_bits(dec, 8);
+        if ((b & 0xC0) != 0x80) {
+            return -1;
+        }
+        v = (v << 6) | (b & 0x3F);
+    }
+    *value = v;
+    return 0;
+}
+
+static int ensure_block_buffers(flac_decoder_t *dec, uint32_t channels, uint32_t blocksize) {
+    if (blocksize > dec->max_blocksize) {
+        for (uint32_t c = 0; c < FLAC_MAX_CHANNELS; c++) {
+            free(dec->block[c]);
+            dec->block[c] = NULL;
+        }
+        dec->max_blocksize = blocksize;
+    }
+    for (uint32_t c = 0; c < channels; c++) {
+        if (!dec->block[c]) {
+            dec->block[c] = malloc(dec->max_blocksize * sizeof(int32_t));
+            if (!dec->block[c]) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Decodifica el siguiente frame en dec->block. Devuelve 1 si hay frame,
+// 0 al final del stream y -1 en error.
+static int decode_frame(flac_decoder_t *dec) {
+    reader_align(dec);
+
+    // Buscar el código de sincronización 0xFFF8/0xFFF9
+    long frame_offset;
+    for (;;) {
+        frame_offset = reader_tell(dec);
+        uint32_t b = read_bits(dec, 8);
+        if (dec->read_error) {
+            return 0;
+        }
+        if (b != 0xFF) {
+            continue;
+        }
+        if (dec->cache_bits < 8) {
+            reader_refill(dec);
+        }
+        if (dec->cache_bits >= 8 && (dec->cache >> 57) == (0xF8 >> 1)) {
+            break;
+        }
+    }
+
+    uint32_t variable = read_bits(dec, 8) & 1;
+    uint32_t bs_code = read_bits(dec, 4);
+    uint32_t sr_code = read_bits(dec, 4);
+    uint32_t ch_assign = read_bits(dec, 4);
+    uint32_t ss_code = read_bits(dec, 3);
+    read_bits(dec, 1);
+
+    uint64_t number;
+    if (read_utf8_number(dec, &number) != 0) {
+        return -1;
+    }
+
+    uint32_t blocksize;
+    if (bs_code == 1) {
+        blocksize = 192;
+    } else if (bs_code >= 2 && bs_code <= 5) {
+        blocksize = 576u << (bs_code - 2);
+    } else if (bs_code == 6) {
+        blocksize = read_bits(dec, 8) + 1;
+    } else if (bs_code == 7) {
+        blocksize = read_bits(dec, 16) + 1;
+    } else if (bs_code >= 8) {
+        blocksize = 256u << (bs_code - 8);
+    } else {
+        return -1;
+    }
+
+    // La frecuencia se toma de STREAMINFO; solo se consumen los bits extra
+    if (sr_code == 12) {
+        read_bits(dec, 8);
+    } else if (sr_code == 13 || sr_code == 14) {
+        read_bits(dec, 16);
+    } else if (sr_code == 15) {
+        return -1;
+    }
+
+    static const int sample_sizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+    int bps = ss_code == 0 ? (int)dec->bits_per_sample : sample_sizes[ss_code];
+    if (bps == 0) {
+        return -1;
+    }
+
+    read_bits(dec, 8);                                  // CRC-8 del encabezado
+
+    uint32_t channels = ch_assign < 8 ? ch_assign + 1 : 2;
+    if (ch_assign > 10 || channels > FLAC_MAX_CHANNELS) {
+        return -1;
+    }
+    if (ensure_block_buffers(dec, channels, blocksize) != 0) {
+        return -1;
+    }
+
+    for (uint32_t c = 0; c < channels; c++) {
+        // El canal "side" lleva un bit extra
+        int side = (ch_assign == 8 && c == 1) || (ch_assign == 9 && c == 0) ||
+                   (ch_assign == 10 && c == 1);
+        if (decode_subframe(dec, dec->block[c], blocksize, bps + side) != 0) {
+            return -1;
+        }
+    }
+
+    reader_align(dec);
+    read_bits(dec, 16);                                 // CRC-16 del frame
+    if (dec->read_error) {
+        return -1;
+    }
+
+    // Decorrelación estéreo
+    int32_t *a = dec->block[0], *b = dec->block[1];
+    if (ch_assign == 8) {
+        for (uint32_t i = 0; i < blocksize; i++)
+            b[i] = a[i] - b[i];
+    } else if (ch_assign == 9) {
+        for (uint32_t i = 0; i < blocksize; i++)
+            a[i] += b[i];
+    } else if (ch_assign == 10) {
+        for (uint32_t i = 0; i < blocksize; i++) {
+            int32_t mid = (a[i] << 1) | (b[i] & 1);
+            int32_t side = b[i];
+            a[i] = (mid + side) >> 1;
+            b[i] = (mid - side) >> 1;
+        }
+    }
+
+    uint64_t first_sample = variable ? number : number * dec->min_blocksize;
+
+    // Aprender un punto de búsqueda por cada intervalo que contenga este frame
+    if (dec->seek_interval > 0 &&
+        (first_sample == 0 ||
+         (first_sample + blocksize - 1) / dec->seek_interval != (first_sample - 1) / dec->seek_interval)) {
+        seekpoint_insert(dec, first_sample, (uint64_t)(frame_offset - dec->first_frame_offset));
+    }
+
+    dec->block_channels = channels;
+    dec->block_frames = blocksize;
+    dec->block_pos = 0;
+    dec->block_bps = bps;
+    dec->block_first_sample = first_sample;
+    dec->position = first_sample;
+    return 1;
+}
+
+// --- API ---
+
+int flac_open(flac_decoder_t *dec, const char *path, uint32_t seek_interval) {
+    memset(dec, 0, sizeof(*dec));
+    dec->seek_interval = seek_interval;
+
+    dec->file = fopen(path, "rb");
+    if (!dec->file) {
+        return -1;
+    }
+    dec->buf = malloc(FLAC_READ_BUFFER_SIZE);
+    if (!dec->buf || parse_metadata(dec) != 0) {
+        flac_close(dec);
+        return -1;
+    }
+    if (dec->max_blocksize < 16) {
+        dec->max_blocksize = 65535;
+    }
+    return 0;
+}
+
+void flac_close(flac_decoder_t *dec) {
+    if (dec->file) {
+        fclose(dec->file);
+    }
+    for (uint32_t c = 0; c < FLAC_MAX_CHANNELS; c++) {
+        free(dec->block[c]);
+    }
+    free(dec->buf);
+    free(dec->seekpoints);
+    memset(dec, 0, sizeof(*dec));
+}
+
+int flac_read_frames(flac_decoder_t *dec, int16_t *out, uint32_t frames) {
+    uint32_t produced = 0;
+
+    while (produced < frames) {
+        if (dec->block_pos >= dec->block_frames) {
+            int r = decode_frame(dec);
+            if (r <= 0) {
+                dec->eof = (r == 0);
+                if (r < 0 && produced == 0) {
+                    return -1;
+                }
+                break;
+            }
+        }
+
+        uint32_t n = dec->block_frames - dec->block_pos;
+        if (n > frames - produced) {
+            n = frames - produced;
+        }
+
+        const int32_t *l = dec->block[0] + dec->block_pos;
+        const int32_t *r = dec->block[dec->block_channels > 1 ? 1 : 0] + dec->block_pos;
+        int16_t *o = out + 2 * produced;
+        int shift = (int)dec->block_bps - 16;
+
+        if (shift == 0) {
+            for (uint32_t i = 0; i < n; i++) {
+                o[2 * i] = (int16_t)l[i];
+                o[2 * i + 1] = (int16_t)r[i];
+            }
+        } else if (shift > 0) {
+            for (uint32_t i = 0; i < n; i++) {
+                o[2 * i] = (int16_t)(l[i] >> shift);
+                o[2 * i + 1] = (int16_t)(r[i] >> shift);
+            }
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                o[2 * i] = (int16_t)(l[i] << -shift);
+                o[2 * i + 1] = (int16_t)(r[i] << -shift);
+            }
+        }
+
+        dec->block_pos += n;
+        dec->position += n;
+        produced += n;
+    }
+
+    return (int)produced;
+}
+
+void flac_add_seekpoint(flac_decoder_t *dec, uint64_t sample, uint64_t offset) {
+    seekpoint_insert(dec, sample, offset);
+}
+
+int flac_seek(flac_decoder_t *dec, uint64_t sample) {
+    if (dec->total_samples && sample >= dec->total_samples) {
+        return -1;
+    }
+
+    // Dentro del bloque ya decodificado
+    if (dec->block_frames > 0 && sample >= dec->block_first_sample &&
+        sample < dec->block_first_sample + dec->block_frames) {
+        dec->block_pos = (uint32_t)(sample - dec->block_first_sample);
+        dec->position = sample;
+        return 0;
+    }
+
+    // Saltar al mejor punto conocido salvo que avanzar desde aquí sea más corto
+    const flac_seekpoint_t *point = seekpoint_find(dec, sample);
+    uint64_t point_sample = point ? point->sample : 0;
+    if (!(dec->position <= sample && dec->position >= point_sample)) {
+        long offset = dec->first_frame_offset + (point ? (long)point->offset : 0);
+        if (reader_seek(dec, offset) != 0) {
+            return -1;
+        }
+        dec->block_frames = 0;
+        dec->block_pos = 0;
+        dec->position = point_sample;
+    }
+    dec->eof = 0;
+
+    // Decodificar hacia adelante hasta el frame que contiene el sample
+    for (;;) {
+        if (dec->block_pos >= dec->block_frames) {
+            if (decode_frame(dec) <= 0) {
+                return -1;
+            }
+        }
+        if (sample < dec->block_first_sample + dec->block_frames) {
+            dec->block_pos = (uint32_t)(sample - dec->block_first_sample);
+            dec->position = sample;
+            return 0;
+        }
+        dec->block_pos = dec->block_frames;
+    }
+}
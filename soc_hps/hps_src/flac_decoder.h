@@ -0,0 +1,73 @@
+#ifndef FLAC_DECODER_H
+#define FLAC_DECODER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Decodificador FLAC autocontenido y por streaming.
+// Decodifica frame a frame y entrega PCM estéreo intercalado de 16 bits
+// (mono se duplica, más de 2 canales se recorta a los dos primeros).
+
+#define FLAC_READ_BUFFER_SIZE   (64 * 1024)
+#define FLAC_MAX_CHANNELS       8
+
+// Punto de búsqueda: sample inicial de un frame y su offset en bytes
+// relativo al primer frame del stream
+typedef struct {
+    uint64_t sample;
+    uint64_t offset;
+} flac_seekpoint_t;
+
+typedef struct {
+    FILE *file;
+
+    // STREAMINFO
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t bits_per_sample;
+    uint32_t min_blocksize;
+    uint32_t max_blocksize;
+    uint64_t total_samples;
+
+    // Tabla de búsqueda: SEEKTABLE del archivo + puntos aprendidos al decodificar
+    flac_seekpoint_t *seekpoints;
+    uint32_t num_seekpoints;
+    uint32_t seekpoints_capacity;
+    uint32_t seek_interval;            // Aprender un punto cada N samples
+    long first_frame_offset;
+
+    // Lector de bits sobre buffer de archivo
+    uint8_t *buf;
+    size_t buf_len;
+    size_t buf_pos;
+    long buf_file_offset;              // Offset en archivo de buf[0]
+    uint64_t cache;
+    int cache_bits;
+    int read_error;                    // Se intentó leer más allá del archivo
+
+    // Bloque decodificado pendiente de entregar
+    int32_t *block[FLAC_MAX_CHANNELS];
+    uint32_t block_channels;
+    uint32_t block_frames;
+    uint32_t block_pos;
+    uint32_t block_bps;
+    uint64_t block_first_sample;
+
+    uint64_t position;                 // Siguiente sample a entregar
+    int eof;
+} flac_decoder_t;
+
+int flac_open(flac_decoder_t *dec, const char *path, uint32_t seek_interval);
+void flac_close(flac_decoder_t *dec);
+
+// Decodifica hasta 'frames' frames estéreo en 'out'. Devuelve los frames
+// escritos (0 al final del stream, -1 en error).
+int flac_read_frames(flac_decoder_t *dec, int16_t *out, uint32_t frames);
+
+// Agrega un punto conocido de antes (por ejemplo, de un índice persistente)
+void flac_add_seekpoint(flac_decoder_t *dec, uint64_t sample, uint64_t offset);
+
+// Posiciona el decodificador en el sample 'sample' usando la tabla de búsqueda
+int flac_seek(flac_decoder_t *dec, uint64_t sample);
+
+#endif /* FLAC_DECODER_H */
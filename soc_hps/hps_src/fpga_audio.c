@@ -0,0 +1,250 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "fpga_audio.h"
+
+struct fpga_audio {
+    int sock;
+    int data_fd;                // Cliente → loader
+    int space_fd;               // Loader → cliente
+    fpga_audio_ring_t *ring;
+    size_t map_size;
+    uint32_t mask;
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Espera un aviso del loader. 0 = hubo aviso, -1 con errno (ETIMEDOUT, EPIPE)
+static int wait_space(fpga_audio_t *audio, uint64_t deadline, int timeout_ms) {
+    struct pollfd pfd[2] = {
+        { .fd = audio->space_fd, .events = POLLIN },
+        { .fd = audio->sock, .events = POLLIN },
+    };
+    int wait = -1;
+    uint64_t counter;
+
+    if (timeout_ms >= 0) {
+        uint64_t now = now_ms();
+        if (now >= deadline) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        wait = (int)(deadline - now);
+    }
+
+    if (poll(pfd, 2, wait) < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    if (pfd[1].revents) {
+        // El loader no manda nada por el socket: cualquier evento es que se fue
+        errno = EPIPE;
+        return -1;
+    }
+    if (pfd[0].revents & POLLIN) {
+        if (read(audio->space_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void notify_data(fpga_audio_t *audio) {
+    uint64_t one = 1;
+    if (write(audio->data_fd, &one, sizeof(one)) < 0) {
+        // Contador saturado: el loader ya tiene avisos pendientes
+    }
+}
+
+// Respuesta del loader con los descriptores (SCM_RIGHTS)
+static int receive_reply(int sock, fpga_audio_reply_t *reply, int fds[3]) {
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov = { .iov_base = reply, .iov_len = sizeof(*reply) };
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = control, .msg_controllen = sizeof(control),
+    };
+
+    ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n != sizeof(*reply) || reply->magic != FPGA_AUDIO_MAGIC) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (reply->status != 0) {
+        errno = reply->status;
+        return -1;
+    }
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        errno = EPROTO;
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    return 0;
+}
+
+fpga_audio_t *fpga_audio_open(const char *socket_path, uint32_t sample_rate, uint32_t ring_frames,
+                              uint32_t flags) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    fpga_audio_hello_t hello = {
+        .magic = FPGA_AUDIO_MAGIC, .version = FPGA_AUDIO_VERSION,
+        .sample_rate = sample_rate, .ring_frames = ring_frames, .flags = flags,
+    };
+    fpga_audio_reply_t reply;
+    int fds[3] = { -1, -1, -1 };
+    int saved;
+
+    fpga_audio_t *audio = calloc(1, sizeof(*audio));
+    if (!audio) {
+        return NULL;
+    }
+    audio->sock = -1;
+    audio->data_fd = -1;
+    audio->space_fd = -1;
+
+    if (!socket_path) {
+        socket_path = FPGA_AUDIO_SOCKET_DEFAULT;
+    }
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        goto fail;
+    }
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+
+    audio->sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (audio->sock < 0 || connect(audio->sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        send(audio->sock, &hello, sizeof(hello), MSG_NOSIGNAL) != sizeof(hello) ||
+        receive_reply(audio->sock, &reply, fds) != 0) {
+        goto fail;
+    }
+    audio->data_fd = fds[1];
+    audio->space_fd = fds[2];
+
+    audio->map_size = fpga_audio_ring_size(reply.ring_frames);
+    audio->ring = mmap(NULL, audio->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    fds[0] = -1;
+    if (audio->ring == MAP_FAILED) {
+        audio->ring = NULL;
+        goto fail;
+    }
+    if (audio->ring->magic != FPGA_AUDIO_MAGIC || audio->ring->ring_frames != reply.ring_frames) {
+        errno = EPROTO;
+        goto fail;
+    }
+    audio->mask = reply.ring_frames - 1;
+    return audio;
+
+fail:
+    saved = errno;
+    if (fds[0] >= 0) {
+        close(fds[0]);
+    }
+    fpga_audio_close(audio);
+    errno = saved;
+    return NULL;
+}
+
+int fpga_audio_write_frames(fpga_audio_t *audio, const int16_t *pcm, uint32_t frames, int timeout_ms) {
+    fpga_audio_ring_t *ring = audio->ring;
+    uint64_t deadline = now_ms() + (timeout_ms > 0 ? timeout_ms : 0);
+    uint32_t written = 0;
+
+    while (written < frames) {
+        uint64_t tail = atomic_load_explicit(&ring->write_frames, memory_order_relaxed);
+        uint64_t head = atomic_load_explicit(&ring->read_frames, memory_order_acquire);
+        uint32_t space = ring->ring_frames - (uint32_t)(tail - head);
+
+        if (space == 0) {
+            if (wait_space(audio, deadline, timeout_ms) != 0) {
+                if (errno == ETIMEDOUT && written > 0) {
+                    break;
+                }
+                return -1;
+            }
+            continue;
+        }
+
+        // Hasta el final del anillo y el resto desde el principio
+        uint32_t count = frames - written;
+        if (count > space) {
+            count = space;
+        }
+        uint32_t start = (uint32_t)tail & audio->mask;
+        uint32_t first = ring->ring_frames - start;
+        if (first > count) {
+            first = count;
+        }
+        memcpy(&ring->samples[start * 2], pcm + written * 2, first * 4);
+        memcpy(&ring->samples[0], pcm + (written + first) * 2, (count - first) * 4);
+
+        atomic_store_explicit(&ring->write_frames, tail + count, memory_order_release);
+        notify_data(audio);
+        written += count;
+    }
+    return (int)written;
+}
+
+int fpga_audio_drain(fpga_audio_t *audio, int timeout_ms) {
+    uint64_t deadline = now_ms() + (timeout_ms > 0 ? timeout_ms : 0);
+    uint64_t target = atomic_load_explicit(&audio->ring->write_frames, memory_order_relaxed);
+
+    while (atomic_load_explicit(&audio->ring->played_frames, memory_order_acquire) < target) {
+        if (wait_space(audio, deadline, timeout_ms) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int fpga_audio_get_position(fpga_audio_t *audio, uint64_t *played, uint64_t *written) {
+    if (played) {
+        *played = atomic_load_explicit(&audio->ring->played_frames, memory_order_acquire);
+    }
+    if (written) {
+        *written = atomic_load_explicit(&audio->ring->write_frames, memory_order_relaxed);
+    }
+    return 0;
+}
+
+int fpga_audio_set_volume(fpga_audio_t *audio, uint32_t percent) {
+    if (percent > FPGA_AUDIO_VOLUME_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    atomic_store_explicit(&audio->ring->volume, percent, memory_order_relaxed);
+    notify_data(audio);
+    return 0;
+}
+
+void fpga_audio_close(fpga_audio_t *audio) {
+    if (!audio) {
+        return;
+    }
+    if (audio->ring) {
+        munmap(audio->ring, audio->map_size);
+    }
+    if (audio->data_fd >= 0) {
+        close(audio->data_fd);
+    }
+    if (audio->space_fd >= 0) {
+        close(audio->space_fd);
+    }
+    if (audio->sock >= 0) {
+        close(audio->sock);
+    }
+    free(audio);
+}
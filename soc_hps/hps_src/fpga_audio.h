@@ -0,0 +1,43 @@
+#ifndef FPGA_AUDIO_H
+#define FPGA_AUDIO_H
+
+#include <stdint.h>
+#include "fpga_audio_proto.h"     // FPGA_AUDIO_SOCKET_DEFAULT, FPGA_AUDIO_VOLUME_MAX
+
+// libfpgaaudio: reproducir por el camino FPGA desde cualquier proceso del
+// HPS, sin root ni /dev/mem. Habla con hps_audio_loader --serve por un
+// socket Unix; las muestras van por un anillo en memoria compartida y los
+// avisos por eventfd (ver fpga_audio_proto.h).
+//
+// Frames estéreo de 16 bits intercalados, a la tasa pedida en open (el
+// loader convierte a la de la mezcla). Hasta FPGA_AUDIO_MAX_CLIENTS suenan
+// juntos: open falla con EBUSY si ya están todos.
+//
+// Las funciones devuelven -1 con errno en caso de error (EPIPE: el loader
+// se fue; ETIMEDOUT: se agotó timeout_ms). timeout_ms < 0 espera sin límite.
+
+typedef struct fpga_audio fpga_audio_t;
+
+// socket_path NULL = FPGA_AUDIO_SOCKET_DEFAULT; ring_frames 0 = por defecto;
+// flags: FPGA_AUDIO_FLAG_DUCK para alertas que deben oírse sobre la música
+fpga_audio_t *fpga_audio_open(const char *socket_path, uint32_t sample_rate, uint32_t ring_frames,
+                              uint32_t flags);
+
+// Copia hasta 'frames' frames al anillo, esperando espacio hasta timeout_ms.
+// Devuelve los frames escritos (menos que 'frames' solo si se agotó el tiempo).
+int fpga_audio_write_frames(fpga_audio_t *audio, const int16_t *pcm, uint32_t frames, int timeout_ms);
+
+// Espera a que el Nios reproduzca todo lo escrito. 0 o -1.
+int fpga_audio_drain(fpga_audio_t *audio, int timeout_ms);
+
+// Frames reproducidos desde open (a la tasa del cliente) y escritos
+int fpga_audio_get_position(fpga_audio_t *audio, uint64_t *played, uint64_t *written);
+
+// Volumen de este cliente en la mezcla, en porcentaje (100 = sin cambio,
+// hasta FPGA_AUDIO_VOLUME_MAX). El volumen general sigue siendo el del loader.
+int fpga_audio_set_volume(fpga_audio_t *audio, uint32_t percent);
+
+// Lo que quede en el anillo se reproduce igual
+void fpga_audio_close(fpga_audio_t *audio);
+
+#endif /* FPGA_AUDIO_H */
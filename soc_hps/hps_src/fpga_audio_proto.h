@@ -0,0 +1,66 @@
+#ifndef FPGA_AUDIO_PROTO_H
+#define FPGA_AUDIO_PROTO_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Protocolo entre libfpgaaudio y el loader (--serve). El cliente se conecta
+// al socket Unix y manda un hello; el loader contesta con un reply y, si
+// acepta, pasa por SCM_RIGHTS tres descriptores:
+//   [0] memfd con el anillo (fpga_audio_ring_t + muestras), mapeado por los dos
+//   [1] eventfd de datos: el cliente avisa que escribió
+//   [2] eventfd de espacio: el loader avisa que consumió o avanzó la posición
+// Después el socket solo sirve para detectar que el otro lado se fue.
+//
+// Las muestras son estéreo de 16 bits intercalado a la tasa del hello. El
+// anillo es de un productor (cliente) y un consumidor (loader), sin locks:
+// write_frames y read_frames son contadores libres como en spsc_queue.
+//
+// El loader mezcla hasta FPGA_AUDIO_MAX_CLIENTS clientes a la vez, cada uno
+// con su volumen; con FPGA_AUDIO_FLAG_DUCK (alertas) los demás bajan
+// mientras ese cliente tiene audio.
+
+#define FPGA_AUDIO_SOCKET_DEFAULT   "/run/fpga_audio.sock"
+#define FPGA_AUDIO_MAGIC            0x41475046      // "FPGA"
+#define FPGA_AUDIO_VERSION          2
+#define FPGA_AUDIO_MAX_CLIENTS      4
+
+#define FPGA_AUDIO_RING_DEFAULT     8192    // Frames: 170 ms a 48 kHz
+#define FPGA_AUDIO_RING_MIN         1024
+#define FPGA_AUDIO_RING_MAX         65536
+#define FPGA_AUDIO_VOLUME_MAX       400             // VOLUME_MAX del loader (+12 dB)
+#define FPGA_AUDIO_VOLUME_UNSET     UINT32_MAX      // El cliente no pidió volumen
+
+#define FPGA_AUDIO_FLAG_DUCK        1               // Baja a los demás clientes mientras suena
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sample_rate;
+    uint32_t ring_frames;       // Pedido (0 = por defecto); el loader lo ajusta
+    uint32_t flags;             // FPGA_AUDIO_FLAG_*
+} fpga_audio_hello_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    int32_t status;             // 0 o un errno (EBUSY: ya hay FPGA_AUDIO_MAX_CLIENTS)
+    uint32_t ring_frames;       // Potencia de 2
+    uint32_t codec_rate;        // Tasa a la que suena (convertida si difiere)
+} fpga_audio_reply_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sample_rate;
+    uint32_t ring_frames;
+    _Atomic uint32_t volume;            // Cliente: su volumen en la mezcla o FPGA_AUDIO_VOLUME_UNSET
+    _Alignas(64) _Atomic uint64_t write_frames;     // Cliente
+    _Alignas(64) _Atomic uint64_t read_frames;      // Loader: pasados al pipeline
+    _Atomic uint64_t played_frames;                 // Loader: reproducidos por el Nios
+    _Alignas(64) int16_t samples[];                 // ring_frames * 2
+} fpga_audio_ring_t;
+
+static inline uint64_t fpga_audio_ring_size(uint32_t ring_frames) {
+    return sizeof(fpga_audio_ring_t) + (uint64_t)ring_frames * 4;
+}
+
+#endif /* FPGA_AUDIO_PROTO_H */
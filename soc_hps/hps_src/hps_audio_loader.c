@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -5,8 +6,33 @@
 #include <sys/mman.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <signal.h>
 #include <errno.h> 
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include "audio_dsp.h"
+#include "flac_decoder.h"
+#include "adpcm.h"
+#include "nios_profile.h"
+#include "wav_writer.h"
+#include "wav_reader.h"
+#include "spsc_queue.h"
+#include "latency_hist.h"
+#include "playlist.h"
+#include "library_index.h"
+#include "dir_watch.h"
+#include "pcm_ingest.h"
+#include "audio_server.h"
+#include "audio_mixer.h"
+#include "library_analysis.h"
+#include "native_track.h"
 
 // Direcciones base del bridge (mismas del ejemplo funcional)
 #define HW_REGS_BASE ( 0xff200000 )
@@ -22,7 +48,29 @@
 #define MEMORY_SIZE           0x20000     // 128 KB
 #define AUDIO_CHUNK_SIZE      (30 * 1024) // 30 KB chunks (más pequeños)
 #define CONTROL_SIZE          1024        // 1 KB para control
-#define MAX_AUDIO_SIZE        (120 * 1024) // Máximo 120 KB para audio
+#define MAX_AUDIO_SIZE        (63 * 1024)  // Máximo 63 KB para audio (chunk de 30 KB + margen)
+#define FRAMES_PER_CHUNK      (AUDIO_CHUNK_SIZE / 4) // Frames estéreo 16 bits por chunk
+
+// Ring de grabación (line-in): frames estéreo de 16 bits escritos por el Nios
+#define RECORD_RING_OFFSET    0x10000
+#define RECORD_RING_SIZE      0xF000      // 60 KB, hasta el área de perfil
+#define RECORD_RING_FRAMES    (RECORD_RING_SIZE / 4)  // 15360 frames = 320 ms a 48 kHz
+#define RECORD_POLL_US        5000        // Vaciar cada 5 ms (~1/64 del ring)
+
+// Transporte IMA-ADPCM: 30 bloques de 1 KB por chunk. Múltiplo de
+// LIMITER_BLOCK_FRAMES para que el limitador entregue el chunk completo.
+#define ADPCM_FRAMES_PER_CHUNK  30464     // ~0.63 s a 48 kHz (PCM: 0.16 s)
+#define MAX_CHUNK_FRAMES        ADPCM_FRAMES_PER_CHUNK
+
+// Formato de las muestras en el chunk compartido
+#define SAMPLE_FORMAT_PCM16   0
+#define SAMPLE_FORMAT_ADPCM   1
+#define SAMPLE_FORMAT_PCM24   2   // 96 kHz: palabras de 24 bits del codec en dos slots alternados
+
+// Alta tasa: mientras el Nios vacía un slot el HPS carga el otro
+#define HIRATE_RATE           96000
+#define HIRATE_SLOT_SIZE      0x7E00      // 31.5 KB: los dos slots ocupan MAX_AUDIO_SIZE
+#define HIRATE_SLOT_FRAMES    (HIRATE_SLOT_SIZE / 8)  // 4032 frames = 42 ms a 96 kHz
 
 // Comandos
 #define CMD_NONE    0
@@ -31,11 +79,17 @@
 #define CMD_STOP    3
 #define CMD_NEXT    4
 #define CMD_PREV    5
+#define CMD_VOLUME  6   // Nuevo volumen en 'volume' (porcentaje)
+#define CMD_RECORD       7   // Iniciar captura de line-in al ring
+#define CMD_RECORD_STOP  8   // Detener captura
+#define CMD_LATENCY      9   // Medir latencia de ida y vuelta (loopback salida → line-in)
 
 // Estados
 #define STATUS_READY    0
 #define STATUS_PLAYING  1
 #define STATUS_PAUSED   2
+#define STATUS_RECORDING 3
+#define STATUS_MEASURING 4
 
 // Estructura compacta y optimizada
 typedef struct __attribute__((packed)) {
@@ -43,7 +97,7 @@ typedef struct __attribute__((packed)) {
     volatile uint32_t magic;           // 0xABCD2025
     volatile uint32_t command;         // HPS → NIOS comandos
     volatile uint32_t status;          // NIOS → HPS estado
-    volatile uint32_t song_id;         // Canción actual (0-2)
+    volatile uint32_t song_id;         // Pista actual (índice en la playlist)
     
     // Control de chunks (16 bytes)
     volatile uint32_t chunk_ready;     // 1=HPS cargó, 0=NIOS consumió
@@ -54,23 +108,65 @@ typedef struct __attribute__((packed)) {
     // Información de canción (16 bytes)
     volatile uint32_t total_chunks;    // Total chunks de la canción
     volatile uint32_t song_total_size; // Tamaño total del archivo
-    volatile uint32_t song_position;   // Posición actual en bytes
+    volatile uint32_t song_position;   // NIOS: posición reproducida en bytes PCM (frames * 4)
     volatile uint32_t duration_sec;    // Duración en segundos
     
     // Sistema y comunicación (16 bytes)
     volatile uint32_t hps_connected;   // 1=HPS activo
     volatile uint32_t fpga_heartbeat;  // Contador de NIOS
-    volatile uint32_t sample_rate;     // 48000 Hz
+    volatile uint32_t sample_rate;     // Tasa de la canción actual (el NIOS reprograma el codec)
     volatile uint32_t channels;        // 2 (estéreo)
     
     // Estado y debugging (16 bytes)
     volatile uint32_t buffer_level;    // Nivel de buffer (0-100%)
     volatile uint32_t error_flags;     // Flags de error
-    volatile uint32_t bytes_played;    // Bytes reproducidos total
+    volatile uint32_t bytes_played;    // NIOS: bytes PCM entregados al codec (32 bits bajos)
     volatile uint32_t chunks_loaded;   // Total de chunks cargados
     
-    // Reservado para expansión (176 bytes = 256 bytes total)
-    volatile uint32_t reserved[44];
+    // Volumen y limitador (8 bytes)
+    volatile uint32_t volume;          // Volumen en % (100 = unitario, máx 400)
+    volatile uint32_t limiter_gain;    // Menor ganancia del limitador en el último chunk (Q12)
+    
+    // Transporte (16 bytes)
+    volatile uint32_t sample_format;     // SAMPLE_FORMAT_PCM16 / SAMPLE_FORMAT_ADPCM
+    volatile uint32_t chunk_frames;      // Frames de audio en el chunk actual
+    volatile uint32_t decode_cycles;     // NIOS: ciclos promedio por frame ADPCM (últimos 500 ms)
+    volatile uint32_t decode_cycles_max; // NIOS: peor lote, ciclos por frame
+    
+    // Contador de frames y marca de tiempo (24 bytes). Leer con position_seq:
+    // impar = el NIOS está escribiendo, reintentar si cambia durante la lectura
+    volatile uint32_t position_seq;
+    volatile uint32_t frames_played_lo;  // Frames entregados al FIFO del codec (64 bits)
+    volatile uint32_t frames_played_hi;
+    volatile uint32_t frames_ticks_lo;   // Ticks NIOS de la última actualización (64 bits)
+    volatile uint32_t frames_ticks_hi;
+    volatile uint32_t ticks_freq;        // Frecuencia de los ticks (Hz)
+    
+    // Grabación (16 bytes)
+    volatile uint32_t rec_write_frames;  // NIOS: frames escritos en el ring (contador libre)
+    volatile uint32_t rec_read_frames;   // HPS: frames consumidos del ring
+    volatile uint32_t rec_dropped;       // NIOS: frames perdidos por ring lleno
+    volatile uint32_t rec_fifo_full;     // NIOS: lecturas con el FIFO de entrada lleno (posible pérdida)
+    
+    // Latencia (32 bytes), en frames salvo lat_cmd_ticks
+    volatile uint32_t lat_pulses;        // NIOS: pulsos detectados
+    volatile uint32_t lat_timeouts;      // NIOS: pulsos no detectados
+    volatile uint32_t lat_min;           // NIOS: ida y vuelta mínima
+    volatile uint32_t lat_max;           // NIOS: ida y vuelta máxima
+    volatile uint32_t lat_sum;           // NIOS: suma de ida y vuelta (promedio = sum / pulses)
+    volatile uint32_t lat_queue_sum;     // NIOS: suma de la ocupación del FIFO de salida al escribir cada pulso
+    volatile uint32_t lat_first;         // NIOS: ida y vuelta del primer pulso (FIFO de salida vacío)
+    volatile uint32_t lat_cmd_ticks;     // NIOS: ticks desde ver CMD_LATENCY hasta escribir el primer pulso
+    
+    // Alta tasa, PCM24 en dos slots (24 bytes)
+    volatile uint32_t slot_bytes[2];     // HPS: bytes cargados en cada slot; NIOS: 0 al terminarlo
+    volatile uint32_t hirate_cycles;     // NIOS: ciclos por frame promedio (últimos 500 ms)
+    volatile uint32_t hirate_cycles_max; // NIOS: ciclos por frame del lote más largo
+    volatile uint32_t hirate_underruns;  // NIOS: FIFO de salida encontrado vacío con datos en el slot
+    volatile uint32_t hirate_fallback;   // NIOS: 1 = presupuesto excedido, el HPS debe pasar a 48 kHz
+    
+    // Reservado para expansión (56 bytes = 256 bytes total)
+    volatile uint32_t reserved[14];
 } compact_shared_control_t;
 
 // Variables globales
@@ -78,8 +174,24 @@ int fd = -1;
 void *virtual_base = NULL;
 volatile compact_shared_control_t *shared_ctrl = NULL;
 volatile uint8_t *shared_audio = NULL;
+volatile profile_area_t *shared_profile = NULL;
+volatile isr_stats_area_t *shared_isr_stats = NULL;
+volatile uint32_t *shared_record_ring = NULL;
+
+// Playlist por defecto: SONGS_DIR/playlist.m3u o, si no existe, los
+// .flac/.wav del directorio por nombre (X.flac tapa a X.wav). Con inotify
+// las pistas agregadas, quitadas o reemplazadas se aplican sin reiniciar.
+#define SONGS_DIR           "/media/sd/songs"
+#define TRACK_CACHE_SIZE    4       // Archivos abiertos a la vez, los del hilo de lectura
+#define LIBRARY_INDEX_DEFAULT  SONGS_DIR "/library.idx"
+
+// Formatos de canción
+#define SONG_FORMAT_WAV   0
+#define SONG_FORMAT_FLAC  1
+#define SONG_FORMAT_NATIVE 2    // .ntrk: palabras del codec ya armadas (--transcode)
 
-#define MAX_TRACKS 3
+// Tasas que el WM8731 genera con MCLK de 12.288 MHz; el resto se convierte a 48 kHz
+#define CODEC_DEFAULT_RATE  48000
 
 typedef struct {
     char filename[256];
@@ -87,11 +199,78 @@ typedef struct {
     uint32_t num_chunks;
     uint32_t duration_sec;
     FILE* file_handle;
+    int format;                 // SONG_FORMAT_WAV / SONG_FORMAT_FLAC
+    uint32_t sample_rate;       // Tasa del archivo
+    uint32_t bits_per_sample;   // WAV: 16 o 24 (FLAC se decodifica a 16)
+    uint32_t channels;          // Del archivo; mono se duplica a los dos canales
+    uint32_t data_offset;       // WAV: inicio del chunk data
+    uint64_t total_frames;      // Frames del archivo
+    uint32_t codec_rate;        // Tasa a la que se reproduce
+    uint32_t transport;         // SAMPLE_FORMAT_* del bridge para esta canción
+    uint32_t src_chunk_frames;  // Frames del archivo por chunk (menos si se convierte)
+    flac_decoder_t flac;        // Solo para FLAC (file_handle apunta a flac.file)
+    native_track_t native;      // Solo para .ntrk (file_handle apunta a native.file)
+    int track;                  // Índice en la playlist
+    uint32_t last_use;          // Para desalojar del caché la menos usada
+    int library_record;         // Registro en el índice, -1 si no tiene
+    uint32_t indexed_points;    // FLAC: puntos de búsqueda ya guardados en el índice
+    int32_t gain;               // --replaygain (Q12), LIMITER_UNITY_GAIN sin análisis
+    uint64_t trim_start;        // --trim-silence: frames del archivo antes del frame 0
 } song_info_t;
 
-song_info_t songs[MAX_TRACKS];
-int current_song = 0;
-int current_chunk = 0;
+playlist_t playlist;
+
+// Índice de la biblioteca: control lo abre al arrancar, después es del hilo de lectura
+library_index_t library;
+const char *library_path = LIBRARY_INDEX_DEFAULT;
+
+// Ingesta (--ingest): el audio llega de otro proceso en lugar de la playlist
+const char *ingest_spec = NULL;
+uint32_t ingest_rate = CODEC_DEFAULT_RATE;     // Tasa del PCM crudo (sin cabecera WAV)
+pcm_ingest_t ingest;
+
+// Servidor de libfpgaaudio (--serve): los clientes mandan audio por memoria compartida
+int serve_mode = 0;
+const char *serve_path = FPGA_AUDIO_SOCKET_DEFAULT;
+audio_server_t server = { .listen_fd = -1, .wake_fd = -1 };
+
+// Caché de pistas abiertas: solo lo toca el hilo de lectura
+static song_info_t track_cache[TRACK_CACHE_SIZE];
+static uint32_t track_cache_clock = 0;
+
+// Crossfade entre pistas (--crossfade), 0 = corte seco
+#define CROSSFADE_MAX_MS    10000
+uint32_t crossfade_ms = 0;
+
+// Análisis de la biblioteca (loudness, pico, silencio): lo hacen hilos de
+// baja prioridad para cada pista de la playlist; --replaygain y
+// --trim-silence lo aplican al abrir las que ya lo tienen
+#define ANALYSIS_DB_DEFAULT     SONGS_DIR "/library.analysis"
+analysis_db_t analysis;
+const char *analysis_path = ANALYSIS_DB_DEFAULT;
+int analysis_started = 0;
+int replaygain_mode = 0;
+int trim_silence_mode = 0;
+
+// Transporte elegido al arrancar (--adpcm)
+uint32_t sample_format = SAMPLE_FORMAT_PCM16;
+uint32_t chunk_frames = FRAMES_PER_CHUNK;
+
+// Staging en DRAM. staging_in: bench_flac. staging_s24: hilo de lectura.
+// El resto, con el limitador, ADPCM y el resampler: hilo de transformación.
+static int16_t staging_in[MAX_CHUNK_FRAMES * 2];
+static int16_t staging_out[MAX_CHUNK_FRAMES * 2 + LIMITER_BLOCK_FRAMES * 4];  // + limiter_flush
+static limiter_t limiter;
+static adpcm_state_t adpcm_state[2];
+static int16_t staging_resampled[MAX_CHUNK_FRAMES * 2];
+static resampler_t resampler;
+static int resampler_track = -1;    // Pista y chunk que continúan el estado del resampler
+static int resampler_next_chunk = -1;
+static uint32_t limiter_generation = UINT32_MAX;  // Stream que sigue el estado del limitador y del ADPCM
+static uint8_t staging_s24[MAX_CHUNK_FRAMES * 6];
+
+// Alta tasa: control la desactiva si el Nios pide fallback, lectura la consulta
+static _Atomic int hirate_disabled = 0;
 
 void cleanup_and_exit(int sig) {
     printf("\nLimpiando recursos...\n");
@@ -100,10 +279,12 @@ void cleanup_and_exit(int sig) {
         shared_ctrl->hps_connected = 0;
     }
     
-    for (int i = 0; i < MAX_TRACKS; i++) {
-        if (songs[i].file_handle) {
-            fclose(songs[i].file_handle);
-        }
+    // Los archivos de las pistas son del hilo de lectura: los cierra exit()
+    if (ingest.bound) {
+        unlink(ingest.path);
+    }
+    if (server.bound) {
+        unlink(server.path);
     }
     
     if (virtual_base != NULL) {
@@ -137,6 +318,14 @@ int verify_memory_layout() {
     printf("  Control: 0x0000 - 0x%04x (%zu bytes)\n", control_end, sizeof(compact_shared_control_t));
     printf("  Gap: 0x%04x - 0x%04x (%d bytes)\n", control_end, audio_start, audio_start - control_end);
     printf("  Audio: 0x%04x - 0x%04x (%d bytes)\n", audio_start, audio_end, MAX_AUDIO_SIZE);
+    printf("  Slots PCM24: 0x%04x / 0x%04x (%d bytes c/u)\n", audio_start,
+           audio_start + HIRATE_SLOT_SIZE, HIRATE_SLOT_SIZE);
+    printf("  Ring grabación: 0x%05x - 0x%05x (%d bytes)\n", RECORD_RING_OFFSET,
+           RECORD_RING_OFFSET + RECORD_RING_SIZE, RECORD_RING_SIZE);
+    printf("  Perfil Nios: 0x%05x - 0x%05x (%d bytes)\n", PROFILE_OFFSET,
+           PROFILE_OFFSET + PROFILE_SIZE, PROFILE_SIZE);
+    printf("  Estadísticas ISR: 0x%05x - 0x%05x (%d bytes)\n", ISR_STATS_OFFSET,
+           ISR_STATS_OFFSET + ISR_STATS_SIZE, ISR_STATS_SIZE);
     printf("  Total usado: %d bytes de %d disponibles\n", audio_end, MEMORY_SIZE);
     
     if (audio_end > MEMORY_SIZE) {
@@ -151,17 +340,24 @@ int verify_memory_layout() {
         return -1;
     }
     
-    printf("✓ Layout de memoria verificado - todo cabe en 128 KB\n");
-    return 0;
-}
-
-int map_shared_memory() {
-    printf("=== Mapeando Memoria Compartida (128 KB) ===\n");
+    if (audio_end > RECORD_RING_OFFSET || RECORD_RING_OFFSET + RECORD_RING_SIZE > PROFILE_OFFSET) {
+        printf("ERROR: Ring de grabación se superpone con audio o perfil!\n");
+        return -1;
+    }
     
-    if (verify_memory_layout() != 0) {
+    if (audio_end > PROFILE_OFFSET || PROFILE_OFFSET + PROFILE_SIZE > ISR_STATS_OFFSET ||
+        ISR_STATS_OFFSET + ISR_STATS_SIZE > MEMORY_SIZE ||
+        sizeof(profile_area_t) > PROFILE_SIZE || sizeof(isr_stats_area_t) > ISR_STATS_SIZE) {
+        printf("ERROR: Área de perfil/estadísticas se superpone o no cabe!\n");
         return -1;
     }
     
+    printf("✓ Layout de memoria verificado - todo cabe en 128 KB\n");
+    return 0;
+}
+
+// Mapea el bridge real a través de /dev/mem
+static int map_devmem() {
     // Abrir /dev/mem
     if ((fd = open("/dev/mem", (O_RDWR | O_SYNC))) == -1) {
         printf("ERROR: No se pudo abrir /dev/mem: %s\n", strerror(errno));
@@ -178,12 +374,64 @@ int map_shared_memory() {
         return -1;
     }
     printf("✓ Memoria mapeada en: %p\n", virtual_base);
+    return 0;
+}
+
+// Emulación: la memoria compartida es un archivo de 128 KB que también mapea
+// el emulador del Nios (soc_system/software/nios_emu). El resto del span
+// del bridge queda como memoria anónima.
+static int map_emulated(const char *path) {
+    if ((fd = open(path, O_RDWR)) == -1) {
+        printf("ERROR: No se pudo abrir %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    
+    virtual_base = mmap(NULL, HW_REGS_SPAN, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (virtual_base == MAP_FAILED ||
+        mmap(virtual_base + SHARED_MEMORY_OFFSET, MEMORY_SIZE, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        printf("ERROR: mmap() del emulador falló: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    printf("✓ Memoria compartida emulada: %s\n", path);
+    return 0;
+}
+
+// Mapea el bridge sin tocar la memoria compartida.
+// Con FPGA_AUDIO_EMU=<archivo> se usa el emulador en lugar de /dev/mem.
+int map_bridge() {
+    const char *emu_path = getenv("FPGA_AUDIO_EMU");
+    
+    if ((emu_path ? map_emulated(emu_path) : map_devmem()) != 0) {
+        return -1;
+    }
     
     // Calcular punteros
     shared_ctrl = (compact_shared_control_t *)(virtual_base + 
                   ((SHARED_MEMORY_OFFSET + CONTROL_OFFSET) & (HW_REGS_MASK)));
     shared_audio = (uint8_t *)(virtual_base + 
                    ((SHARED_MEMORY_OFFSET + AUDIO_DATA_OFFSET) & (HW_REGS_MASK)));
+    shared_profile = (profile_area_t *)(virtual_base + 
+                     ((SHARED_MEMORY_OFFSET + PROFILE_OFFSET) & (HW_REGS_MASK)));
+    shared_isr_stats = (isr_stats_area_t *)(virtual_base + 
+                       ((SHARED_MEMORY_OFFSET + ISR_STATS_OFFSET) & (HW_REGS_MASK)));
+    shared_record_ring = (uint32_t *)(virtual_base + 
+                         ((SHARED_MEMORY_OFFSET + RECORD_RING_OFFSET) & (HW_REGS_MASK)));
+    return 0;
+}
+
+int map_shared_memory() {
+    printf("=== Mapeando Memoria Compartida (128 KB) ===\n");
+    
+    if (verify_memory_layout() != 0) {
+        return -1;
+    }
+    
+    if (map_bridge() != 0) {
+        return -1;
+    }
     
     printf("Layout mapeado:\n");
     printf("  Base virtual: %p\n", virtual_base);
@@ -205,184 +453,2834 @@ int map_shared_memory() {
     }
 }
 
-int load_songs() {
-    printf("=== Cargando Canciones ===\n");
+static uint32_t codec_rate_for(uint32_t rate) {
+    switch (rate) {
+        case 8000:
+        case 32000:
+        case 48000:
+            return rate;
+        case HIRATE_RATE:
+            return atomic_load(&hirate_disabled) ? CODEC_DEFAULT_RATE : rate;
+        default:
+            return CODEC_DEFAULT_RATE;
+    }
+}
+
+// Lee 'frames' frames de un WAV de 16 o 24 bits, mono o estéreo, como
+// estéreo a 16 bits en 'out16' o a palabras de 24 bits del codec en 'out24'
+// (el otro es NULL; out24 solo con archivos de 24 bits). Nunca pasa del
+// final del chunk data (o del recorte de --trim-silence).
+static uint32_t wav_read_frames(song_info_t *song, uint64_t first_frame, uint32_t frames,
+                                int16_t *out16, int32_t *out24) {
+    uint32_t channels = song->channels;
+    uint32_t frame_bytes = song->bits_per_sample / 8 * channels;
+    uint32_t read;
     
-    const char* song_paths[MAX_TRACKS] = {
-        "/media/sd/songs/song1.wav",
-        "/media/sd/songs/song2.wav", 
-        "/media/sd/songs/song3.wav"
-    };
+    if (first_frame >= song->total_frames) {
+        return 0;
+    }
+    if (frames > song->total_frames - first_frame) {
+        frames = (uint32_t)(song->total_frames - first_frame);
+    }
+    if (fseek(song->file_handle, song->data_offset + (song->trim_start + first_frame) * frame_bytes, SEEK_SET) != 0) {
+        return 0;
+    }
     
-    int loaded = 0;
+    if (song->bits_per_sample != 24) {
+        if (!out16) {
+            return 0;
+        }
+        read = fread(out16, frame_bytes, frames, song->file_handle);
+        // Mono: se abre a estéreo en el mismo buffer, de atrás hacia adelante
+        for (uint32_t i = read; channels == 1 && i-- > 0; ) {
+            int16_t sample = out16[i];
+            out16[2 * i] = sample;
+            out16[2 * i + 1] = sample;
+        }
+        return read;
+    }
     
-    for (int i = 0; i < MAX_TRACKS; i++) {
-        songs[i].file_handle = fopen(song_paths[i], "rb");
-        if (songs[i].file_handle) {
-            fseek(songs[i].file_handle, 0, SEEK_END);
-            songs[i].file_size = ftell(songs[i].file_handle);
-            fseek(songs[i].file_handle, 0, SEEK_SET);
-            
-            // Calcular chunks de 30KB
-            songs[i].num_chunks = (songs[i].file_size + AUDIO_CHUNK_SIZE - 1) / AUDIO_CHUNK_SIZE;
-            songs[i].duration_sec = songs[i].file_size / (48000 * 2 * 2);
-            strcpy(songs[i].filename, song_paths[i]);
-            
-            printf("✓ Canción %d: %s\n", i+1, songs[i].filename);
-            printf("    %.1f MB, %d chunks de %d KB\n", 
-                   songs[i].file_size/1024.0/1024.0, 
-                   songs[i].num_chunks, AUDIO_CHUNK_SIZE/1024);
-            printf("    Duración: ~%d segundos\n", songs[i].duration_sec);
-            
-            loaded++;
+    read = fread(staging_s24, frame_bytes, frames, song->file_handle);
+    for (uint32_t i = 0; i < read * 2; i++) {
+        const uint8_t *b = staging_s24 + 3 * (channels == 2 ? i : i / 2);
+        int32_t sample = (int32_t)((b[0] << 8) | (b[1] << 16) | ((uint32_t)b[2] << 24)) >> 8;
+        if (out24) {
+            out24[i] = sample;
         } else {
-            printf("⚠ No se pudo abrir: %s\n", song_paths[i]);
+            out16[i] = (int16_t)(sample >> 8);
         }
     }
+    return read;
+}
+
+// Tasa de reproducción, transporte y tamaño de chunk en frames del archivo
+static void set_song_transport(song_info_t *song) {
+    if (song->format == SONG_FORMAT_NATIVE) {
+        // El archivo fija tasa, transporte y chunks. Sin alta tasa (fallback
+        // del Nios) no hay cómo tocar uno de 96 kHz: sin chunks, se salta.
+        const native_header_t *h = &song->native.header;
+        song->codec_rate = song->sample_rate;
+        song->transport = (h->format == NATIVE_FORMAT_PCM24) ? SAMPLE_FORMAT_PCM24 : SAMPLE_FORMAT_PCM16;
+        song->src_chunk_frames = h->chunk_frames;
+        song->num_chunks = (codec_rate_for(song->sample_rate) == song->sample_rate) ? h->num_chunks : 0;
+        return;
+    }
+    song->codec_rate = codec_rate_for(song->sample_rate);
+    song->transport = (song->codec_rate == HIRATE_RATE) ? SAMPLE_FORMAT_PCM24 : sample_format;
+    song->src_chunk_frames = (song->transport == SAMPLE_FORMAT_PCM24) ? HIRATE_SLOT_FRAMES : chunk_frames;
+    if (song->transport == SAMPLE_FORMAT_PCM24 &&
+        !(song->format == SONG_FORMAT_WAV && song->bits_per_sample == 24)) {
+        // 16 bits pasa por el limitador: cada chunk deja lugar para vaciarlo
+        song->src_chunk_frames -= 2 * LIMITER_BLOCK_FRAMES;
+    }
     
-    printf("Cargadas %d/%d canciones\n\n", loaded, MAX_TRACKS);
-    return loaded > 0 ? 0 : -1;
+    if (song->codec_rate != song->sample_rate) {
+        resampler_t rs;
+        resampler_init(&rs, song->sample_rate, song->codec_rate);
+        song->src_chunk_frames = resampler_input_frames(&rs, chunk_frames);
+    }
+    song->num_chunks = (song->total_frames + song->src_chunk_frames - 1) / song->src_chunk_frames;
 }
 
-int load_chunk(int song_idx, int chunk_idx) {
-    if (song_idx >= MAX_TRACKS || !songs[song_idx].file_handle) {
-        return -1;
+// Guarda en el índice la tabla de búsqueda de una pista FLAC si aprendió
+// puntos nuevos: hasta LIBRARY_POINTS repartidos entre los que conoce
+static void song_save_points(song_info_t *song) {
+    library_record_t *rec = library_record(&library, song->library_record);
+    flac_decoder_t *dec = &song->flac;
+    
+    if (!rec || song->format != SONG_FORMAT_FLAC || !dec->file ||
+        dec->num_seekpoints <= song->indexed_points) {
+        return;
     }
     
-    FILE* file = songs[song_idx].file_handle;
-    long offset = chunk_idx * AUDIO_CHUNK_SIZE;
+    uint32_t n = (dec->num_seekpoints < LIBRARY_POINTS) ? dec->num_seekpoints : LIBRARY_POINTS;
+    rec->valid = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        const flac_seekpoint_t *point = &dec->seekpoints[(uint64_t)i * dec->num_seekpoints / n];
+        rec->points[i].sample = point->sample;
+        rec->points[i].offset = point->offset;
+    }
+    rec->num_points = n;
+    rec->valid = 1;
+    song->indexed_points = dec->num_seekpoints;
+}
+
+// Registro nuevo o vencido: se rehace con el formato recién leído
+static void song_index(song_info_t *song, const char *path, const struct stat *st) {
+    library_record_t *rec = library_update(&library, path, st);
     
-    if (chunk_idx >= songs[song_idx].num_chunks) {
-        printf("ERROR: Chunk %d excede total %d\n", chunk_idx, songs[song_idx].num_chunks);
-        return -1;
+    if (!rec) {
+        return;
+    }
+    rec->format = song->format;
+    rec->sample_rate = song->sample_rate;
+    rec->bits_per_sample = (song->format == SONG_FORMAT_FLAC) ? song->flac.bits_per_sample : song->bits_per_sample;
+    rec->channels = song->channels;
+    rec->data_offset = song->data_offset;
+    rec->total_frames = song->total_frames;
+    rec->duration_sec = song->duration_sec;
+    rec->valid = 1;
+    song->library_record = library_record_index(&library, rec);
+    song_save_points(song);
+}
+
+// Ganancia y recorte del análisis, si la pista ya lo tiene. Va después de
+// song_index: el índice guarda los frames del archivo, sin recortar.
+static void song_apply_record(song_info_t *song, const analysis_record_t *rec) {
+    if (rec->total_frames != song->total_frames || rec->loudness == ANALYSIS_SILENT) {
+        return;
+    }
+    if (replaygain_mode) {
+        song->gain = analysis_gain(rec);
+    }
+    if (trim_silence_mode && rec->end_frame > rec->first_frame) {
+        song->trim_start = rec->first_frame;
+        song->total_frames = rec->end_frame - rec->first_frame;
+        set_song_transport(song);
+        song->duration_sec = song->total_frames / song->sample_rate;
+    }
+    printf("    Loudness %.1f LUFS, pico %.1f dBFS: ganancia %+.1f dB, %llu frames de silencio recortados\n",
+           rec->loudness / 100.0, (rec->peak > 0) ? 20.0 * log10(rec->peak / 32768.0) : -96.0,
+           20.0 * log10((double)song->gain / LIMITER_UNITY_GAIN),
+           (unsigned long long)(rec->total_frames - song->total_frames));
+}
+
+static void song_apply_analysis(song_info_t *song, const char *path, const struct stat *st) {
+    analysis_record_t rec;
+    
+    if ((replaygain_mode || trim_silence_mode) && analysis_db_find(&analysis, path, st, &rec)) {
+        song_apply_record(song, &rec);
     }
+}
+
+// Abre una pista y lee su formato (hilo de lectura). Con un registro válido
+// en el índice no se lee la cabecera ni se busca el final del archivo.
+static int song_open_path(song_info_t *song, int track, const char *path) {
+    size_t len = strlen(path);
+    struct stat st;
+    library_record_t *rec = NULL;
     
-    if (fseek(file, offset, SEEK_SET) != 0) {
-        printf("ERROR: Seek falló para chunk %d\n", chunk_idx);
+    memset(song, 0, sizeof(*song));
+    song->track = track;
+    song->library_record = -1;
+    song->gain = LIMITER_UNITY_GAIN;
+    snprintf(song->filename, sizeof(song->filename), "%s", path);
+    
+    if (stat(path, &st) != 0) {
+        printf("⚠ No se pudo abrir: %s\n", path);
         return -1;
     }
     
-    size_t bytes_read = fread((void*)shared_audio, 1, AUDIO_CHUNK_SIZE, file);
+    // La cabecera del .ntrk hace de índice: no pasa por la biblioteca
+    if (native_track_name(path)) {
+        if (native_open(&song->native, path) != 0) {
+            printf("⚠ .ntrk inválido: %s\n", path);
+            return -1;
+        }
+        const native_header_t *h = &song->native.header;
+        song->format = SONG_FORMAT_NATIVE;
+        song->file_handle = song->native.file;
+        song->file_size = st.st_size;
+        song->sample_rate = h->sample_rate;
+        song->bits_per_sample = (h->format == NATIVE_FORMAT_PCM24) ? 24 : 16;
+        song->channels = 2;
+        song->total_frames = h->total_frames;
+        song->duration_sec = h->total_frames / h->sample_rate;
+        set_song_transport(song);
+        
+        printf("✓ Pista %d: %s (nativo)\n", track + 1, song->filename);
+        printf("    %s a %u Hz, %u chunks, ~%d segundos\n",
+               (h->format == NATIVE_FORMAT_PCM24) ? "PCM24" : "PCM16", h->sample_rate, h->num_chunks,
+               song->duration_sec);
+        if (h->loudness != ANALYSIS_SILENT) {
+            printf("    Loudness %.1f LUFS, ganancia aplicada %+.1f dB\n", h->loudness / 100.0,
+                   20.0 * log10((double)h->gain / LIMITER_UNITY_GAIN));
+        }
+        if (song->num_chunks == 0) {
+            printf("⚠ %u Hz sin alta tasa en el Nios: transcodificar a %d Hz\n", h->sample_rate, CODEC_DEFAULT_RATE);
+        }
+        return 0;
+    }
+    rec = library_find(&library, path, &st);
     
-    if (bytes_read > 0) {
-        shared_ctrl->chunk_size = bytes_read;
-        shared_ctrl->current_chunk = chunk_idx;
-        shared_ctrl->song_position = offset + bytes_read;
-        shared_ctrl->chunk_ready = 1;
-        shared_ctrl->request_next = 0;
-        shared_ctrl->chunks_loaded++;
+    if (len > 5 && strcasecmp(path + len - 5, ".flac") == 0) {
+        if (flac_open(&song->flac, path, FRAMES_PER_CHUNK) != 0) {
+            printf("⚠ No se pudo abrir: %s\n", path);
+            return -1;
+        }
+        song->format = SONG_FORMAT_FLAC;
+        song->file_handle = song->flac.file;
+        
+        // Los puntos aprendidos en reproducciones anteriores evitan decodificar
+        // desde el comienzo al buscar
+        if (rec) {
+            for (uint32_t i = 0; i < rec->num_points && i < LIBRARY_POINTS; i++) {
+                flac_add_seekpoint(&song->flac, rec->points[i].sample, rec->points[i].offset);
+            }
+            song->library_record = library_record_index(&library, rec);
+            song->indexed_points = song->flac.num_seekpoints;
+        }
         
-        // Calcular progreso
-        shared_ctrl->buffer_level = (chunk_idx * 100) / songs[song_idx].num_chunks;
+        // Tamaño y chunks en PCM decodificado (estéreo 16 bits)
+        uint64_t pcm_bytes = song->flac.total_samples * 4;
+        song->sample_rate = song->flac.sample_rate;
+        song->bits_per_sample = 16;
+        song->channels = song->flac.channels;
+        song->total_frames = song->flac.total_samples;
+        set_song_transport(song);
+        song->file_size = (uint32_t)pcm_bytes;
+        song->duration_sec = song->flac.total_samples / song->flac.sample_rate;
+        if (!rec) {
+            song_index(song, path, &st);
+        }
         
-        printf("Chunk %d/%d cargado (%zu bytes, %d%% completado)\n", 
-               chunk_idx + 1, songs[song_idx].num_chunks, 
-               bytes_read, shared_ctrl->buffer_level);
+        printf("✓ Pista %d: %s (FLAC%s)\n", track + 1, song->filename, rec ? ", índice" : "");
+        printf("    %u Hz, %u canales, %u bits, %d chunks de %d KB\n",
+               song->flac.sample_rate, song->flac.channels,
+               song->flac.bits_per_sample, song->num_chunks, AUDIO_CHUNK_SIZE/1024);
+        printf("    Duración: ~%d segundos, %u puntos de búsqueda\n",
+               song->duration_sec, song->flac.num_seekpoints);
+        song_apply_analysis(song, path, &st);
         return 0;
     }
     
-    printf("ERROR: Lectura falló\n");
-    return -1;
+    song->format = SONG_FORMAT_WAV;
+    song->file_handle = fopen(path, "rb");
+    if (!song->file_handle) {
+        printf("⚠ No se pudo abrir: %s\n", path);
+        return -1;
+    }
+    
+    if (rec) {
+        song->file_size = rec->size;
+        song->sample_rate = rec->sample_rate;
+        song->bits_per_sample = rec->bits_per_sample;
+        song->channels = rec->channels;
+        song->data_offset = rec->data_offset;
+        song->total_frames = rec->total_frames;
+        song->library_record = library_record_index(&library, rec);
+    } else {
+        wav_format_t fmt;
+        if (wav_parse(song->file_handle, st.st_size, &fmt) != 0) {
+            printf("⚠ WAV no soportado (%s): %s\n", fmt.error, path);
+            return -1;
+        }
+        song->file_size = st.st_size;
+        song->sample_rate = fmt.sample_rate;
+        song->bits_per_sample = fmt.bits_per_sample;
+        song->channels = fmt.channels;
+        song->data_offset = fmt.data_offset;
+        song->total_frames = fmt.total_frames;
+    }
+    
+    // Chunks y duración salen de los frames del chunk data (30 KB en PCM,
+    // ~119 KB de PCM en ADPCM)
+    set_song_transport(song);
+    song->duration_sec = song->total_frames / song->sample_rate;
+    if (!rec) {
+        song_index(song, path, &st);
+    }
+    
+    printf("✓ Pista %d: %s%s\n", track + 1, song->filename, rec ? " (índice)" : "");
+    printf("    %.1f MB, %d chunks de %d KB\n",
+           song->file_size/1024.0/1024.0, song->num_chunks, AUDIO_CHUNK_SIZE/1024);
+    printf("    Duración: ~%d segundos%s\n", song->duration_sec, song->channels == 1 ? ", mono" : "");
+    if (song->codec_rate != song->sample_rate) {
+        printf("    %u Hz: se convierte a %u Hz\n", song->sample_rate, song->codec_rate);
+    } else if (song->transport == SAMPLE_FORMAT_PCM24) {
+        printf("    %u Hz, %u bits: alta tasa (PCM24 en slots de %d frames)\n",
+               song->sample_rate, song->bits_per_sample, song->src_chunk_frames);
+    } else if (song->sample_rate != CODEC_DEFAULT_RATE) {
+        printf("    %u Hz nativo\n", song->sample_rate);
+    }
+    song_apply_analysis(song, path, &st);
+    return 0;
 }
 
-int main() {
-    printf("=== HPS Audio Loader - 128 KB Optimizado ===\n");
-    printf("Memoria: 0x%08x - 0x%08x (128 KB)\n", 
-           SHARED_MEMORY_OFFSET, SHARED_MEMORY_OFFSET + MEMORY_SIZE - 1);
-    printf("Chunks de audio: %d KB\n", AUDIO_CHUNK_SIZE/1024);
-    printf("Estructura: %zu bytes\n", sizeof(compact_shared_control_t));
-    printf("Usuario: %s\n", getenv("USER") ? getenv("USER") : "unknown");
-    printf("Compilado: %s %s\n\n", __DATE__, __TIME__);
+static int song_open(song_info_t *song, int track) {
+    return song_open_path(song, track, playlist.paths[track]);
+}
+
+static void song_close(song_info_t *song) {
+    song_save_points(song);
+    if (song->format == SONG_FORMAT_FLAC) {
+        flac_close(&song->flac);
+    } else if (song->format == SONG_FORMAT_NATIVE) {
+        native_close(&song->native);
+    } else if (song->file_handle) {
+        fclose(song->file_handle);
+    }
+    song->file_handle = NULL;
+}
+
+// Pista abierta desde el caché; si no está, reemplaza la menos usada.
+// NULL si no se puede abrir.
+static song_info_t *track_get(int track) {
+    song_info_t *victim = &track_cache[0];
     
-    if (getuid() != 0) {
-        printf("ERROR: Ejecutar como root (sudo)\n");
-        return 1;
+    for (int i = 0; i < TRACK_CACHE_SIZE; i++) {
+        song_info_t *slot = &track_cache[i];
+        if (slot->file_handle && slot->track == track) {
+            slot->last_use = ++track_cache_clock;
+            return slot;
+        }
+        if (victim->file_handle && (!slot->file_handle || slot->last_use < victim->last_use)) {
+            victim = slot;
+        }
     }
     
-    signal(SIGINT, cleanup_and_exit);
-    signal(SIGTERM, cleanup_and_exit);
+    if (victim->file_handle) {
+        song_close(victim);
+    }
+    if (song_open(victim, track) != 0) {
+        song_close(victim);
+        return NULL;
+    }
+    victim->last_use = ++track_cache_clock;
+    return victim;
+}
+
+// --- Pistas del directorio ---
+static int playlist_from_dir = 0;       // La playlist es SONGS_DIR: las pistas nuevas se agregan
+
+static int is_song_name(const char *name) {
+    size_t len = strlen(name);
+    return name[0] != '.' && ((len > 4 && strcasecmp(name + len - 4, ".wav") == 0) ||
+                              (len > 5 && strcasecmp(name + len - 5, ".flac") == 0) ||
+                              native_track_name(name));
+}
+
+static int song_dirent_filter(const struct dirent *entry) {
+    return is_song_name(entry->d_name);
+}
+
+// Agrega las pistas de SONGS_DIR por nombre. X.ntrk tapa a X.flac y X.wav
+// (ya está convertida) y FLAC a WAV: ocupa ~la mitad en la SD. Con 'live'
+// (playlist ya finalizada) solo agrega las que falten. Devuelve las
+// agregadas o -1.
+static int scan_songs_dir(int live) {
+    struct dirent **names;
+    char path[512], flac[512], native[512];
+    int added = 0;
+    int count = scandir(SONGS_DIR, &names, song_dirent_filter, alphasort);
     
-    // Mapear memoria
-    if (map_shared_memory() != 0) {
-        printf("FATAL: Falló mapeo de memoria\n");
-        return 1;
+    if (count < 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        const char *name = names[i]->d_name;
+        size_t len = strlen(name);
+        snprintf(path, sizeof(path), SONGS_DIR "/%s", name);
+        size_t base = strrchr(name, '.') - name;
+        snprintf(flac, sizeof(flac), SONGS_DIR "/%.*s.flac", (int)base, name);
+        snprintf(native, sizeof(native), SONGS_DIR "/%.*s" NATIVE_EXTENSION, (int)base, name);
+        
+        int covered = (!native_track_name(name) && access(native, R_OK) == 0) ||
+                      (strcasecmp(name + len - 4, ".wav") == 0 && access(flac, R_OK) == 0);
+        if (!covered && !(live && playlist_find(&playlist, path) >= 0)) {
+            if ((live ? playlist_append(&playlist, path) : playlist_add(&playlist, path)) < 0) {
+                printf("⚠ Playlist llena, no se agrega: %s\n", path);
+            } else {
+                added++;
+            }
+        }
+        free(names[i]);
     }
+    free(names);
+    return added;
+}
+
+// Solo rutas: los archivos se abren al reproducirlos
+int load_playlist(const char *m3u_path, int shuffle, int repeat) {
+    printf("=== Cargando Playlist ===\n");
     
-    // Cargar canciones
-    if (load_songs() != 0) {
-        printf("ADVERTENCIA: Sin canciones, modo test\n");
+    int records = library_open(&library, library_path);
+    if (records < 0) {
+        printf("⚠ Sin índice de biblioteca (%s): se leerá la cabecera de cada pista\n", library_path);
+    } else {
+        printf("✓ Índice %s: %d registros\n", library_path, records);
     }
     
-    // Inicializar sistema
-    printf("=== Inicializando Sistema ===\n");
+    if (!m3u_path && access(SONGS_DIR "/playlist.m3u", R_OK) == 0) {
+        m3u_path = SONGS_DIR "/playlist.m3u";
+    }
     
-    shared_ctrl->magic = 0xABCD2025;
-    shared_ctrl->command = CMD_NONE;
-    shared_ctrl->status = STATUS_READY;
-    shared_ctrl->song_id = 0;
-    shared_ctrl->hps_connected = 1;
-    shared_ctrl->sample_rate = 48000;
-    shared_ctrl->channels = 2;
-    shared_ctrl->error_flags = 0;
-    shared_ctrl->chunks_loaded = 0;
-    shared_ctrl->bytes_played = 0;
+    if (m3u_path) {
+        int added = playlist_load_m3u(&playlist, m3u_path);
+        if (added < 0) {
+            printf("ERROR: No se pudo abrir %s\n", m3u_path);
+        } else {
+            printf("✓ %s: %d pistas\n", m3u_path, added);
+        }
+    } else {
+        int added = scan_songs_dir(0);
+        if (added < 0) {
+            printf("ERROR: No se pudo leer " SONGS_DIR "\n");
+        } else {
+            printf("✓ " SONGS_DIR ": %d pistas\n", added);
+        }
+        playlist_from_dir = 1;
+    }
     
-    if (songs[0].file_handle) {
-        shared_ctrl->total_chunks = songs[0].num_chunks;
-        shared_ctrl->song_total_size = songs[0].file_size;
-        shared_ctrl->duration_sec = songs[0].duration_sec;
-        
-        if (load_chunk(0, 0) == 0) {
-            printf("✓ Primer chunk cargado\n");
+    if (playlist_finalize(&playlist, shuffle, repeat) != 0) {
+        printf("ERROR: Sin memoria para la playlist\n");
+        return -1;
+    }
+    
+    // Solo consulta el mapeo: la validación por mtime/tamaño es al abrir cada pista
+    uint32_t indexed = 0;
+    uint64_t indexed_sec = 0;
+    for (uint32_t i = 0; i < playlist.count; i++) {
+        library_record_t *rec = library_lookup(&library, playlist.paths[i]);
+        if (rec && rec->valid) {
+            indexed++;
+            indexed_sec += rec->duration_sec;
         }
     }
+    if (indexed > 0) {
+        printf("  %u pistas indexadas, %llu:%02llu:%02llu en total\n", indexed,
+               (unsigned long long)(indexed_sec / 3600), (unsigned long long)(indexed_sec / 60 % 60),
+               (unsigned long long)(indexed_sec % 60));
+    }
+    printf("Playlist: %u pistas%s, repetir %s\n\n", playlist.count, shuffle ? " en orden aleatorio" : "",
+           repeat == PLAYLIST_REPEAT_ONE ? "una" : repeat == PLAYLIST_REPEAT_NONE ? "no" : "todas");
+    return playlist.count > 0 ? 0 : -1;
+}
+
+// --- Pipeline de carga: lectura → transformación → escritura al bridge ---
+// Cada etapa es un hilo y los chunks pasan entre ellas por colas SPSC
+// acotadas; escritura devuelve los buffers a lectura por queue_free. El hilo
+// principal queda como control: comandos, fallback y estado.
+//
+// Un cambio de posición (NEXT/PREV/STOP, fallback) incrementa
+// stream_generation: lectura sigue desde seek_position/seek_frame y las
+// etapas siguientes descartan lo que quede de generaciones anteriores.
+
+#define PIPELINE_CHUNKS     6       // Buffers en circulación (<= SPSC_QUEUE_CAPACITY)
+#define PIPELINE_IDLE_US    1000    // Espera de una etapa sin trabajo
+#define PIPELINE_STACK_SIZE (256 * 1024)  // Con mlockall el stack se bloquea entero
+
+#define STAGE_READER        0
+#define STAGE_TRANSFORM     1
+#define STAGE_WRITER        2
+#define PIPELINE_STAGES     3
+
+typedef struct {
+    uint32_t generation;
+    int position;           // Posición en la playlist
+    int track;
+    int chunk;
+    int stream_start;       // Primer chunk tras un cambio de posición: se entrega ya
+    int song_start;         // Chunk 0 de la canción siguiente: espera a que el Nios vacíe el bridge
+    int failed;
+    uint32_t transport;     // Copia de la pista al leerla: el caché es de lectura
+    uint32_t sample_rate;
+    uint32_t codec_rate;
+    uint32_t num_chunks;
+    uint32_t file_size;
+    uint32_t duration_sec;
+    int s24;                // Muestras de 24 bits en payload (si no, 16 bits en pcm)
+    int native;             // payload ya tiene las palabras del codec (.ntrk)
+    int flush;              // Fin de canción o de stream: vaciar el limitador con este chunk
+    uint32_t src_frames;    // Frames leídos del archivo
+    uint32_t frames;        // Frames que recibe el Nios
+    uint32_t payload_bytes;
+    uint32_t limiter_gain;
+    int16_t pcm[MAX_CHUNK_FRAMES * 2];
+    int32_t payload[HIRATE_SLOT_SIZE / 4];   // Lo que se copia al bridge
+} pipeline_chunk_t;
+
+_Static_assert((ADPCM_FRAMES_PER_CHUNK + 2 * LIMITER_BLOCK_FRAMES + ADPCM_BLOCK_FRAMES - 1) / ADPCM_BLOCK_FRAMES *
+               ADPCM_BLOCK_SIZE <= sizeof(((pipeline_chunk_t *)0)->payload),
+               "un chunk ADPCM más el vaciado del limitador entra en payload");
+
+typedef struct {
+    const char *name;
+    int cpu;                        // -1 = sin fijar
+    int priority;                   // SCHED_FIFO con --realtime
+    _Atomic uint32_t chunks;
+    _Atomic uint64_t bytes;         // Lectura: PCM del archivo; resto: bytes para el bridge
+    _Atomic uint64_t busy_ns;
+} pipeline_stage_t;
+
+static pipeline_chunk_t pipeline_chunks[PIPELINE_CHUNKS];
+static spsc_queue_t queue_free, queue_read, queue_ready;
+static pipeline_stage_t stages[PIPELINE_STAGES] = {
+    { .name = "lectura",        .cpu = -1, .priority = 60 },
+    { .name = "transformación", .cpu = -1, .priority = 70 },
+    { .name = "escritura",      .cpu = -1, .priority = 80 },   // El plazo del bridge manda
+};
+static int control_cpu = -1;
+static int control_priority = 50;
+static int pin_requested = 0;
+
+static _Atomic uint32_t stream_generation;
+static _Atomic int seek_position;
+static _Atomic uint32_t seek_frame;     // Frame del archivo (lectura lo pasa a chunk)
+static _Atomic int fade_position = -1;  // Crossfade desde esta posición al cambiar, -1 = corte
+static _Atomic uint32_t fade_frame;     // Frame del codec donde iba la saliente
+static _Atomic uint32_t pipeline_volume = VOLUME_DEFAULT;
+static _Atomic int playing_position = -1;   // Escritura: posición del último stream entregado
+static _Atomic int stream_track = -1;       // Escritura: pista del último stream entregado
+static _Atomic uint64_t stream_base_frames; // frames_played del Nios al entregarlo
+
+// Latencias de recarga (us), exportadas por control a stats_path
+static latency_hist_t hist_refill, hist_read, hist_copy, hist_skip;
+static _Atomic uint64_t stream_request_ns;  // Último cambio de posición pendiente de entregar; 0 = ninguno
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t elapsed_us(uint64_t start_ns) {
+    return (uint32_t)((monotonic_ns() - start_ns) / 1000);
+}
+
+static void stage_account(pipeline_stage_t *stage, uint64_t start_ns, uint32_t bytes) {
+    atomic_fetch_add_explicit(&stage->chunks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stage->bytes, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stage->busy_ns, monotonic_ns() - start_ns, memory_order_relaxed);
+}
+
+static void pin_thread(pthread_t thread, int cpu, const char *name) {
+    cpu_set_t set;
+    int err;
+    
+    if (cpu < 0) {
+        return;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err != 0) {
+        printf("⚠ No se pudo fijar %s al CPU %d: %s\n", name, cpu, strerror(err));
+    } else {
+        printf("✓ Hilo de %s en el CPU %d\n", name, cpu);
+    }
+}
+
+// --- Tiempo real (--realtime) ---
+// SCHED_FIFO por etapa, memoria bloqueada y staging pre-tocado: una recarga
+// no espera a un page fault ni a un proceso SCHED_OTHER.
+
+#define REALTIME_WRITER_CPU     1       // Escritura y control en un core, lectura y DSP en el otro
+#define REALTIME_STACK_PREFAULT (64 * 1024)
+#define JITTER_SAMPLES          2000    // 2 s de despertares cada PIPELINE_IDLE_US
+// Plazo de una recarga PCM16: lo que tarda en vaciarse el FIFO del codec (128 frames)
+#define REFILL_DEADLINE_US      (128 * 1000000 / CODEC_DEFAULT_RATE)
+
+int realtime_mode = 0;
+static uint32_t jitter_samples[JITTER_SAMPLES];
+static int jitter_policy;
+
+static void set_thread_realtime(pthread_t thread, int priority, const char *name) {
+    struct sched_param param = { .sched_priority = priority };
+    int err = pthread_setschedparam(thread, SCHED_FIFO, &param);
     
-    printf("\n=== Estado Inicial ===\n");
-    printf("Magic: 0x%08x\n", shared_ctrl->magic);
-    printf("HPS Conectado: %d\n", shared_ctrl->hps_connected);
-    printf("Canción: %d, Chunks: %d\n", shared_ctrl->song_id, shared_ctrl->total_chunks);
-    printf("Chunk listo: %d (%d bytes)\n", shared_ctrl->chunk_ready, shared_ctrl->chunk_size);
+    if (err != 0) {
+        printf("⚠ No se pudo poner %s en SCHED_FIFO %d: %s\n", name, priority, strerror(err));
+    } else {
+        printf("✓ Hilo de %s en SCHED_FIFO %d\n", name, priority);
+    }
+}
+
+static void prefault_stack(void) {
+    volatile uint8_t stack[REALTIME_STACK_PREFAULT];
     
-    printf("\n=== Loop Principal ===\n");
-    printf("Esperando FPGA...\n");
-    printf("Controles: KEY0=Play/Pause, KEY1=Siguiente, KEY2=Anterior\n\n");
+    for (uint32_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+// Bloquear la memoria y escribir en cada página del staging: el BSS arranca
+// mapeado a la página cero y el primer write sería un fault
+static void realtime_setup(void) {
+    size_t bytes = sizeof(pipeline_chunks) + sizeof(staging_in) + sizeof(staging_out) +
+                   sizeof(staging_resampled) + sizeof(staging_s24) + sizeof(jitter_samples);
     
-    uint32_t loop_counter = 0;
-    uint32_t last_heartbeat = 0;
+    printf("=== Modo Tiempo Real ===\n");
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        printf("⚠ mlockall falló: %s\n", strerror(errno));
+    } else {
+        printf("✓ Memoria bloqueada (mlockall)\n");
+    }
     
-    while (1) {
-        shared_ctrl->hps_connected = 1;
-        
-        // Heartbeat
-        if (shared_ctrl->fpga_heartbeat != last_heartbeat) {
-            printf("[%06d] FPGA activo: %u\n", loop_counter, shared_ctrl->fpga_heartbeat);
-            last_heartbeat = shared_ctrl->fpga_heartbeat;
+    memset(pipeline_chunks, 0, sizeof(pipeline_chunks));
+    memset(staging_in, 0, sizeof(staging_in));
+    memset(staging_out, 0, sizeof(staging_out));
+    memset(staging_resampled, 0, sizeof(staging_resampled));
+    memset(staging_s24, 0, sizeof(staging_s24));
+    memset(jitter_samples, 0, sizeof(jitter_samples));
+    prefault_stack();
+    printf("✓ Staging pre-tocado: %zu KB\n", bytes / 1024);
+    
+    // Sin --pin: escritura y control aislados de la lectura y el DSP
+    if (!pin_requested && sysconf(_SC_NPROCESSORS_ONLN) > REALTIME_WRITER_CPU) {
+        stages[STAGE_READER].cpu = 0;
+        stages[STAGE_TRANSFORM].cpu = 0;
+        stages[STAGE_WRITER].cpu = REALTIME_WRITER_CPU;
+        control_cpu = REALTIME_WRITER_CPU;
+    }
+}
+
+// Mismo ciclo que la espera de escritura, con su CPU y prioridad y con
+// despertares absolutos: el error es cuánto tarde despierta respecto al
+// instante pedido
+static void *jitter_thread(void *arg) {
+    struct timespec next, now;
+    struct sched_param param;
+    (void)arg;
+    
+    pin_thread(pthread_self(), stages[STAGE_WRITER].cpu, "prueba");
+    set_thread_realtime(pthread_self(), stages[STAGE_WRITER].priority, "prueba");
+    pthread_getschedparam(pthread_self(), &jitter_policy, &param);
+    
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; i < JITTER_SAMPLES; i++) {
+        next.tv_nsec += PIPELINE_IDLE_US * 1000;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
         }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
         
-        // Chunk requests
-        if (shared_ctrl->request_next && !shared_ctrl->chunk_ready && songs[current_song].file_handle) {
-            printf("[%06d] Cargando siguiente chunk...\n", loop_counter);
-            current_chunk++;
-            
-            if (current_chunk >= songs[current_song].num_chunks) {
-                printf("Fin de canción, siguiente...\n");
-                current_chunk = 0;
-                current_song = (current_song + 1) % MAX_TRACKS;
-                
-                while (!songs[current_song].file_handle && current_song < MAX_TRACKS) {
-                    current_song++;
-                }
-                if (current_song >= MAX_TRACKS) current_song = 0;
-                
-                shared_ctrl->song_id = current_song;
-                shared_ctrl->total_chunks = songs[current_song].num_chunks;
-                shared_ctrl->song_total_size = songs[current_song].file_size;
-                shared_ctrl->duration_sec = songs[current_song].duration_sec;
-                printf("Canción %d\n", current_song + 1);
+        int64_t late = (int64_t)(now.tv_sec - next.tv_sec) * 1000000000 + (now.tv_nsec - next.tv_nsec);
+        jitter_samples[i] = (late > 0) ? (uint32_t)(late / 1000) : 0;
+    }
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Autoprueba de arranque con la prioridad y el CPU del hilo de escritura
+int jitter_self_test(void) {
+    pthread_t thread;
+    
+    printf("=== Jitter de Planificación ===\n");
+    if (pthread_create(&thread, NULL, jitter_thread, NULL) != 0) {
+        printf("ERROR: No se pudo crear el hilo de prueba\n");
+        return -1;
+    }
+    pthread_join(thread, NULL);
+    
+    qsort(jitter_samples, JITTER_SAMPLES, sizeof(jitter_samples[0]), compare_u32);
+    uint32_t p50 = jitter_samples[JITTER_SAMPLES / 2];
+    uint32_t p99 = jitter_samples[JITTER_SAMPLES * 99 / 100];
+    uint32_t max = jitter_samples[JITTER_SAMPLES - 1];
+    
+    printf("%d despertares cada %d us (%s): error p50 = %u us, p99 = %u us, max = %u us\n",
+           JITTER_SAMPLES, PIPELINE_IDLE_US, jitter_policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_OTHER",
+           p50, p99, max);
+    
+    // Peor recarga: un período de sondeo más el peor despertar
+    if (PIPELINE_IDLE_US + max < REFILL_DEADLINE_US) {
+        printf("✓ Recarga en el peor caso: %u us < plazo de %d us (FIFO del codec a %d Hz)\n",
+               PIPELINE_IDLE_US + max, REFILL_DEADLINE_US, CODEC_DEFAULT_RATE);
+    } else {
+        printf("⚠ Recarga en el peor caso: %u us >= plazo de %d us (FIFO del codec a %d Hz)\n",
+               PIPELINE_IDLE_US + max, REFILL_DEADLINE_US, CODEC_DEFAULT_RATE);
+    }
+    printf("\n");
+    return 0;
+}
+
+// Control: reposicionar el stream. La posición se publica antes que la
+// generación; si llegan dos pedidos seguidos, lectura puede mezclar la
+// generación vieja con la posición nueva, pero esos chunks se descartan.
+static void publish_stream(int position, uint32_t frame, int from_position, uint32_t from_frame) {
+    atomic_store_explicit(&stream_request_ns, monotonic_ns(), memory_order_relaxed);
+    atomic_store_explicit(&seek_position, position, memory_order_relaxed);
+    atomic_store_explicit(&seek_frame, frame, memory_order_relaxed);
+    atomic_store_explicit(&fade_position, from_position, memory_order_relaxed);
+    atomic_store_explicit(&fade_frame, from_frame, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stream_generation, 1, memory_order_release);
+}
+
+static void request_stream(int position, uint32_t frame) {
+    publish_stream(position, frame, -1, 0);
+}
+
+// NEXT/PREV con crossfade: la pista de 'from_position' sigue sonando desde
+// 'from_frame' (frames del codec) mezclada con el principio de la nueva
+static void request_stream_crossfade(int position, int from_position, uint32_t from_frame) {
+    publish_stream(position, 0, from_position, from_frame);
+}
+
+// NEXT/PREV desde 'from': con crossfade solo si 'from' es la que suena
+// (song_position cuenta sus frames) y no un pedido que todavía no llegó
+static void request_skip(int position, int from, int playing) {
+    if (crossfade_ms > 0 && from == playing && shared_ctrl->status == STATUS_PLAYING) {
+        request_stream_crossfade(position, from, shared_ctrl->song_position / 4);
+    } else {
+        request_stream(position, 0);
+    }
+}
+
+static int chunk_is_stale(const pipeline_chunk_t *item) {
+    return item->generation != atomic_load_explicit(&stream_generation, memory_order_acquire);
+}
+
+// Con alta tasa, los WAV de 24 bits se leen directo a palabras del codec
+static int song_reads_s24(const song_info_t *song) {
+    return song->transport == SAMPLE_FORMAT_PCM24 && song->format == SONG_FORMAT_WAV &&
+           song->bits_per_sample == 24;
+}
+
+// --- Caché de cabezas de pista: el chunk 0 ya leído, en DRAM ---
+// NEXT/PREV, STOP y el fin de canción arrancan por el chunk 0: si está aquí,
+// lectura lo copia sin abrir ni leer el archivo y la pista se abre mientras
+// suena (con el chunk 1). Se llena al leer cualquier chunk 0 y, con el
+// pipeline lleno, por adelantado para la pista anterior y la siguiente.
+// Solo lo toca el hilo de lectura.
+#define HEAD_CACHE_SIZE     4
+
+typedef struct {
+    int track;                  // -1 = libre
+    uint32_t last_use;
+    song_info_t info;           // Formato al leerla, sin archivo abierto
+    uint32_t chunk_frames;      // src_chunk_frames con el que se leyó
+    pipeline_chunk_t chunk;     // src_frames, s24 y las muestras
+} head_entry_t;
+
+static head_entry_t head_cache[HEAD_CACHE_SIZE];
+static uint32_t head_cache_clock = 0;
+static int head_failed_track = -1;      // No reintentar en cada vuelta una pista que no abre
+static _Atomic uint32_t head_hits, head_misses;
+
+static void head_cache_init(void) {
+    for (int i = 0; i < HEAD_CACHE_SIZE; i++) {
+        head_cache[i].track = -1;
+    }
+}
+
+static head_entry_t *head_find(int track) {
+    for (int i = 0; i < HEAD_CACHE_SIZE; i++) {
+        if (head_cache[i].track == track) {
+            return &head_cache[i];
+        }
+    }
+    return NULL;
+}
+
+// Cabeza utilizable con el transporte actual (el fallback puede haberlo
+// cambiado desde que se leyó)
+static head_entry_t *head_lookup(int track) {
+    head_entry_t *head = head_find(track);
+    
+    if (!head) {
+        return NULL;
+    }
+    set_song_transport(&head->info);
+    if (head->info.src_chunk_frames != head->chunk_frames || song_reads_s24(&head->info) != head->chunk.s24) {
+        return NULL;
+    }
+    head->last_use = ++head_cache_clock;
+    return head;
+}
+
+// La entrada de la pista o, si no tiene, la menos usada
+static head_entry_t *head_slot(const song_info_t *info) {
+    head_entry_t *head = head_find(info->track);
+    
+    if (!head) {
+        head = &head_cache[0];
+        for (int i = 1; i < HEAD_CACHE_SIZE; i++) {
+            if (head_cache[i].last_use < head->last_use) {
+                head = &head_cache[i];
+            }
+        }
+    }
+    head->track = info->track;
+    head->last_use = ++head_cache_clock;
+    head->info = *info;
+    head->info.file_handle = NULL;
+    memset(&head->info.flac, 0, sizeof(head->info.flac));
+    head->chunk_frames = info->src_chunk_frames;
+    return head;
+}
+
+static void head_store(const song_info_t *info, const pipeline_chunk_t *item) {
+    head_entry_t *head = head_slot(info);
+    
+    head->chunk.s24 = item->s24;
+    head->chunk.src_frames = item->src_frames;
+    if (item->s24) {
+        memcpy(head->chunk.payload, item->payload, item->src_frames * 2 * sizeof(int32_t));
+    } else {
+        memcpy(head->chunk.pcm, item->pcm, item->src_frames * 2 * sizeof(int16_t));
+    }
+}
+
+static void head_copy(const head_entry_t *head, pipeline_chunk_t *item) {
+    item->src_frames = head->chunk.src_frames;
+    if (item->s24) {
+        memcpy(item->payload, head->chunk.payload, item->src_frames * 2 * sizeof(int32_t));
+    } else {
+        memcpy(item->pcm, head->chunk.pcm, item->src_frames * 2 * sizeof(int16_t));
+    }
+}
+
+static uint32_t read_source_frames(song_info_t *song, pipeline_chunk_t *item, uint32_t frames);
+static song_info_t *track_get(int track);
+
+// Lee por adelantado la cabeza de la pista anterior o la siguiente a
+// 'position' si falta. Devuelve 1 si leyó algo.
+static int head_prefetch(int position) {
+    int candidates[2] = {
+        (int)playlist_track(&playlist, playlist_next(&playlist, position)),
+        (int)playlist_track(&playlist, playlist_prev(&playlist, position)),
+    };
+    
+    for (int i = 0; i < 2; i++) {
+        int track = candidates[i];
+        // .ntrk: leer su chunk 0 cuesta lo mismo que copiarlo de la cabeza
+        if (track == head_failed_track || native_track_name(playlist.paths[track]) || head_lookup(track)) {
+            continue;
+        }
+        
+        song_info_t *info = track_get(track);
+        if (!info) {
+            head_failed_track = track;
+            continue;
+        }
+        set_song_transport(info);
+        
+        head_entry_t *head = head_slot(info);
+        head->chunk.chunk = 0;
+        head->chunk.s24 = song_reads_s24(info);
+        head->chunk.src_frames = read_source_frames(info, &head->chunk, info->src_chunk_frames);
+        if (head->chunk.src_frames == 0) {
+            head->track = -1;
+            head_failed_track = track;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// --- Análisis de la biblioteca en segundo plano ---
+// Hilos SCHED_IDLE y con E/S de clase idle: solo usan el CPU y la SD que la
+// reproducción deja libres. Toman pistas de la playlist (sin locks, como
+// lectura) con un cursor compartido y analizan las que no tienen un registro
+// vigente; cuando una pista cambia el cursor vuelve a 0. La base se guarda
+// cada ANALYSIS_SAVE_EVERY pistas y al quedarse sin trabajo.
+#define ANALYSIS_MAX_WORKERS    2
+#define ANALYSIS_IDLE_MS        2000
+#define ANALYSIS_SAVE_EVERY     16
+#define IOPRIO_CLASS_IDLE       3       // linux/ioprio.h
+#define IOPRIO_CLASS_SHIFT      13
+#define IOPRIO_WHO_PROCESS      1
+
+static _Atomic uint32_t analysis_cursor;
+static _Atomic uint32_t analysis_done, analysis_failed;
+static pthread_mutex_t analysis_save_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void analysis_save(void) {
+    // Un guardado a la vez: comparten el archivo temporal
+    if (pthread_mutex_trylock(&analysis_save_lock) == 0) {
+        if (analysis_db_save(&analysis) != 0) {
+            printf("⚠ No se pudo guardar el análisis en %s\n", analysis_path);
+        }
+        pthread_mutex_unlock(&analysis_save_lock);
+    }
+}
+
+static void *analysis_thread(void *arg) {
+    struct sched_param param = { .sched_priority = 0 };
+    (void)arg;
+    
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+    
+    while (1) {
+        uint32_t count = atomic_load_explicit(&playlist.count, memory_order_acquire);
+        uint32_t track = atomic_fetch_add(&analysis_cursor, 1);
+        
+        if (track >= count) {
+            analysis_save();
+            usleep(ANALYSIS_IDLE_MS * 1000);
+            continue;
+        }
+        
+        const char *path = playlist.paths[track];
+        struct stat st;
+        analysis_record_t rec;
+        // Un .ntrk trae su loudness en la cabecera
+        if (playlist_removed(&playlist, track) || native_track_name(path) || stat(path, &st) != 0 ||
+            analysis_db_find(&analysis, path, &st, NULL)) {
+            continue;
+        }
+        if (analysis_run(path, &st, &rec) != 0 || analysis_db_store(&analysis, &rec) != 0) {
+            atomic_fetch_add(&analysis_failed, 1);
+            continue;
+        }
+        if ((atomic_fetch_add(&analysis_done, 1) + 1) % ANALYSIS_SAVE_EVERY == 0) {
+            analysis_save();
+        }
+    }
+    return NULL;
+}
+
+static void analysis_start(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = (cpus < 1) ? 1 : (cpus > ANALYSIS_MAX_WORKERS) ? ANALYSIS_MAX_WORKERS : (int)cpus;
+    int loaded = analysis_db_open(&analysis, analysis_path);
+    pthread_attr_t attr;
+    int started = 0;
+    
+    if (loaded < 0) {
+        printf("⚠ No se pudo cargar el análisis de %s\n", analysis_path);
+        return;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PIPELINE_STACK_SIZE);
+    for (int i = 0; i < workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, analysis_thread, NULL) == 0) {
+            pthread_detach(thread);
+            started++;
+        }
+    }
+    pthread_attr_destroy(&attr);
+    analysis_started = (started > 0);
+    printf("✓ Análisis de la biblioteca: %d pistas en %s, %d hilos de baja prioridad%s%s\n",
+           loaded, analysis_path, started, replaygain_mode ? ", ReplayGain" : "",
+           trim_silence_mode ? ", recorte de silencio" : "");
+}
+
+// --- Cambios en SONGS_DIR: control los detecta, lectura los aplica ---
+// Control solo toca la playlist (agregar al final, marcar quitadas) y avisa
+// por queue_changed qué pistas cambiaron; los cachés de archivos y cabezas
+// son de lectura, que cierra lo viejo y reindexa sin cortar la reproducción.
+static spsc_queue_t queue_changed;          // Pista + 1
+static _Atomic int changed_overflow = 0;    // Cola llena o eventos perdidos: invalidar todo
+
+static void notify_track_changed(int track) {
+    if (!spsc_push(&queue_changed, (void *)(uintptr_t)(track + 1))) {
+        atomic_store(&changed_overflow, 1);
+    }
+    atomic_store(&analysis_cursor, 0);
+}
+
+static void track_invalidate(int track) {
+    for (int i = 0; i < TRACK_CACHE_SIZE; i++) {
+        if (track_cache[i].file_handle && (track < 0 || track_cache[i].track == track)) {
+            song_close(&track_cache[i]);
+        }
+    }
+    for (int i = 0; i < HEAD_CACHE_SIZE; i++) {
+        if (track < 0 || head_cache[i].track == track) {
+            head_cache[i].track = -1;
+        }
+    }
+    if (track < 0 || head_failed_track == track) {
+        head_failed_track = -1;
+    }
+}
+
+static void reader_apply_changes(void) {
+    static song_info_t fresh;
+    void *item;
+    
+    while ((item = spsc_pop(&queue_changed)) != NULL) {
+        int track = (int)(uintptr_t)item - 1;
+        track_invalidate(track);
+        // El registro viejo no coincide en mtime/tamaño: abrirla lo rehace
+        if (!playlist_removed(&playlist, track) && song_open(&fresh, track) == 0) {
+            song_close(&fresh);
+        }
+    }
+    if (atomic_exchange(&changed_overflow, 0)) {
+        track_invalidate(-1);
+    }
+}
+
+// --- Etapa de lectura: archivo → pcm (16 bits) o payload (24 bits) ---
+// En 'pcm' (16 bits) o en 's24' (el otro es NULL; s24 solo con WAV de 24 bits).
+// Los frames cuentan desde el recorte de --trim-silence y salen con la
+// ganancia de --replaygain aplicada.
+static uint32_t read_song_frames(song_info_t *song, uint64_t first_frame, uint32_t frames,
+                                 int16_t *pcm, int32_t *s24) {
+    uint32_t read;
+    
+    if (song->format == SONG_FORMAT_FLAC) {
+        // Solo se busca si no es el chunk siguiente
+        flac_decoder_t *dec = &song->flac;
+        uint64_t sample = song->trim_start + first_frame;
+        if (song->total_frames > 0) {
+            if (first_frame >= song->total_frames) {
+                return 0;
+            }
+            if (frames > song->total_frames - first_frame) {
+                frames = (uint32_t)(song->total_frames - first_frame);
+            }
+        }
+        if (dec->position != sample && flac_seek(dec, sample) != 0) {
+            printf("ERROR: Seek FLAC falló en el frame %llu\n", (unsigned long long)sample);
+            return 0;
+        }
+        int decoded = flac_read_frames(dec, pcm, frames);
+        read = (decoded > 0) ? (uint32_t)decoded : 0;
+    } else {
+        read = wav_read_frames(song, first_frame, frames, s24 ? NULL : pcm, s24);
+    }
+    
+    if (song->gain != LIMITER_UNITY_GAIN && read > 0) {
+        if (s24) {
+            dsp_gain_s24(s24, read * 2, song->gain);
+        } else {
+            dsp_gain_ramp_stereo_s16(pcm, pcm, read, song->gain, song->gain);
+        }
+    }
+    return read;
+}
+
+static uint32_t read_source_frames(song_info_t *song, pipeline_chunk_t *item, uint32_t frames) {
+    return read_song_frames(song, (uint64_t)item->chunk * frames, frames,
+                            item->pcm, item->s24 ? item->payload : NULL);
+}
+
+// --- Crossfade (--crossfade) ---
+// La saliente se sigue leyendo y se mezcla, ya en DRAM, en los primeros
+// chunks de la entrante: para el Nios la entrante empieza en su chunk 0 como
+// siempre. Al final de una canción la saliente se corta 'length' frames
+// antes; con NEXT/PREV sigue desde donde sonaba.
+typedef struct {
+    int track;              // Saliente, -1 = sin crossfade en curso
+    uint64_t frame;         // Próximo frame a leer de la saliente
+    uint32_t done;          // Frames del fade ya mezclados
+    uint32_t length;
+} crossfade_t;
+
+static int16_t crossfade_pcm[MAX_CHUNK_FRAMES * 2];    // Saliente (hilo de lectura)
+
+// Frames de fade de 'from' (desde from_frame) a 'to'; 0 si no se pueden
+// mezclar: otra tasa (resampler y transporte son por pista), WAV de 24
+// bits que va directo a palabras del codec o .ntrk
+static uint32_t crossfade_frames(const song_info_t *from, const song_info_t *to, uint64_t from_frame) {
+    if (crossfade_ms == 0 || from->track == to->track || from->sample_rate != to->sample_rate ||
+        song_reads_s24(from) || song_reads_s24(to) ||
+        from->format == SONG_FORMAT_NATIVE || to->format == SONG_FORMAT_NATIVE) {
+        return 0;
+    }
+    uint64_t frames = (uint64_t)crossfade_ms * from->sample_rate / 1000;
+    uint64_t left = (from->total_frames > from_frame) ? from->total_frames - from_frame : 0;
+    if (frames > left) {
+        frames = left;
+    }
+    if (frames > to->total_frames / 2) {
+        frames = to->total_frames / 2;
+    }
+    return (uint32_t)frames;
+}
+
+static void crossfade_mix(crossfade_t *fade, pipeline_chunk_t *item) {
+    uint32_t frames = fade->length - fade->done;
+    if (frames > item->src_frames) {
+        frames = item->src_frames;
+    }
+    
+    // Saliente que falla o se acaba antes: el resto del fade es silencio
+    song_info_t *from = track_get(fade->track);
+    uint32_t read = from ? read_song_frames(from, fade->frame, frames, crossfade_pcm, NULL) : 0;
+    memset(crossfade_pcm + read * 2, 0, (frames - read) * 2 * sizeof(int16_t));
+    dsp_crossfade_stereo_s16(crossfade_pcm, item->pcm, item->pcm, frames, fade->done, fade->length);
+    
+    fade->frame += frames;
+    fade->done += frames;
+    if (fade->done >= fade->length) {
+        fade->track = -1;
+    }
+}
+
+static void *reader_thread(void *arg) {
+    pipeline_stage_t *stage = &stages[STAGE_READER];
+    uint32_t generation = 0;
+    int position = 0, chunk = 0;
+    uint32_t frame = 0;
+    int setup = 0;              // Pista nueva: recalcular transporte y chunk inicial
+    int from_head = 0;          // El chunk 0 salió del caché: la pista abierta no pasó por setup
+    int ended = 0;              // Fin de la playlist (sin repetir) o ninguna pista abre
+    uint32_t failures = 0;
+    int stream_start = 0, song_start = 0;
+    crossfade_t fade = { .track = -1 };
+    int fade_from = -1;         // NEXT/PREV con crossfade: posición saliente
+    uint32_t fade_from_frame = 0;
+    int planned = 0;            // Fin de la pista: siguiente y corte ya calculados
+    int plan_next = -1;
+    uint64_t plan_end = UINT64_MAX;
+    uint32_t plan_length = 0;
+    (void)arg;
+    
+    while (1) {
+        reader_apply_changes();
+        
+        uint32_t current = atomic_load_explicit(&stream_generation, memory_order_acquire);
+        if (current != generation) {
+            generation = current;
+            position = atomic_load_explicit(&seek_position, memory_order_relaxed);
+            frame = atomic_load_explicit(&seek_frame, memory_order_relaxed);
+            setup = 1;
+            ended = 0;
+            failures = 0;
+            stream_start = 1;
+            song_start = 0;
+            fade.track = -1;
+            fade_from = atomic_load_explicit(&fade_position, memory_order_relaxed);
+            fade_from_frame = atomic_load_explicit(&fade_frame, memory_order_relaxed);
+        }
+        
+        if (generation == 0 || ended || position < 0 || position >= (int)playlist.count) {
+            usleep(PIPELINE_IDLE_US);
+            continue;
+        }
+        
+        int track = playlist_track(&playlist, position);
+        head_entry_t *head = (setup ? frame == 0 : chunk == 0) ? head_lookup(track) : NULL;
+        song_info_t *info = head ? &head->info : track_get(track);
+        if (!info) {
+            // Pista que no abre (o que se quitó mientras sonaba): saltarla,
+            // aunque se repita una sola
+            if (++failures >= playlist.count) {
+                printf("ERROR: Ninguna pista de la playlist se pudo abrir\n");
+                ended = 1;
+                continue;
+            }
+            int next = (playlist.repeat == PLAYLIST_REPEAT_ONE) ?
+                       (int)playlist_next(&playlist, position) : playlist_advance(&playlist, position);
+            ended = (next < 0);
+            position = next;
+            frame = 0;
+            setup = 1;
+            song_start = 1;
+            fade.track = -1;
+            fade_from = -1;
+            continue;
+        }
+        
+        if (setup) {
+            // El fallback pudo cambiar la tasa desde que se abrió
+            set_song_transport(info);
+            chunk = frame / info->src_chunk_frames;
+            failures = 0;
+            setup = 0;
+            planned = 0;
+            plan_end = UINT64_MAX;
+            
+            // La saliente sigue en el caché de pistas (la más usada después de esta)
+            song_info_t *from = (fade_from >= 0 && frame == 0) ?
+                                track_get(playlist_track(&playlist, fade_from)) : NULL;
+            if (from) {
+                uint64_t cursor = (uint64_t)fade_from_frame * from->sample_rate / from->codec_rate;
+                fade = (crossfade_t){ from->track, cursor, 0, crossfade_frames(from, info, cursor) };
+                if (fade.length == 0) {
+                    fade.track = -1;
+                }
+            }
+            fade_from = -1;
+        } else if (from_head && !head) {
+            set_song_transport(info);
+            from_head = 0;
+        }
+        
+        // Cerca del final: elegir la siguiente y dónde cortar esta para el crossfade
+        uint64_t first_frame = (uint64_t)chunk * info->src_chunk_frames;
+        if (crossfade_ms > 0 && !planned && fade.track < 0 &&
+            first_frame + info->src_chunk_frames + (uint64_t)crossfade_ms * info->sample_rate / 1000 >=
+            info->total_frames) {
+            song_info_t *next_info = NULL;
+            plan_next = playlist_advance(&playlist, position);
+            plan_length = 0;
+            if (plan_next >= 0) {
+                next_info = track_get(playlist_track(&playlist, plan_next));
+            }
+            if (next_info) {
+                set_song_transport(next_info);
+                plan_length = crossfade_frames(info, next_info, first_frame);
+                // La saliente pudo quedar fuera del caché al abrir la siguiente
+                info = track_get(playlist_track(&playlist, position));
+            }
+            if (!info) {
+                continue;
+            }
+            plan_end = info->total_frames - plan_length;
+            planned = 1;
+        }
+        
+        if (chunk >= (int)info->num_chunks || first_frame >= plan_end) {
+            song_save_points(info);
+            int next = playlist_advance(&playlist, position);
+            if (planned && plan_length > 0 && next == plan_next) {
+                fade = (crossfade_t){ info->track, plan_end, 0, plan_length };
+            }
+            ended = (next < 0);
+            position = next;
+            frame = 0;
+            setup = 1;
+            song_start = 1;
+            continue;
+        }
+        
+        pipeline_chunk_t *item = spsc_pop(&queue_free);
+        if (!item) {
+            // Pipeline lleno: tiempo libre para las cabezas de las vecinas
+            if (!head_prefetch(position)) {
+                usleep(PIPELINE_IDLE_US);
+            }
+            continue;
+        }
+        
+        uint64_t start = monotonic_ns();
+        item->generation = generation;
+        item->position = position;
+        item->track = info->track;
+        item->chunk = chunk;
+        item->stream_start = stream_start;
+        item->song_start = song_start;
+        item->transport = info->transport;
+        item->sample_rate = info->sample_rate;
+        item->codec_rate = info->codec_rate;
+        item->num_chunks = info->num_chunks;
+        item->file_size = info->file_size;
+        item->duration_sec = info->duration_sec;
+        item->s24 = song_reads_s24(info);
+        item->native = (info->format == SONG_FORMAT_NATIVE);
+        // Frames hasta el corte del crossfade (el último chunk queda corto)
+        uint32_t frames = info->src_chunk_frames;
+        if (plan_end - first_frame < frames) {
+            frames = (uint32_t)(plan_end - first_frame);
+        }
+        item->flush = (chunk + 1 >= (int)info->num_chunks || first_frame + frames >= plan_end);
+        if (head) {
+            head_copy(head, item);
+            if (item->src_frames > frames) {
+                item->src_frames = frames;
+            }
+            from_head = 1;
+            atomic_fetch_add_explicit(&head_hits, 1, memory_order_relaxed);
+        } else if (item->native) {
+            // Tal cual al buffer que va al bridge: no pasa por el caché de cabezas
+            item->src_frames = native_read_chunk(&info->native, chunk, item->payload, sizeof(item->payload),
+                                                 &item->payload_bytes);
+        } else {
+            item->src_frames = read_song_frames(info, first_frame, frames,
+                                                item->pcm, item->s24 ? item->payload : NULL);
+            if (chunk == 0 && item->src_frames > 0 && frames == info->src_chunk_frames) {
+                head_store(info, item);
+                atomic_fetch_add_explicit(&head_misses, 1, memory_order_relaxed);
+            }
+        }
+        if (fade.track >= 0 && item->src_frames > 0) {
+            crossfade_mix(&fade, item);
+        }
+        latency_hist_record(&hist_read, elapsed_us(start));
+        item->failed = (item->src_frames == 0);
+        if (item->failed) {
+            printf("ERROR: Lectura falló (pista %d, chunk %d)\n", info->track + 1, chunk + 1);
+        }
+        stage_account(stage, start, item->native ? item->payload_bytes : item->src_frames * (item->s24 ? 6 : 4));
+        
+        stream_start = 0;
+        song_start = 0;
+        chunk++;
+        
+        // Nunca se llena: hay menos buffers que capacidad
+        spsc_push(&queue_read, item);
+    }
+    return NULL;
+}
+
+// --- Streams de otros procesos (--ingest, --serve): reemplazan a reader_thread ---
+// Cada productor es una canción: chunk 0 al conectarse, total_chunks sin
+// límite (el Nios no la termina por cuenta). Los chunks son cortos para que
+// lo que espera en el pipeline no sume latencia.
+#define STREAM_CHUNK_FRAMES     1920    // 40 ms a 48 kHz
+#define STREAM_ACCEPT_MS        100
+#define STREAM_READ_MS          20      // Entregar lo que haya si el productor se demora
+
+// Como codec_rate_for, pero 96 kHz también se convierte: PCM24 pide dos
+// slots llenos y un stream va con lo que llega
+static uint32_t stream_codec_rate(uint32_t rate) {
+    uint32_t codec_rate = codec_rate_for(rate);
+    return (codec_rate == HIRATE_RATE) ? CODEC_DEFAULT_RATE : codec_rate;
+}
+
+// Frames de entrada por chunk
+static uint32_t stream_src_frames(uint32_t rate, uint32_t codec_rate) {
+    resampler_t rs;
+    
+    if (codec_rate == rate) {
+        return STREAM_CHUNK_FRAMES;
+    }
+    resampler_init(&rs, rate, codec_rate);
+    return resampler_input_frames(&rs, STREAM_CHUNK_FRAMES);
+}
+
+// 'track' distingue los streams (el resampler y la posición la usan);
+// 'first': primer chunk desde el arranque, se entrega sin esperar
+static void stream_fill_item(pipeline_chunk_t *item, int track, int chunk, int first,
+                             uint32_t rate, uint32_t codec_rate, uint32_t frames) {
+    item->generation = atomic_load_explicit(&stream_generation, memory_order_acquire);
+    item->position = -1;        // Sin playlist
+    item->track = track;
+    item->chunk = chunk;
+    item->stream_start = first;
+    item->song_start = (chunk == 0 && !first);
+    item->failed = 0;
+    item->transport = sample_format;
+    item->sample_rate = rate;
+    item->codec_rate = codec_rate;
+    item->num_chunks = UINT32_MAX;
+    item->file_size = 0;
+    item->duration_sec = 0;
+    item->s24 = 0;
+    item->native = 0;
+    item->flush = 0;
+    item->src_frames = frames;
+}
+
+static void *ingest_thread(void *arg) {
+    pipeline_stage_t *stage = &stages[STAGE_READER];
+    pipeline_chunk_t *item = NULL;  // Se retiene mientras no llegan datos: queue_free es de escritura
+    int first = 1;
+    (void)arg;
+    
+    while (1) {
+        int ready = ingest_accept(&ingest, STREAM_ACCEPT_MS);
+        if (ready < 0) {
+            printf("Ingesta: %s terminó, no hay más streams\n", ingest.path);
+            return NULL;
+        }
+        if (ready == 0) {
+            continue;
+        }
+        if (first) {
+            // Cambio de pista→listo: desde que conecta el productor, no desde el arranque
+            atomic_store_explicit(&stream_request_ns, monotonic_ns(), memory_order_relaxed);
+        }
+        
+        uint32_t codec_rate = stream_codec_rate(ingest.sample_rate);
+        uint32_t src_frames = stream_src_frames(ingest.sample_rate, codec_rate);
+        uint32_t frame_bytes = ingest.bits_per_sample / 8 * ingest.channels;
+        uint32_t chunk_ms = STREAM_CHUNK_FRAMES * 1000 / codec_rate;
+        printf("✓ Stream %u desde %s: %s, %u Hz, %u bits, %s", ingest.streams, ingest.path,
+               ingest.wav ? "WAV" : "PCM crudo", ingest.sample_rate, ingest.bits_per_sample,
+               ingest.channels == 1 ? "mono" : "estéreo");
+        if (codec_rate != ingest.sample_rate) {
+            printf(" (convertido a %u Hz)", codec_rate);
+        }
+        printf("\n  Latencia en el HPS: hasta %u ms (kernel %u KB + %d chunks de %u ms)\n",
+               (uint32_t)((uint64_t)ingest.kernel_buffer * 1000 / (frame_bytes * ingest.sample_rate)) +
+               PIPELINE_CHUNKS * chunk_ms, ingest.kernel_buffer / 1024, PIPELINE_CHUNKS, chunk_ms);
+        
+        for (int chunk = 0; ; ) {
+            if (!item) {
+                item = spsc_pop(&queue_free);
+                if (!item) {
+                    usleep(PIPELINE_IDLE_US);
+                    continue;
+                }
+            }
+            
+            int frames = ingest_read(&ingest, item->pcm, src_frames, STREAM_READ_MS);
+            if (frames < 0) {
+                printf("Ingesta: stream %u terminado (%d chunks)\n", ingest.streams, chunk);
+                // Chunk vacío: solo lleva lo que retiene el limitador
+                stream_fill_item(item, 0, chunk, first, ingest.sample_rate, codec_rate, 0);
+                item->flush = 1;
+                spsc_push(&queue_read, item);
+                item = NULL;
+                break;
+            }
+            if (frames == 0) {
+                continue;
+            }
+            
+            uint64_t start = monotonic_ns();
+            stream_fill_item(item, 0, chunk, first, ingest.sample_rate, codec_rate, frames);
+            stage_account(stage, start, frames * 4);
+            
+            first = 0;
+            chunk++;
+            spsc_push(&queue_read, item);
+            item = NULL;
+        }
+    }
+    return NULL;
+}
+
+int read_play_position(uint64_t *frames, uint64_t *ticks);
+
+// Frames del stream 'track' que el Nios ya reprodujo, a la tasa del cliente.
+// Se cuenta desde frames_played al entregar su chunk 0: como espera a que el
+// Nios vacíe el anterior, ahí no quedaba nada sonando.
+static int stream_played(int track, uint32_t rate, uint32_t codec_rate, uint64_t *played) {
+    uint64_t frames, ticks;
+    
+    if (atomic_load_explicit(&stream_track, memory_order_acquire) != track ||
+        read_play_position(&frames, &ticks) != 0) {
+        return -1;
+    }
+    uint64_t base = atomic_load_explicit(&stream_base_frames, memory_order_relaxed);
+    *played = (frames > base) ? (frames - base) * rate / codec_rate : 0;
+    return 0;
+}
+
+// --- Mezcla de clientes (--serve) ---
+// Hasta FPGA_AUDIO_MAX_CLIENTS clientes suenan juntos: el hilo de lectura
+// convierte cada uno a MIXER_RATE y los mezcla (audio_mixer) en un solo
+// stream para el Nios. Los clientes llegan por server_accept_thread y se
+// publican sin locks (ver audio_server.h). El stream dura mientras haya
+// alguno; el siguiente después de un silencio empieza otro.
+#define MIXER_RATE              CODEC_DEFAULT_RATE
+#define SERVER_READ_FRAMES      2048
+
+_Static_assert(MIXER_SOURCES >= FPGA_AUDIO_MAX_CLIENTS, "una fuente del mixer por cliente");
+
+static mixer_t mixer;                               // Hilo de lectura
+static int16_t server_pcm[SERVER_READ_FRAMES * 2];  // Del anillo al mixer
+
+static void *server_accept_thread(void *arg) {
+    (void)arg;
+    
+    while (1) {
+        audio_server_accept(&server, STREAM_ACCEPT_MS, MIXER_RATE);
+    }
+    return NULL;
+}
+
+// Pasa al staging del mixer lo que entre. -1: la sesión terminó.
+static int server_pull(int index) {
+    uint32_t space = mixer_source_space(&mixer, index);
+    
+    while (space > 0) {
+        int frames = audio_server_read(&server, index, server_pcm,
+                                       space < SERVER_READ_FRAMES ? space : SERVER_READ_FRAMES);
+        if (frames <= 0) {
+            return frames;
+        }
+        mixer_source_push(&mixer, index, server_pcm, frames);
+        space = mixer_source_space(&mixer, index);
+    }
+    return 0;
+}
+
+static void *server_thread(void *arg) {
+    pipeline_stage_t *stage = &stages[STAGE_READER];
+    pipeline_chunk_t *item = NULL;
+    int joined[FPGA_AUDIO_MAX_CLIENTS] = { 0 };     // Sesión ACTIVE ya agregada al mixer
+    int ended[FPGA_AUDIO_MAX_CLIENTS] = { 0 };      // El cliente cerró y su anillo quedó vacío
+    int first = 1, track = 0, chunk = 0, streaming = 0;
+    int unflushed = 0;          // Hay chunks sin vaciar el limitador detrás
+    uint64_t wait_start = 0;    // Primer intento de armar el bloque en curso
+    pthread_t acceptor;
+    (void)arg;
+    
+    mixer_init(&mixer, MIXER_RATE);
+    if (pthread_create(&acceptor, NULL, server_accept_thread, NULL) != 0) {
+        printf("ERROR: No se pudo crear el hilo de aceptación de clientes\n");
+        return NULL;
+    }
+    pthread_detach(acceptor);
+    
+    while (1) {
+        uint64_t mix_played = 0;
+        int active = 0;
+        
+        if (streaming) {
+            stream_played(track, MIXER_RATE, MIXER_RATE, &mix_played);
+        }
+        
+        for (int i = 0; i < FPGA_AUDIO_MAX_CLIENTS; i++) {
+            audio_session_t *session = &server.session[i];
+            if (!joined[i]) {
+                if (atomic_load_explicit(&session->state, memory_order_acquire) != AUDIO_SESSION_ACTIVE) {
+                    continue;
+                }
+                uint32_t volume = atomic_load_explicit(&session->ring->volume, memory_order_relaxed);
+                mixer_source_start(&mixer, i, session->sample_rate,
+                                   (session->flags & FPGA_AUDIO_FLAG_DUCK) ? MIXER_FLAG_DUCK : 0,
+                                   volume <= FPGA_AUDIO_VOLUME_MAX ? volume : VOLUME_DEFAULT);
+                joined[i] = 1;
+                ended[i] = 0;
+                printf("✓ Cliente %u conectado: %u Hz%s%s, anillo de %u frames (%u ms)\n", session->id,
+                       session->sample_rate, session->sample_rate != MIXER_RATE ? " (convertido)" : "",
+                       (session->flags & FPGA_AUDIO_FLAG_DUCK) ? ", alerta (ducking)" : "",
+                       session->mask + 1, (session->mask + 1) * 1000 / session->sample_rate);
+            }
+            
+            int volume = audio_server_volume(&server, i);
+            if (volume >= 0) {
+                mixer_source_volume(&mixer, i, (uint32_t)volume);
+            }
+            if (!ended[i] && server_pull(i) < 0) {
+                ended[i] = 1;
+            }
+            if (ended[i] && mixer.source[i].staged_frames == 0) {
+                printf("Cliente %u desconectado (%llu frames)\n", session->id,
+                       (unsigned long long)mixer.source[i].mixed);
+                mixer_source_stop(&mixer, i);
+                audio_server_release(&server, i);
+                joined[i] = 0;
+                continue;
+            }
+            
+            // Todo lo suyo ya sonó y no manda más: lo que falta es el resto del resampler
+            uint64_t played = mixer_source_played(&mixer, i, mix_played);
+            if (mixer_source_drained(&mixer, i, mix_played) && audio_server_queued(&server, i) == 0) {
+                played = UINT64_MAX;
+            }
+            audio_server_played(&server, i, played);
+            active++;
+        }
+        
+        // Sin clientes, pero lo último mezclado sigue en el limitador: antes de
+        // cerrar el stream va un chunk vacío que lo vacía
+        if (active == 0 && !unflushed) {
+            if (streaming) {
+                // Sin clientes: el próximo empieza un stream nuevo
+                streaming = 0;
+                chunk = 0;
+                mixer_restart(&mixer);
+            }
+            wait_start = 0;
+            audio_server_wait(&server, STREAM_ACCEPT_MS);
+            continue;
+        }
+        
+        // Bloque completo si todos los que siguen conectados llegan; si no,
+        // después de STREAM_READ_MS lo que haya (los que faltan, en silencio)
+        uint32_t ready = UINT32_MAX, most = 0;
+        for (int i = 0; i < FPGA_AUDIO_MAX_CLIENTS; i++) {
+            if (!joined[i]) {
+                continue;
+            }
+            uint32_t staged = mixer.source[i].staged_frames;
+            if (!ended[i] && staged < ready) {
+                ready = staged;
+            }
+            if (staged > most) {
+                most = staged;
+            }
+        }
+        // Sin datos después de STREAM_READ_MS el chunk sale corto y vacía el
+        // limitador: lo que escribió un cliente suena entero (y fpga_audio_drain termina)
+        uint32_t frames = (ready != UINT32_MAX) ? ready : most;
+        if (frames < STREAM_CHUNK_FRAMES && active > 0) {
+            uint64_t now = monotonic_ns();
+            if (wait_start == 0 && (most > 0 || unflushed)) {
+                wait_start = now;
+            }
+            if (wait_start == 0 || now - wait_start < (uint64_t)STREAM_READ_MS * 1000000) {
+                audio_server_wait(&server, STREAM_READ_MS);
+                continue;
+            }
+            frames = most;
+        }
+        if (frames > STREAM_CHUNK_FRAMES) {
+            frames = STREAM_CHUNK_FRAMES;
+        }
+        
+        if (!item) {
+            item = spsc_pop(&queue_free);
+            if (!item) {
+                usleep(PIPELINE_IDLE_US);
+                continue;
+            }
+        }
+        
+        uint64_t start = monotonic_ns();
+        if (!streaming) {
+            streaming = 1;
+            track++;
+            if (first) {
+                atomic_store_explicit(&stream_request_ns, start, memory_order_relaxed);
+            }
+        }
+        if (frames > 0) {
+            mixer_mix(&mixer, item->pcm, frames);
+        }
+        stream_fill_item(item, track, chunk, first, MIXER_RATE, MIXER_RATE, frames);
+        item->flush = (frames < STREAM_CHUNK_FRAMES);
+        unflushed = !item->flush;
+        stage_account(stage, start, frames * 4);
+        
+        first = 0;
+        chunk++;
+        wait_start = 0;
+        spsc_push(&queue_read, item);
+        item = NULL;
+    }
+    return NULL;
+}
+
+// --- Etapa de transformación: conversión de tasa, volumen/limitador, ADPCM ---
+static void transform_chunk(pipeline_chunk_t *item) {
+    // Solo al empezar un stream: entre canciones (también en un crossfade) no
+    // se descarta lo que el limitador retiene de la saliente
+    if (item->stream_start || item->generation != limiter_generation) {
+        limiter_generation = item->generation;
+        limiter_reset(&limiter);
+        adpcm_reset(adpcm_state);
+    }
+    
+    if (item->native) {
+        // Ya son palabras del codec: a volumen unitario no se tocan. Con otro
+        // volumen, ganancia con saturación (el limitador no ve estos chunks).
+        int32_t gain = limiter.volume_gain;
+        if (gain != LIMITER_UNITY_GAIN) {
+            if (item->transport == SAMPLE_FORMAT_PCM24) {
+                dsp_gain_s24(item->payload, item->src_frames * 2, gain);
+            } else {
+                dsp_gain_ramp_stereo_s16((int16_t *)item->payload, (int16_t *)item->payload,
+                                         item->src_frames, gain, gain);
+            }
+        }
+        item->frames = item->src_frames;
+        item->limiter_gain = gain;
+        return;
+    }
+    
+    if (item->transport == SAMPLE_FORMAT_PCM24) {
+        if (item->s24) {
+            // 24 bits: solo volumen con saturación (el limitador trabaja a 16 bits)
+            dsp_gain_s24(item->payload, item->src_frames * 2, limiter.volume_gain);
+            item->frames = item->src_frames;
+            item->limiter_gain = limiter.volume_gain;
+        } else {
+            // 16 bits: mismo limitador que el transporte PCM16, después a 24 bits
+            item->frames = limiter_process(&limiter, item->pcm, staging_out, item->src_frames);
+            if (item->flush) {
+                item->frames += limiter_flush(&limiter, staging_out + 2 * item->frames);
+            }
+            for (uint32_t i = 0; i < item->frames * 2; i++) {
+                item->payload[i] = staging_out[i] * 256;
+            }
+            item->limiter_gain = limiter.min_gain;
+            limiter.min_gain = limiter.gain;
+        }
+        item->payload_bytes = item->frames * 8;
+        return;
+    }
+    
+    // Tasa no soportada por el codec: convertir (el estado sigue entre chunks consecutivos)
+    const int16_t *pcm = item->pcm;
+    uint32_t pcm_frames = item->src_frames;
+    if (item->codec_rate != item->sample_rate) {
+        if (resampler_track != item->track || resampler_next_chunk != item->chunk) {
+            resampler_init(&resampler, item->sample_rate, item->codec_rate);
+        }
+        if (pcm_frames > 0) {
+            pcm_frames = resampler_process(&resampler, item->pcm, pcm_frames,
+                                           staging_resampled, chunk_frames);
+        }
+        pcm = staging_resampled;
+        resampler_track = item->track;
+        resampler_next_chunk = item->chunk + 1;
+    }
+    
+    uint32_t frames = limiter_process(&limiter, pcm, staging_out, pcm_frames);
+    if (item->flush) {
+        frames += limiter_flush(&limiter, staging_out + 2 * frames);
+    }
+    
+    if (item->transport == SAMPLE_FORMAT_ADPCM) {
+        // Codificar en DRAM: 4x menos tráfico por el puente
+        item->payload_bytes = adpcm_encode_stereo(adpcm_state, staging_out, frames,
+                                                  (uint8_t*)item->payload);
+    } else {
+        // El vaciado del limitador puede pasar AUDIO_CHUNK_SIZE: entra en el margen del bridge
+        if (frames * 4 > sizeof(item->payload)) {
+            frames = sizeof(item->payload) / 4;
+        }
+        memcpy(item->payload, staging_out, frames * 4);
+        item->payload_bytes = frames * 4;
+    }
+    item->frames = frames;
+    item->limiter_gain = limiter.min_gain;
+    limiter.min_gain = limiter.gain;
+}
+
+static void *transform_thread(void *arg) {
+    pipeline_stage_t *stage = &stages[STAGE_TRANSFORM];
+    uint32_t volume = VOLUME_DEFAULT;
+    (void)arg;
+    
+    while (1) {
+        pipeline_chunk_t *item = spsc_pop(&queue_read);
+        if (!item) {
+            usleep(PIPELINE_IDLE_US);
+            continue;
+        }
+        
+        uint32_t requested = atomic_load_explicit(&pipeline_volume, memory_order_relaxed);
+        if (requested != volume) {
+            limiter_set_volume(&limiter, requested);
+            volume = requested;
+        }
+        
+        // Los descartados siguen de largo: escritura devuelve el buffer
+        if (!item->failed && !chunk_is_stale(item)) {
+            uint64_t start = monotonic_ns();
+            transform_chunk(item);
+            stage_account(stage, start, item->payload_bytes);
+        }
+        spsc_push(&queue_ready, item);
+    }
+    return NULL;
+}
+
+// --- Etapa de escritura: copiar al bridge cuando el Nios lo pide ---
+// Al cambiar de canción se espera a que el Nios vacíe lo que tiene, según
+// el transporte que el bridge tiene en curso (puede ser otro).
+static int bridge_wants_chunk(const pipeline_chunk_t *item, int song_start, uint32_t next_slot) {
+    uint32_t transport = song_start ? shared_ctrl->sample_format : item->transport;
+    
+    if (transport == SAMPLE_FORMAT_PCM24) {
+        if (song_start) {
+            return shared_ctrl->slot_bytes[0] == 0 && shared_ctrl->slot_bytes[1] == 0;
+        }
+        return shared_ctrl->slot_bytes[next_slot] == 0;
+    }
+    return shared_ctrl->request_next && !shared_ctrl->chunk_ready;
+}
+
+// Pedido pendiente del Nios en el transporte en curso (sin mirar la cola)
+static int bridge_requesting(uint32_t next_slot) {
+    if (shared_ctrl->sample_format == SAMPLE_FORMAT_PCM24) {
+        return shared_ctrl->slot_bytes[next_slot] == 0;
+    }
+    return shared_ctrl->request_next && !shared_ctrl->chunk_ready;
+}
+
+static void deliver_chunk(const pipeline_chunk_t *item, int new_stream, uint32_t *next_slot) {
+    volatile uint8_t *dst = shared_audio;
+    uint64_t frames, ticks;
+    
+    if (new_stream) {
+        if (read_play_position(&frames, &ticks) == 0) {
+            atomic_store_explicit(&stream_base_frames, frames, memory_order_relaxed);
+        }
+        atomic_store_explicit(&stream_track, item->track, memory_order_release);
+        shared_ctrl->song_id = item->track;
+        shared_ctrl->sample_rate = item->codec_rate;
+        shared_ctrl->total_chunks = item->num_chunks;
+        shared_ctrl->song_total_size = item->file_size;
+        shared_ctrl->duration_sec = item->duration_sec;
+        atomic_store_explicit(&playing_position, item->position, memory_order_release);
+    }
+    
+    if (item->transport == SAMPLE_FORMAT_PCM24) {
+        // Stream nuevo: vaciar los slots, cargar el 0 y avisar con chunk_ready
+        if (new_stream) {
+            shared_ctrl->slot_bytes[0] = 0;
+            shared_ctrl->slot_bytes[1] = 0;
+            *next_slot = 0;
+        }
+        dst += *next_slot ? HIRATE_SLOT_SIZE : 0;
+    }
+    
+    uint64_t copy_start = monotonic_ns();
+    memcpy((void*)dst, item->payload, item->payload_bytes);
+    latency_hist_record(&hist_copy, elapsed_us(copy_start));
+    
+    if (item->transport == SAMPLE_FORMAT_PCM24) {
+        shared_ctrl->slot_bytes[*next_slot] = item->payload_bytes;
+        shared_ctrl->current_chunk = item->chunk;
+        shared_ctrl->request_next = 0;
+        if (new_stream) {
+            shared_ctrl->sample_format = SAMPLE_FORMAT_PCM24;
+            shared_ctrl->chunk_size = item->payload_bytes;
+            shared_ctrl->chunk_frames = item->frames;
+            shared_ctrl->chunk_ready = 1;
+        }
+        *next_slot ^= 1;
+    } else {
+        shared_ctrl->sample_format = item->transport;
+        shared_ctrl->chunk_frames = item->frames;
+        shared_ctrl->chunk_size = item->payload_bytes;
+        shared_ctrl->current_chunk = item->chunk;
+        shared_ctrl->chunk_ready = 1;
+        shared_ctrl->request_next = 0;
+    }
+    
+    shared_ctrl->limiter_gain = item->limiter_gain;
+    shared_ctrl->chunks_loaded++;
+    shared_ctrl->buffer_level = (item->chunk * 100) / item->num_chunks;
+}
+
+static void *writer_thread(void *arg) {
+    pipeline_stage_t *stage = &stages[STAGE_WRITER];
+    uint32_t next_slot = 0;
+    int pending_stream_start = 0, pending_song_start = 0;
+    uint64_t request_ns = 0;    // Cuándo se vio el pedido (hasta PIPELINE_IDLE_US después del Nios); 0 = ninguno
+    (void)arg;
+    
+    while (1) {
+        if (request_ns == 0 && bridge_requesting(next_slot)) {
+            request_ns = monotonic_ns();
+        }
+        
+        pipeline_chunk_t *item = spsc_peek(&queue_ready);
+        if (!item) {
+            usleep(PIPELINE_IDLE_US);
+            continue;
+        }
+        
+        if (chunk_is_stale(item)) {
+            spsc_pop(&queue_ready);
+            spsc_push(&queue_free, item);
+            pending_stream_start = 0;
+            pending_song_start = 0;
+            continue;
+        }
+        
+        // Chunk perdido: el inicio de stream/canción pasa al siguiente
+        int stream_start = item->stream_start || pending_stream_start;
+        int song_start = item->song_start || pending_song_start;
+        if (item->failed || item->payload_bytes == 0) {
+            if (item->failed) {
+                shared_ctrl->error_flags |= 0x01;
+            }
+            pending_stream_start = stream_start;
+            pending_song_start = song_start;
+            spsc_pop(&queue_ready);
+            spsc_push(&queue_free, item);
+            continue;
+        }
+        
+        if (!stream_start && !bridge_wants_chunk(item, song_start, next_slot)) {
+            usleep(PIPELINE_IDLE_US);
+            continue;
+        }
+        
+        uint64_t start = monotonic_ns();
+        deliver_chunk(item, stream_start || song_start, &next_slot);
+        stage_account(stage, start, item->payload_bytes);
+        
+        // Pedido → chunk_ready publicado. Un cambio de posición no responde a un
+        // pedido: se mide desde request_stream()
+        if (request_ns != 0 && !stream_start) {
+            latency_hist_record(&hist_refill, elapsed_us(request_ns));
+        }
+        if (stream_start) {
+            uint64_t requested = atomic_exchange_explicit(&stream_request_ns, 0, memory_order_relaxed);
+            if (requested != 0) {
+                latency_hist_record(&hist_skip, elapsed_us(requested));
+            }
+        }
+        request_ns = 0;
+        pending_stream_start = 0;
+        pending_song_start = 0;
+        
+        spsc_pop(&queue_ready);
+        spsc_push(&queue_free, item);
+    }
+    return NULL;
+}
+
+static int pipeline_start(void) {
+    void *(*entry[PIPELINE_STAGES])(void *) = {
+        ingest_spec ? ingest_thread : serve_mode ? server_thread : reader_thread,
+        transform_thread, writer_thread
+    };
+    pthread_attr_t attr;
+    
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PIPELINE_STACK_SIZE);
+    latency_hist_init(&hist_refill, "request_to_ready_us");
+    latency_hist_init(&hist_read, "read_us");
+    latency_hist_init(&hist_copy, "bridge_copy_us");
+    latency_hist_init(&hist_skip, "stream_change_us");
+    head_cache_init();
+    
+    spsc_init(&queue_free);
+    spsc_init(&queue_read);
+    spsc_init(&queue_ready);
+    spsc_init(&queue_changed);
+    for (int i = 0; i < PIPELINE_CHUNKS; i++) {
+        spsc_push(&queue_free, &pipeline_chunks[i]);
+    }
+    
+    for (int i = 0; i < PIPELINE_STAGES; i++) {
+        pthread_t thread;
+        int err = pthread_create(&thread, &attr, entry[i], NULL);
+        if (err != 0) {
+            printf("ERROR: No se pudo crear el hilo de %s: %s\n", stages[i].name, strerror(err));
+            pthread_attr_destroy(&attr);
+            return -1;
+        }
+        pin_thread(thread, stages[i].cpu, stages[i].name);
+        if (realtime_mode) {
+            set_thread_realtime(thread, stages[i].priority, stages[i].name);
+        }
+        pthread_detach(thread);
+    }
+    pthread_attr_destroy(&attr);
+    
+    pin_thread(pthread_self(), control_cpu, "control");
+    if (realtime_mode) {
+        set_thread_realtime(pthread_self(), control_priority, "control");
+    }
+    return 0;
+}
+
+// Por etapa: ritmo, ocupación del hilo y profundidad de su cola de salida
+void report_pipeline(uint32_t loop_counter) {
+    static uint32_t last_chunks[PIPELINE_STAGES];
+    static uint64_t last_bytes[PIPELINE_STAGES], last_busy[PIPELINE_STAGES];
+    static uint64_t last_ns = 0;
+    spsc_queue_t *output[PIPELINE_STAGES] = { &queue_read, &queue_ready, &queue_free };
+    uint64_t now = monotonic_ns();
+    
+    for (int i = 0; i < PIPELINE_STAGES; i++) {
+        uint32_t chunks = atomic_load_explicit(&stages[i].chunks, memory_order_relaxed);
+        uint64_t bytes = atomic_load_explicit(&stages[i].bytes, memory_order_relaxed);
+        uint64_t busy = atomic_load_explicit(&stages[i].busy_ns, memory_order_relaxed);
+        
+        if (last_ns != 0) {
+            double secs = (now - last_ns) / 1e9;
+            printf("[%06d] Pipeline %-15s %5.1f chunks/s, %6.2f MB/s, %5.1f%% ocupado, cola %u/%d\n",
+                   loop_counter, stages[i].name, (chunks - last_chunks[i]) / secs,
+                   (bytes - last_bytes[i]) / secs / (1024.0 * 1024.0),
+                   (busy - last_busy[i]) / 1e7 / secs, spsc_depth(output[i]), PIPELINE_CHUNKS);
+        }
+        last_chunks[i] = chunks;
+        last_bytes[i] = bytes;
+        last_busy[i] = busy;
+    }
+    last_ns = now;
+    
+    printf("[%06d] Recarga pedido→listo: p50 %u us, p99 %u us, max %u us (%u pedidos)\n",
+           loop_counter, latency_hist_percentile(&hist_refill, 50),
+           latency_hist_percentile(&hist_refill, 99),
+           atomic_load_explicit(&hist_refill.max, memory_order_relaxed),
+           atomic_load_explicit(&hist_refill.count, memory_order_relaxed));
+    printf("[%06d] Cambio de pista→listo: p50 %u us, p99 %u us, max %u us (%u cambios), "
+           "cabezas en caché: %u aciertos, %u fallos\n",
+           loop_counter, latency_hist_percentile(&hist_skip, 50),
+           latency_hist_percentile(&hist_skip, 99),
+           atomic_load_explicit(&hist_skip.max, memory_order_relaxed),
+           atomic_load_explicit(&hist_skip.count, memory_order_relaxed),
+           atomic_load_explicit(&head_hits, memory_order_relaxed),
+           atomic_load_explicit(&head_misses, memory_order_relaxed));
+    if (ingest_spec) {
+        printf("[%06d] Ingesta: %u streams, %llu KB recibidos, %u bytes esperando en el kernel\n",
+               loop_counter, ingest.streams, (unsigned long long)(ingest.bytes / 1024), ingest_queued(&ingest));
+    }
+    if (analysis_started) {
+        printf("[%06d] Análisis: %u pistas analizadas, %u fallidas\n", loop_counter,
+               atomic_load_explicit(&analysis_done, memory_order_relaxed),
+               atomic_load_explicit(&analysis_failed, memory_order_relaxed));
+    }
+    if (serve_mode) {
+        printf("[%06d] Servidor: %u clientes atendidos, %u rechazados (sin lugar), %llu frames recibidos\n",
+               loop_counter, atomic_load_explicit(&server.sessions, memory_order_relaxed),
+               atomic_load_explicit(&server.rejected, memory_order_relaxed),
+               (unsigned long long)atomic_load_explicit(&server.frames, memory_order_relaxed));
+    }
+}
+
+// --- Estadísticas en JSON para análisis externo ---
+// Se reescribe entero cada segundo (archivo temporal + rename: quien lo lea
+// nunca ve uno a medias). Histogramas acumulados desde el arranque.
+#define STATS_PATH_DEFAULT   "/run/hps_audio_loader.json"
+#define STATS_PERIOD_LOOPS   100     // 1 s
+
+const char *stats_path = STATS_PATH_DEFAULT;
+
+void write_stats_file(void) {
+    static int warned = 0;
+    latency_hist_t *hists[] = { &hist_refill, &hist_read, &hist_copy, &hist_skip };
+    char tmp_path[300];
+    struct timespec now;
+    
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", stats_path);
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) {
+        if (!warned) {
+            printf("⚠ No se pudo escribir %s: %s\n", tmp_path, strerror(errno));
+            warned = 1;
+        }
+        return;
+    }
+    
+    clock_gettime(CLOCK_REALTIME, &now);
+    fprintf(file, "{\"time\": %lld, \"position\": %d, \"track\": %u, \"chunk\": %u, "
+            "\"chunks_loaded\": %u, \"sample_format\": %u, "
+            "\"head_cache\": {\"hits\": %u, \"misses\": %u}, \"histograms\": {",
+            (long long)now.tv_sec, atomic_load_explicit(&playing_position, memory_order_relaxed),
+            shared_ctrl->song_id, shared_ctrl->current_chunk, shared_ctrl->chunks_loaded, shared_ctrl->sample_format,
+            atomic_load_explicit(&head_hits, memory_order_relaxed),
+            atomic_load_explicit(&head_misses, memory_order_relaxed));
+    for (size_t i = 0; i < sizeof(hists) / sizeof(hists[0]); i++) {
+        fprintf(file, "%s\n  ", i ? "," : "");
+        latency_hist_write_json(hists[i], file);
+    }
+    fprintf(file, "\n}}\n");
+    
+    if (fclose(file) != 0 || rename(tmp_path, stats_path) != 0) {
+        if (!warned) {
+            printf("⚠ No se pudo publicar %s: %s\n", stats_path, strerror(errno));
+            warned = 1;
+        }
+        unlink(tmp_path);
+    }
+}
+
+static double elapsed_ms(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) * 1000.0 + (b->tv_nsec - a->tv_nsec) / 1000000.0;
+}
+
+// Lee el contador de frames de 64 bits y su marca de tiempo de forma consistente
+int read_play_position(uint64_t *frames, uint64_t *ticks) {
+    for (int tries = 0; tries < 100; tries++) {
+        uint32_t seq = shared_ctrl->position_seq;
+        if (seq & 1) {
+            continue;
+        }
+        uint32_t frames_lo = shared_ctrl->frames_played_lo;
+        uint32_t frames_hi = shared_ctrl->frames_played_hi;
+        uint32_t ticks_lo = shared_ctrl->frames_ticks_lo;
+        uint32_t ticks_hi = shared_ctrl->frames_ticks_hi;
+        if (shared_ctrl->position_seq == seq) {
+            *frames = ((uint64_t)frames_hi << 32) | frames_lo;
+            *ticks = ((uint64_t)ticks_hi << 32) | ticks_lo;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Tasa de reproducción medida contra el reloj del Nios y contra el del HPS.
+// La diferencia con la tasa nominal es la deriva del codec respecto a cada reloj.
+void report_play_position(uint32_t loop_counter) {
+    static uint64_t last_frames = 0, last_ticks = 0;
+    static struct timespec last_wall;
+    static int have_last = 0;
+    uint64_t frames, ticks;
+    struct timespec wall;
+    
+    if (read_play_position(&frames, &ticks) != 0) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    
+    uint32_t song_sec = shared_ctrl->song_position / 4 / shared_ctrl->sample_rate;
+    printf("[%06d] Posición: %02u:%02u, %llu frames entregados\n",
+           loop_counter, song_sec / 60, song_sec % 60, (unsigned long long)frames);
+    
+    if (have_last && frames > last_frames && ticks > last_ticks && shared_ctrl->ticks_freq) {
+        double frames_delta = (double)(frames - last_frames);
+        double nios_rate = frames_delta * shared_ctrl->ticks_freq / (double)(ticks - last_ticks);
+        double hps_rate = frames_delta * 1000.0 / elapsed_ms(&last_wall, &wall);
+        double nominal = shared_ctrl->sample_rate;
+        printf("[%06d] Tasa: %.2f Hz (reloj Nios, %+.0f ppm), %.2f Hz (reloj HPS, %+.0f ppm)\n",
+               loop_counter, nios_rate, (nios_rate / nominal - 1.0) * 1e6,
+               hps_rate, (hps_rate / nominal - 1.0) * 1e6);
+    }
+    
+    last_frames = frames;
+    last_ticks = ticks;
+    last_wall = wall;
+    have_last = 1;
+}
+
+// Mide el costo de decodificar FLAC en este CPU: decodificación completa
+// en chunks (como en reproducción) y saltos aleatorios a chunks
+int bench_flac(const char *path) {
+    flac_decoder_t dec;
+    struct timespec cpu0, cpu1, wall0, wall1;
+    
+    printf("=== Benchmark FLAC: %s ===\n", path);
+    
+    if (flac_open(&dec, path, FRAMES_PER_CHUNK) != 0) {
+        printf("ERROR: No se pudo abrir FLAC: %s\n", path);
+        return 1;
+    }
+    printf("  %u Hz, %u canales, %u bits, %llu samples, %u puntos en SEEKTABLE\n",
+           dec.sample_rate, dec.channels, dec.bits_per_sample,
+           (unsigned long long)dec.total_samples, dec.num_seekpoints);
+    
+    // Decodificación secuencial
+    uint64_t decoded = 0;
+    int frames;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu0);
+    clock_gettime(CLOCK_MONOTONIC, &wall0);
+    while ((frames = flac_read_frames(&dec, staging_in, FRAMES_PER_CHUNK)) > 0) {
+        decoded += frames;
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu1);
+    clock_gettime(CLOCK_MONOTONIC, &wall1);
+    
+    if (frames < 0 || decoded == 0) {
+        printf("ERROR: Decodificación falló tras %llu samples\n", (unsigned long long)decoded);
+        flac_close(&dec);
+        return 1;
+    }
+    
+    double audio_sec = (double)decoded / dec.sample_rate;
+    double cpu_ms = elapsed_ms(&cpu0, &cpu1);
+    double wall_ms = elapsed_ms(&wall0, &wall1);
+    printf("Secuencial: %.1f s de audio\n", audio_sec);
+    printf("  CPU: %.1f ms (%.2f ms por segundo de audio, %.1fx tiempo real)\n",
+           cpu_ms, cpu_ms / audio_sec, (audio_sec * 1000.0) / cpu_ms);
+    printf("  Pared: %.1f ms (incluye lectura de archivo)\n", wall_ms);
+    printf("  Puntos de búsqueda aprendidos: %u\n", dec.num_seekpoints);
+    
+    // Saltos aleatorios a inicio de chunk + decodificación del chunk
+    uint32_t num_chunks = (dec.total_samples + FRAMES_PER_CHUNK - 1) / FRAMES_PER_CHUNK;
+    const int seeks = 100;
+    int seek_errors = 0;
+    srand(1);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu0);
+    for (int i = 0; i < seeks; i++) {
+        uint32_t chunk = rand() % num_chunks;
+        if (flac_seek(&dec, (uint64_t)chunk * FRAMES_PER_CHUNK) != 0 ||
+            flac_read_frames(&dec, staging_in, FRAMES_PER_CHUNK) <= 0) {
+            seek_errors++;
+        }
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu1);
+    printf("Búsqueda: %d saltos a chunk aleatorio, %.2f ms CPU por salto+chunk, %d errores\n",
+           seeks, elapsed_ms(&cpu0, &cpu1) / seeks, seek_errors);
+    
+    flac_close(&dec);
+    return seek_errors ? 1 : 0;
+}
+
+// --- Contenedor nativo (--transcode) ---
+// Hace offline lo que lectura y transformación hacen al reproducir: decodifica,
+// aplica ReplayGain y recorte (con las mismas opciones), convierte a la tasa
+// del codec y arma las palabras del transporte, en chunks del tamaño que
+// espera el bridge. No pasa por el limitador: a volumen unitario y con la
+// ganancia limitada por el pico no hay nada que limitar.
+_Static_assert(NATIVE_FORMAT_PCM16 == SAMPLE_FORMAT_PCM16 && NATIVE_FORMAT_PCM24 == SAMPLE_FORMAT_PCM24,
+               "formatos de .ntrk = SAMPLE_FORMAT_* del bridge");
+_Static_assert(AUDIO_CHUNK_SIZE <= sizeof(((pipeline_chunk_t *)0)->payload), "un chunk PCM16 entra en payload");
+_Static_assert(NATIVE_PCM16_CHUNK_BYTES == AUDIO_CHUNK_SIZE && NATIVE_PCM24_CHUNK_BYTES == HIRATE_SLOT_SIZE,
+               "tope de chunk .ntrk = transporte del bridge");
+
+static int32_t native_words[HIRATE_SLOT_SIZE / 4];
+static int32_t transcode_s24[HIRATE_SLOT_FRAMES * 2];
+
+int transcode_track(const char *in_path, const char *out_path) {
+    static song_info_t song;
+    analysis_record_t rec;
+    native_writer_t writer;
+    resampler_t rs;
+    struct stat st;
+    
+    printf("=== Transcodificar: %s → %s ===\n", in_path, out_path);
+    if (native_track_name(in_path) || stat(in_path, &st) != 0 || song_open_path(&song, 0, in_path) != 0) {
+        printf("ERROR: No se pudo abrir %s\n", in_path);
+        return 1;
+    }
+    
+    // Loudness del original: va a la cabecera y decide ganancia y recorte
+    if (analysis_run(in_path, &st, &rec) == 0) {
+        song_apply_record(&song, &rec);
+    } else {
+        rec.loudness = ANALYSIS_SILENT;
+        rec.peak = 0;
+        printf("⚠ No se pudo medir la loudness: sin ReplayGain ni recorte\n");
+    }
+    
+    int pcm24 = (song.transport == SAMPLE_FORMAT_PCM24);
+    int s24 = song_reads_s24(&song);
+    uint32_t out_chunk = pcm24 ? HIRATE_SLOT_FRAMES : FRAMES_PER_CHUNK;
+    uint64_t out_frames = song.total_frames * song.codec_rate / song.sample_rate + 1;
+    
+    if (native_create(&writer, out_path, pcm24 ? NATIVE_FORMAT_PCM24 : NATIVE_FORMAT_PCM16,
+                      song.codec_rate, out_chunk, (uint32_t)(out_frames / out_chunk) + 2) != 0) {
+        printf("ERROR: No se pudo crear %s\n", out_path);
+        song_close(&song);
+        return 1;
+    }
+    resampler_init(&rs, song.sample_rate, song.codec_rate);
+    
+    // Lo convertido se junta en native_words hasta completar un chunk
+    uint64_t first = 0;
+    uint32_t filled = 0;
+    int error = 0;
+    while (!error && first < song.total_frames) {
+        uint32_t read = read_song_frames(&song, first, song.src_chunk_frames, staging_in, s24 ? transcode_s24 : NULL);
+        if (read == 0) {
+            printf("ERROR: Lectura falló en el frame %llu\n", (unsigned long long)first);
+            error = 1;
+            break;
+        }
+        first += read;
+        
+        const int16_t *pcm = staging_in;
+        uint32_t frames = read;
+        if (song.codec_rate != song.sample_rate) {
+            frames = resampler_process(&rs, staging_in, read, staging_resampled, MAX_CHUNK_FRAMES);
+            pcm = staging_resampled;
+        }
+        
+        for (uint32_t done = 0; done < frames; ) {
+            uint32_t n = out_chunk - filled;
+            if (n > frames - done) {
+                n = frames - done;
             }
-            
-            if (load_chunk(current_song, current_chunk) != 0) {
-                shared_ctrl->error_flags |= 0x01;
+            if (!pcm24) {
+                memcpy((int16_t *)native_words + filled * 2, pcm + done * 2, n * 4);
+            } else {
+                for (uint32_t i = 0; i < n * 2; i++) {
+                    native_words[filled * 2 + i] = s24 ? transcode_s24[done * 2 + i] : pcm[done * 2 + i] * 256;
+                }
+            }
+            filled += n;
+            done += n;
+            if (filled == out_chunk) {
+                error = native_write_chunk(&writer, native_words, filled) != 0;
+                filled = 0;
+            }
+        }
+    }
+    if (!error && filled > 0) {
+        error = native_write_chunk(&writer, native_words, filled) != 0;
+    }
+    song_close(&song);
+    
+    if (error || native_finish(&writer, rec.loudness, rec.peak, song.gain) != 0) {
+        if (error) {
+            native_abort(&writer);
+        }
+        printf("ERROR: No se pudo escribir %s\n", out_path);
+        return 1;
+    }
+    printf("✓ %s: %u chunks de %u frames (%s a %u Hz), %.1f MB\n", out_path, writer.header.num_chunks,
+           out_chunk, pcm24 ? "PCM24" : "PCM16", song.codec_rate,
+           writer.offset / 1024.0 / 1024.0);
+    return 0;
+}
+
+// --- Grabación de line-in ---
+
+static volatile sig_atomic_t record_stop_requested = 0;
+static uint32_t record_buffer[RECORD_RING_FRAMES];
+
+static void record_signal(int sig) {
+    (void)sig;
+    record_stop_requested = 1;
+}
+
+// Espera a que el Nios consuma el comando y reporte 'status'
+static int send_record_command(uint32_t command, uint32_t status) {
+    shared_ctrl->command = command;
+    for (int i = 0; i < 200; i++) {
+        if (shared_ctrl->command == CMD_NONE && shared_ctrl->status == status) {
+            return 0;
+        }
+        usleep(10000);
+    }
+    return -1;
+}
+
+// Copia al WAV todo lo que el Nios dejó en el ring desde la última lectura
+static int drain_record_ring(wav_writer_t *wav, uint32_t *read_frames) {
+    uint32_t available = shared_ctrl->rec_write_frames - *read_frames;
+    uint32_t pos = *read_frames % RECORD_RING_FRAMES;
+    
+    if (available > RECORD_RING_FRAMES) {
+        printf("ERROR: Ring de grabación inconsistente (%u frames pendientes)\n", available);
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < available; i++) {
+        record_buffer[i] = shared_record_ring[pos];
+        if (++pos == RECORD_RING_FRAMES) {
+            pos = 0;
+        }
+    }
+    
+    // Liberar el ring antes de tocar la SD: la escritura puede bloquear
+    *read_frames += available;
+    shared_ctrl->rec_read_frames = *read_frames;
+    
+    return available ? wav_writer_write(wav, (const int16_t *)record_buffer, available) : 0;
+}
+
+// Graba line-in a 'path' hasta 'seconds' (0 = hasta Ctrl+C)
+int record_line_in(const char *path, uint32_t seconds) {
+    wav_writer_t wav;
+    uint32_t read_frames = 0;
+    int result = 0;
+    
+    printf("=== Grabación de line-in: %s ===\n", path);
+    
+    if (map_shared_memory() != 0) {
+        printf("FATAL: Falló mapeo de memoria\n");
+        return 1;
+    }
+    
+    shared_ctrl->hps_connected = 1;
+    shared_ctrl->sample_rate = 48000;
+    shared_ctrl->channels = 2;
+    shared_ctrl->status = STATUS_READY;
+    
+    if (wav_writer_open(&wav, path, shared_ctrl->sample_rate, shared_ctrl->channels) != 0) {
+        return 1;
+    }
+    
+    signal(SIGINT, record_signal);
+    signal(SIGTERM, record_signal);
+    
+    if (send_record_command(CMD_RECORD, STATUS_RECORDING) != 0) {
+        printf("ERROR: El Nios no respondió a CMD_RECORD\n");
+        shared_ctrl->hps_connected = 0;
+        wav_writer_close(&wav);
+        return 1;
+    }
+    printf("✓ Grabando (Ctrl+C para detener)\n");
+    
+    uint64_t target_frames = (uint64_t)seconds * shared_ctrl->sample_rate;
+    uint32_t loop_counter = 0;
+    
+    while (!record_stop_requested && (seconds == 0 || wav.total_frames < target_frames)) {
+        shared_ctrl->hps_connected = 1;
+        
+        if (drain_record_ring(&wav, &read_frames) != 0) {
+            result = 1;
+            break;
+        }
+        
+        // Progreso cada segundo
+        if ((++loop_counter % (1000000 / RECORD_POLL_US)) == 0) {
+            uint32_t used = shared_ctrl->rec_write_frames - read_frames;
+            printf("[%5.1f s] Ring %3u%%, perdidos: %u frames, FIFO lleno: %u\n",
+                   (double)wav.total_frames / shared_ctrl->sample_rate,
+                   used * 100 / RECORD_RING_FRAMES, shared_ctrl->rec_dropped,
+                   shared_ctrl->rec_fifo_full);
+        }
+        
+        usleep(RECORD_POLL_US);
+    }
+    
+    if (send_record_command(CMD_RECORD_STOP, STATUS_READY) != 0) {
+        printf("⚠ El Nios no confirmó CMD_RECORD_STOP\n");
+    }
+    if (result == 0 && drain_record_ring(&wav, &read_frames) != 0) {
+        result = 1;
+    }
+    
+    uint32_t dropped = shared_ctrl->rec_dropped;
+    uint32_t fifo_full = shared_ctrl->rec_fifo_full;
+    shared_ctrl->hps_connected = 0;
+    
+    if (wav_writer_close(&wav) != 0) {
+        result = 1;
+    }
+    
+    printf("Grabados %llu frames (%.1f s), %u perdidos por ring lleno, %u lecturas con FIFO lleno\n",
+           (unsigned long long)wav.total_frames, (double)wav.total_frames / shared_ctrl->sample_rate,
+           dropped, fifo_full);
+    if (dropped == 0 && fifo_full == 0) {
+        printf("✓ Grabación sin pérdidas\n");
+    } else {
+        printf("⚠ Grabación con posibles pérdidas\n");
+    }
+    
+    munmap(virtual_base, HW_REGS_SPAN);
+    close(fd);
+    return result;
+}
+
+// --- Medición de latencia ---
+
+// El Nios emite pulsos y los detecta en line-in (cable de loopback). Aquí se
+// mide además cuánto tarda el Nios en tomar el comando, para acotar la
+// latencia comando → sonido.
+int measure_latency() {
+    struct timespec t_cmd, t_ack, now;
+    
+    printf("=== Latencia de audio (loopback salida → line-in) ===\n");
+    
+    if (map_shared_memory() != 0) {
+        printf("FATAL: Falló mapeo de memoria\n");
+        return 1;
+    }
+    shared_ctrl->hps_connected = 1;
+    shared_ctrl->sample_rate = 48000;
+    shared_ctrl->channels = 2;
+    
+    // Esperar a que el Nios vea al HPS conectado (su loop lo detecta por polling)
+    usleep(100000);
+    
+    // Espera activa: la resolución del ack es la de clock_gettime, no la de usleep
+    clock_gettime(CLOCK_MONOTONIC, &t_cmd);
+    shared_ctrl->command = CMD_LATENCY;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t_ack);
+        if (elapsed_ms(&t_cmd, &t_ack) > 2000) {
+            printf("ERROR: El Nios no respondió a CMD_LATENCY\n");
+            shared_ctrl->command = CMD_NONE;
+            shared_ctrl->hps_connected = 0;
+            return 1;
+        }
+    } while (shared_ctrl->command != CMD_NONE);
+    
+    do {
+        usleep(10000);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while (shared_ctrl->status == STATUS_MEASURING && elapsed_ms(&t_cmd, &now) < 30000);
+    
+    uint32_t pulses = shared_ctrl->lat_pulses;
+    uint32_t timeouts = shared_ctrl->lat_timeouts;
+    double rate = shared_ctrl->sample_rate;
+    double freq = shared_ctrl->ticks_freq ? shared_ctrl->ticks_freq : 50000000;
+    shared_ctrl->hps_connected = 0;
+    
+    if (pulses == 0) {
+        printf("ERROR: Ningún pulso detectado (%u perdidos). ¿Está el cable de loopback?\n", timeouts);
+        return 1;
+    }
+    
+    double avg = (double)shared_ctrl->lat_sum / pulses;
+    double queue = (double)shared_ctrl->lat_queue_sum / (pulses + timeouts);
+    double first = shared_ctrl->lat_first;
+    double pickup_ms = elapsed_ms(&t_cmd, &t_ack);
+    double nios_ms = shared_ctrl->lat_cmd_ticks * 1000.0 / freq;
+    
+    printf("Pulsos: %u detectados, %u perdidos\n", pulses, timeouts);
+    printf("Ida y vuelta:  min %u, prom %.1f, max %u frames (%.2f / %.2f / %.2f ms)\n",
+           shared_ctrl->lat_min, avg, shared_ctrl->lat_max,
+           shared_ctrl->lat_min * 1000.0 / rate, avg * 1000.0 / rate,
+           shared_ctrl->lat_max * 1000.0 / rate);
+    printf("  FIFO de salida: %.1f frames (%.2f ms) en promedio\n", queue, queue * 1000.0 / rate);
+    printf("  DAC + cable + ADC: %.1f frames (%.2f ms)\n", avg - queue, (avg - queue) * 1000.0 / rate);
+    printf("Comando → sonido:\n");
+    printf("  HPS → Nios (ack observado): %.3f ms\n", pickup_ms);
+    printf("  Nios → primer pulso en el FIFO: %.3f ms\n", nios_ms);
+    printf("  Primer pulso (FIFO vacío) hasta line-in: %.0f frames (%.2f ms)\n", first, first * 1000.0 / rate);
+    printf("  Total: <= %.2f ms (cota: el último tramo incluye el ADC)\n",
+           pickup_ms + nios_ms + first * 1000.0 / rate);
+    
+    munmap(virtual_base, HW_REGS_SPAN);
+    close(fd);
+    return timeouts ? 1 : 0;
+}
+
+// --- Vigilancia de SONGS_DIR (control) ---
+static dir_watch_t songs_watch = { -1, -1 };
+
+// Eventos perdidos: revisar qué pistas del directorio siguen y cuáles faltan
+static void rescan_songs_dir(void) {
+    uint32_t count = playlist.count;
+    
+    printf("⚠ Se perdieron eventos de " SONGS_DIR ": revisando el directorio\n");
+    for (uint32_t i = 0; i < count; i++) {
+        if (strncmp(playlist.paths[i], SONGS_DIR "/", strlen(SONGS_DIR) + 1) == 0) {
+            playlist_set_removed(&playlist, i, access(playlist.paths[i], R_OK) != 0);
+        }
+    }
+    if (playlist_from_dir && scan_songs_dir(1) > 0) {
+        printf("✓ Playlist: %u pistas\n", playlist.count);
+    }
+    atomic_store(&changed_overflow, 1);
+    atomic_store(&analysis_cursor, 0);
+}
+
+static void on_songs_dir_event(int kind, const char *name, void *ctx) {
+    char path[512];
+    (void)ctx;
+    
+    if (kind == DIR_WATCH_GONE) {
+        printf("⚠ " SONGS_DIR " ya no está: se deja de vigilar\n");
+        return;
+    }
+    if (kind == DIR_WATCH_OVERFLOW) {
+        rescan_songs_dir();
+        return;
+    }
+    if (!is_song_name(name)) {
+        return;
+    }
+    
+    snprintf(path, sizeof(path), SONGS_DIR "/%s", name);
+    int track = playlist_find(&playlist, path);
+    
+    if (kind == DIR_WATCH_REMOVED) {
+        if (track >= 0 && !playlist_removed(&playlist, track)) {
+            playlist_set_removed(&playlist, track, 1);
+            notify_track_changed(track);
+            printf("Quitada: %s (pista %d)\n", path, track + 1);
+        }
+        return;
+    }
+    
+    if (track >= 0) {
+        playlist_set_removed(&playlist, track, 0);
+        notify_track_changed(track);
+        printf("Reemplazada: %s (pista %d)\n", path, track + 1);
+        return;
+    }
+    
+    // Con M3U la lista decide qué pistas hay
+    if (!playlist_from_dir) {
+        return;
+    }
+    uint32_t before = playlist.count;
+    track = playlist_append(&playlist, path);
+    if (track < 0) {
+        printf("⚠ Playlist llena, no se agrega: %s\n", path);
+        return;
+    }
+    notify_track_changed(track);
+    printf("Agregada: %s (pista %d/%u)\n", path, track + 1, playlist.count);
+    if (before == 0) {
+        request_stream(0, 0);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // Modo benchmark: no necesita root ni el bridge
+    if (argc == 3 && strcmp(argv[1], "--bench-flac") == 0) {
+        return bench_flac(argv[2]);
+    }
+    
+    // Contenedor nativo: tampoco toca el bridge (se puede correr en otra máquina)
+    if (argc >= 4 && strcmp(argv[1], "--transcode") == 0) {
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--replaygain") == 0) {
+                replaygain_mode = 1;
+            } else if (strcmp(argv[i], "--trim-silence") == 0) {
+                trim_silence_mode = 1;
+            } else {
+                printf("Uso: %s --transcode <entrada> <salida" NATIVE_EXTENSION "> [--replaygain] [--trim-silence]\n",
+                       argv[0]);
+                return 1;
+            }
+        }
+        return transcode_track(argv[2], argv[3]);
+    }
+    
+    // Modos de perfil: solo leen/limpian sus áreas, el reproductor sigue
+    if (argc >= 2 && (strcmp(argv[1], "--profile") == 0 || strcmp(argv[1], "--profile-reset") == 0 ||
+                      strcmp(argv[1], "--isr-stats") == 0 || strcmp(argv[1], "--isr-stats-reset") == 0)) {
+        if (getuid() != 0 && !getenv("FPGA_AUDIO_EMU")) {
+            printf("ERROR: Ejecutar como root (sudo)\n");
+            return 1;
+        }
+        if (map_bridge() != 0) {
+            return 1;
+        }
+        int result = 0;
+        if (strcmp(argv[1], "--profile") == 0) {
+            result = profile_dump(shared_profile, argc >= 3 ? argv[2] : NULL);
+        } else if (strcmp(argv[1], "--profile-reset") == 0) {
+            profile_reset(shared_profile);
+            printf("✓ Perfil reiniciado\n");
+        } else if (strcmp(argv[1], "--isr-stats") == 0) {
+            result = isr_stats_dump(shared_isr_stats);
+        } else {
+            isr_stats_reset(shared_isr_stats);
+            printf("✓ Reinicio de estadísticas ISR solicitado al Nios\n");
+        }
+        munmap(virtual_base, HW_REGS_SPAN);
+        close(fd);
+        return result ? 1 : 0;
+    }
+    
+    // Grabación: el Nios captura line-in al ring y aquí se escribe el WAV
+    if (argc >= 3 && strcmp(argv[1], "--record") == 0) {
+        if (getuid() != 0 && !getenv("FPGA_AUDIO_EMU")) {
+            printf("ERROR: Ejecutar como root (sudo)\n");
+            return 1;
+        }
+        return record_line_in(argv[2], argc >= 4 ? (uint32_t)atoi(argv[3]) : 0);
+    }
+    
+    if (argc == 2 && strcmp(argv[1], "--latency") == 0) {
+        if (getuid() != 0 && !getenv("FPGA_AUDIO_EMU")) {
+            printf("ERROR: Ejecutar como root (sudo)\n");
+            return 1;
+        }
+        return measure_latency();
+    }
+    
+    const char *playlist_path = NULL;
+    int shuffle = 0;
+    int repeat = PLAYLIST_REPEAT_ALL;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--adpcm") == 0) {
+            sample_format = SAMPLE_FORMAT_ADPCM;
+            chunk_frames = ADPCM_FRAMES_PER_CHUNK;
+        } else if (strcmp(argv[i], "--pin") == 0 && i + 1 < argc &&
+                   sscanf(argv[i + 1], "%d,%d,%d,%d", &stages[STAGE_READER].cpu,
+                          &stages[STAGE_TRANSFORM].cpu, &stages[STAGE_WRITER].cpu, &control_cpu) == 4) {
+            pin_requested = 1;
+            i++;
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            realtime_mode = 1;
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (strcmp(argv[i], "--playlist") == 0 && i + 1 < argc) {
+            playlist_path = argv[++i];
+        } else if (strcmp(argv[i], "--library") == 0 && i + 1 < argc) {
+            library_path = argv[++i];
+        } else if (strcmp(argv[i], "--analysis") == 0 && i + 1 < argc) {
+            analysis_path = argv[++i];
+        } else if (strcmp(argv[i], "--replaygain") == 0) {
+            replaygain_mode = 1;
+        } else if (strcmp(argv[i], "--trim-silence") == 0) {
+            trim_silence_mode = 1;
+        } else if (strcmp(argv[i], "--ingest") == 0 && i + 1 < argc) {
+            ingest_spec = argv[++i];
+        } else if (strcmp(argv[i], "--ingest-rate") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            ingest_rate = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve_mode = 1;
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            serve_path = argv[++i];
+        } else if (strcmp(argv[i], "--crossfade") == 0 && i + 1 < argc && atof(argv[i + 1]) >= 0) {
+            double ms = atof(argv[++i]) * 1000.0;
+            crossfade_ms = (ms > CROSSFADE_MAX_MS) ? CROSSFADE_MAX_MS : (uint32_t)ms;
+        } else if (strcmp(argv[i], "--shuffle") == 0) {
+            shuffle = 1;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc &&
+                   (strcmp(argv[i + 1], "none") == 0 || strcmp(argv[i + 1], "all") == 0 ||
+                    strcmp(argv[i + 1], "one") == 0)) {
+            i++;
+            repeat = (argv[i][0] == 'n') ? PLAYLIST_REPEAT_NONE :
+                     (argv[i][0] == 'o') ? PLAYLIST_REPEAT_ONE : PLAYLIST_REPEAT_ALL;
+        } else {
+            printf("Uso: %s [--adpcm] [--realtime] [--pin lectura,transformación,escritura,control]\n", argv[0]);
+            printf("       %s [--stats <archivo.json>]  (por defecto %s)\n", argv[0], STATS_PATH_DEFAULT);
+            printf("       %s [--playlist <lista.m3u>] [--shuffle] [--repeat none|all|one]\n", argv[0]);
+            printf("       %s [--library <índice>]  (por defecto %s)\n", argv[0], LIBRARY_INDEX_DEFAULT);
+            printf("       %s [--analysis <base>] [--replaygain] [--trim-silence]  (por defecto %s)\n",
+                   argv[0], ANALYSIS_DB_DEFAULT);
+            printf("       %s [--crossfade <segundos>]  (0 a %d)\n", argv[0], CROSSFADE_MAX_MS / 1000);
+            printf("       %s --ingest -|<fifo>|unix:<socket> [--ingest-rate <Hz>]  (WAV o PCM s16le estéreo)\n", argv[0]);
+            printf("       %s --serve [--socket <ruta>]  (clientes de libfpgaaudio, por defecto %s)\n",
+                   argv[0], FPGA_AUDIO_SOCKET_DEFAULT);
+            printf("       %s --bench-flac <archivo.flac>\n", argv[0]);
+            printf("       %s --transcode <entrada> <salida" NATIVE_EXTENSION "> [--replaygain] [--trim-silence]\n",
+                   argv[0]);
+            printf("       %s --profile [firmware.objdump|firmware.elf] | --profile-reset\n", argv[0]);
+            printf("       %s --isr-stats | --isr-stats-reset\n", argv[0]);
+            printf("       %s --record <archivo.wav> [segundos] | --latency\n", argv[0]);
+            return 1;
+        }
+    }
+    
+    printf("=== HPS Audio Loader - 128 KB Optimizado ===\n");
+    printf("Memoria: 0x%08x - 0x%08x (128 KB)\n", 
+           SHARED_MEMORY_OFFSET, SHARED_MEMORY_OFFSET + MEMORY_SIZE - 1);
+    printf("Chunks de audio: %d KB (%s, %u frames)\n", AUDIO_CHUNK_SIZE/1024,
+           sample_format == SAMPLE_FORMAT_ADPCM ? "IMA-ADPCM 4:1" : "PCM 16 bits", chunk_frames);
+    printf("Estructura: %zu bytes\n", sizeof(compact_shared_control_t));
+    printf("Usuario: %s\n", getenv("USER") ? getenv("USER") : "unknown");
+    printf("Compilado: %s %s\n\n", __DATE__, __TIME__);
+    
+    if (getuid() != 0 && !getenv("FPGA_AUDIO_EMU")) {
+        printf("ERROR: Ejecutar como root (sudo)\n");
+        return 1;
+    }
+    
+    signal(SIGINT, cleanup_and_exit);
+    signal(SIGTERM, cleanup_and_exit);
+    
+    if (realtime_mode) {
+        realtime_setup();
+    }
+    
+    // Mapear memoria
+    if (map_shared_memory() != 0) {
+        printf("FATAL: Falló mapeo de memoria\n");
+        return 1;
+    }
+    
+    // Cargar la playlist (los archivos se abren al reproducirlos)
+    if (ingest_spec) {
+        if (ingest_open(&ingest, ingest_spec, ingest_rate, MAX_CHUNK_FRAMES) != 0) {
+            printf("FATAL: No se pudo abrir la ingesta %s: %s\n", ingest_spec, strerror(errno));
+            return 1;
+        }
+        printf("✓ Ingesta desde %s (PCM crudo a %u Hz si no llega cabecera WAV)\n", ingest.path, ingest_rate);
+    } else if (serve_mode) {
+        if (audio_server_open(&server, serve_path) != 0) {
+            printf("FATAL: No se pudo escuchar en %s: %s\n", serve_path, strerror(errno));
+            return 1;
+        }
+        printf("✓ Esperando clientes de libfpgaaudio en %s (hasta %d mezclados)\n", serve_path,
+               FPGA_AUDIO_MAX_CLIENTS);
+    } else if (load_playlist(playlist_path, shuffle, repeat) != 0) {
+        printf("ADVERTENCIA: Sin canciones, modo test\n");
+    } else if (crossfade_ms > 0) {
+        printf("✓ Crossfade: %u ms (equal-power)\n", crossfade_ms);
+    }
+    // Antes de fijar la afinidad de control: los hilos de análisis la heredan
+    if (!ingest_spec && !serve_mode) {
+        analysis_start();
+    }
+    
+    // Inicializar sistema
+    printf("=== Inicializando Sistema ===\n");
+    
+    shared_ctrl->magic = 0xABCD2025;
+    shared_ctrl->command = CMD_NONE;
+    shared_ctrl->status = STATUS_READY;
+    shared_ctrl->song_id = 0;
+    shared_ctrl->hps_connected = 1;
+    shared_ctrl->sample_rate = 48000;
+    shared_ctrl->channels = 2;
+    shared_ctrl->error_flags = 0;
+    shared_ctrl->chunks_loaded = 0;
+    shared_ctrl->bytes_played = 0;
+    shared_ctrl->volume = VOLUME_DEFAULT;
+    shared_ctrl->limiter_gain = LIMITER_UNITY_GAIN;
+    shared_ctrl->sample_format = sample_format;
+    limiter_init(&limiter, VOLUME_DEFAULT);
+    adpcm_reset(adpcm_state);
+    
+    if (realtime_mode) {
+        jitter_self_test();
+    }
+    
+    if (pipeline_start() != 0) {
+        printf("FATAL: No se pudo arrancar el pipeline de carga\n");
+        return 1;
+    }
+    
+    if (ingest_spec || serve_mode) {
+        request_stream(0, 0);
+    } else if (playlist.count > 0) {
+        request_stream(0, 0);
+        for (int i = 0; i < 100 && !shared_ctrl->chunk_ready; i++) {
+            usleep(10000);
+        }
+        if (shared_ctrl->chunk_ready) {
+            printf("✓ Primer chunk cargado\n");
+        }
+    }
+    
+    // Con ingesta o clientes no hay playlist que vigilar
+    if (!ingest_spec && !serve_mode) {
+        if (dir_watch_open(&songs_watch, SONGS_DIR) == 0) {
+            printf("✓ Vigilando " SONGS_DIR " (inotify)\n");
+        } else {
+            printf("⚠ Sin inotify en " SONGS_DIR ": los cambios se ven al reiniciar\n");
+        }
+    }
+    
+    printf("\n=== Estado Inicial ===\n");
+    printf("Magic: 0x%08x\n", shared_ctrl->magic);
+    printf("HPS Conectado: %d\n", shared_ctrl->hps_connected);
+    printf("Canción: %d, Chunks: %d\n", shared_ctrl->song_id, shared_ctrl->total_chunks);
+    printf("Chunk listo: %d (%d bytes)\n", shared_ctrl->chunk_ready, shared_ctrl->chunk_size);
+    
+    printf("\n=== Loop Principal ===\n");
+    printf("Esperando FPGA...\n");
+    printf("Controles: KEY0=Play/Pause, KEY1=Siguiente, KEY2=Anterior\n\n");
+    
+    uint32_t loop_counter = 0;
+    uint32_t last_heartbeat = 0;
+    int selected = 0;           // Posición del último pedido (escritura la confirma en playing_position)
+    int shown = -1;
+    
+    while (1) {
+        shared_ctrl->hps_connected = 1;
+        dir_watch_poll(&songs_watch, on_songs_dir_event, NULL);
+        
+        // Heartbeat
+        if (shared_ctrl->fpga_heartbeat != last_heartbeat) {
+            printf("[%06d] FPGA activo: %u\n", loop_counter, shared_ctrl->fpga_heartbeat);
+            last_heartbeat = shared_ctrl->fpga_heartbeat;
+        }
+        
+        // Pista nueva en el bridge (comando o fin de la anterior)
+        int playing = atomic_load_explicit(&playing_position, memory_order_acquire);
+        if (playing >= 0 && playing != shown) {
+            printf("[%06d] Pista %u (%d/%u): %s, %u chunks a %u Hz%s\n", loop_counter,
+                   shared_ctrl->song_id + 1, playing + 1, playlist.count,
+                   playlist.paths[playlist_track(&playlist, playing)],
+                   shared_ctrl->total_chunks, shared_ctrl->sample_rate,
+                   shared_ctrl->sample_format == SAMPLE_FORMAT_PCM24 ? " (PCM24)" : "");
+            shown = playing;
+            selected = playing;
+        }
+        
+        // El Nios no sostuvo 96 kHz: seguir la canción convertida a 48 kHz.
+        // Lectura recalcula el transporte de cada pista al empezarla.
+        if (shared_ctrl->hirate_fallback && !atomic_load(&hirate_disabled)) {
+            printf("⚠ [%06d] El Nios no sostiene %d Hz (%u ciclos/frame, %u underruns): se pasa a %d Hz\n",
+                   loop_counter, HIRATE_RATE, shared_ctrl->hirate_cycles,
+                   shared_ctrl->hirate_underruns, CODEC_DEFAULT_RATE);
+            atomic_store(&hirate_disabled, 1);
+            if (shared_ctrl->sample_format == SAMPLE_FORMAT_PCM24) {
+                // song_position cuenta frames a 96 kHz, es decir frames del archivo
+                request_stream(selected, shared_ctrl->song_position / 4);
             }
         }
         
@@ -391,36 +3289,26 @@ int main() {
             case CMD_NEXT:
                 if (shared_ctrl->command != CMD_NONE) {
                     printf("[%06d] Comando: SIGUIENTE\n", loop_counter);
-                    current_song = (current_song + 1) % MAX_TRACKS;
-                    while (!songs[current_song].file_handle && current_song < MAX_TRACKS) current_song++;
-                    if (current_song >= MAX_TRACKS) current_song = 0;
-                    
-                    current_chunk = 0;
-                    shared_ctrl->song_id = current_song;
-                    shared_ctrl->total_chunks = songs[current_song].num_chunks;
-                    shared_ctrl->song_total_size = songs[current_song].file_size;
-                    shared_ctrl->duration_sec = songs[current_song].duration_sec;
-                    load_chunk(current_song, current_chunk);
+                    if (playlist.count > 0) {
+                        int from = selected;
+                        selected = playlist_next(&playlist, selected);
+                        request_skip(selected, from, playing);
+                        printf("Cambiado a posición %d/%u\n", selected + 1, playlist.count);
+                    }
                     shared_ctrl->command = CMD_NONE;
-                    printf("Cambiado a canción %d\n", current_song + 1);
                 }
                 break;
                 
             case CMD_PREV:
                 if (shared_ctrl->command != CMD_NONE) {
                     printf("[%06d] Comando: ANTERIOR\n", loop_counter);
-                    current_song = (current_song - 1 + MAX_TRACKS) % MAX_TRACKS;
-                    while (!songs[current_song].file_handle && current_song >= 0) current_song--;
-                    if (current_song < 0) current_song = MAX_TRACKS - 1;
-                    
-                    current_chunk = 0;
-                    shared_ctrl->song_id = current_song;
-                    shared_ctrl->total_chunks = songs[current_song].num_chunks;
-                    shared_ctrl->song_total_size = songs[current_song].file_size;
-                    shared_ctrl->duration_sec = songs[current_song].duration_sec;
-                    load_chunk(current_song, current_chunk);
+                    if (playlist.count > 0) {
+                        int from = selected;
+                        selected = playlist_prev(&playlist, selected);
+                        request_skip(selected, from, playing);
+                        printf("Cambiado a posición %d/%u\n", selected + 1, playlist.count);
+                    }
                     shared_ctrl->command = CMD_NONE;
-                    printf("Cambiado a canción %d\n", current_song + 1);
                 }
                 break;
                 
@@ -440,12 +3328,26 @@ int main() {
                 }
                 break;
                 
+            case CMD_VOLUME:
+                if (shared_ctrl->command != CMD_NONE) {
+                    uint32_t volume = shared_ctrl->volume;
+                    if (volume > VOLUME_MAX) {
+                        volume = VOLUME_MAX;
+                        shared_ctrl->volume = volume;
+                    }
+                    printf("[%06d] Comando: VOLUMEN %u%%\n", loop_counter, volume);
+                    atomic_store_explicit(&pipeline_volume, volume, memory_order_relaxed);
+                    shared_ctrl->command = CMD_NONE;
+                }
+                break;
+                
             case CMD_STOP:
                 if (shared_ctrl->command != CMD_NONE) {
                     printf("[%06d] Comando: STOP\n", loop_counter);
                     shared_ctrl->status = STATUS_READY;
-                    current_chunk = 0;
-                    load_chunk(current_song, current_chunk);
+                    if (playlist.count > 0) {
+                        request_stream(selected, 0);
+                    }
                     shared_ctrl->command = CMD_NONE;
                 }
                 break;
@@ -453,11 +3355,29 @@ int main() {
         
         // Status cada 5 segundos
         if ((loop_counter % 500) == 0 && loop_counter > 0) {
-            printf("[%06d] Estado: Cmd=%d, Status=%d, Canción=%d, Chunk=%d/%d (%d%%), Listo=%d\n",
+            printf("[%06d] Estado: Cmd=%d, Status=%d, Canción=%d, Chunk=%d/%d (%d%%), Listo=%d, Vol=%d%% (lim %d)\n",
                    loop_counter, shared_ctrl->command, shared_ctrl->status,
                    shared_ctrl->song_id, shared_ctrl->current_chunk + 1, 
                    shared_ctrl->total_chunks, shared_ctrl->buffer_level,
-                   shared_ctrl->chunk_ready);
+                   shared_ctrl->chunk_ready, shared_ctrl->volume, shared_ctrl->limiter_gain);
+            if (sample_format == SAMPLE_FORMAT_ADPCM) {
+                // Presupuesto: 50 MHz / 48 kHz = 1041 ciclos por frame para todo el Nios
+                printf("[%06d] ADPCM Nios: %u ciclos/frame promedio, %u peor lote (presupuesto %u)\n",
+                       loop_counter, shared_ctrl->decode_cycles, shared_ctrl->decode_cycles_max,
+                       50000000 / shared_ctrl->sample_rate);
+            }
+            if (shared_ctrl->sample_format == SAMPLE_FORMAT_PCM24) {
+                // Presupuesto del camino PCM24: media frame a 96 kHz (el resto para ISRs y loop)
+                printf("[%06d] PCM24 Nios: %u ciclos/frame promedio, %u lote más largo (presupuesto %u), %u underruns\n",
+                       loop_counter, shared_ctrl->hirate_cycles, shared_ctrl->hirate_cycles_max,
+                       50000000 / HIRATE_RATE / 2, shared_ctrl->hirate_underruns);
+            }
+            report_play_position(loop_counter);
+            report_pipeline(loop_counter);
+        }
+        
+        if ((loop_counter % STATS_PERIOD_LOOPS) == 0 && loop_counter > 0) {
+            write_stats_file();
         }
         
         loop_counter++;
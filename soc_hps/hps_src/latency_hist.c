@@ -0,0 +1,85 @@
+#include "latency_hist.h"
+
+static uint32_t bucket_index(uint32_t value) {
+    uint32_t shift = 0;
+
+    if (value >= 2 * LATENCY_SUB_BUCKETS) {
+        shift = (31 - __builtin_clz(value)) - LATENCY_SUB_BITS;
+    }
+    return shift * LATENCY_SUB_BUCKETS + (value >> shift);
+}
+
+static uint32_t bucket_lower(uint32_t index) {
+    uint32_t shift = (index < 2 * LATENCY_SUB_BUCKETS) ? 0 : index / LATENCY_SUB_BUCKETS - 1;
+    return (index - shift * LATENCY_SUB_BUCKETS) << shift;
+}
+
+static uint32_t bucket_upper(uint32_t index) {
+    uint32_t shift = (index < 2 * LATENCY_SUB_BUCKETS) ? 0 : index / LATENCY_SUB_BUCKETS - 1;
+    return bucket_lower(index) + ((1u << shift) - 1);
+}
+
+void latency_hist_init(latency_hist_t *hist, const char *name) {
+    hist->name = name;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        atomic_init(&hist->counts[i], 0);
+    }
+    atomic_init(&hist->count, 0);
+    atomic_init(&hist->max, 0);
+    atomic_init(&hist->sum, 0);
+}
+
+// Un solo escritor por histograma: alcanzan operaciones relajadas
+void latency_hist_record(latency_hist_t *hist, uint32_t value_us) {
+    atomic_fetch_add_explicit(&hist->counts[bucket_index(value_us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->sum, value_us, memory_order_relaxed);
+    if (value_us > atomic_load_explicit(&hist->max, memory_order_relaxed)) {
+        atomic_store_explicit(&hist->max, value_us, memory_order_relaxed);
+    }
+}
+
+uint32_t latency_hist_percentile(latency_hist_t *hist, double pct) {
+    uint32_t count = atomic_load_explicit(&hist->count, memory_order_relaxed);
+    uint32_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    uint64_t target = (uint64_t)(count * pct / 100.0 + 0.999999);
+    uint64_t seen = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+    if (target == 0) {
+        target = 1;
+    }
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += atomic_load_explicit(&hist->counts[i], memory_order_relaxed);
+        if (seen >= target) {
+            // La cota del bucket nunca puede superar el máximo observado
+            uint32_t upper = bucket_upper(i);
+            return (upper > max) ? max : upper;
+        }
+    }
+    return max;
+}
+
+void latency_hist_write_json(latency_hist_t *hist, FILE *file) {
+    uint32_t count = atomic_load_explicit(&hist->count, memory_order_relaxed);
+    uint64_t sum = atomic_load_explicit(&hist->sum, memory_order_relaxed);
+    int first = 1;
+
+    fprintf(file, "\"%s\": {\"count\": %u, \"mean\": %.1f, \"max\": %u, "
+            "\"p50\": %u, \"p90\": %u, \"p99\": %u, \"p999\": %u, \"buckets\": [",
+            hist->name, count, count ? (double)sum / count : 0.0,
+            atomic_load_explicit(&hist->max, memory_order_relaxed),
+            latency_hist_percentile(hist, 50), latency_hist_percentile(hist, 90),
+            latency_hist_percentile(hist, 99), latency_hist_percentile(hist, 99.9));
+
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+        uint32_t n = atomic_load_explicit(&hist->counts[i], memory_order_relaxed);
+        if (n) {
+            fprintf(file, "%s[%u, %u, %u]", first ? "" : ", ", bucket_lower(i), bucket_upper(i), n);
+            first = 0;
+        }
+    }
+    fprintf(file, "]}");
+}
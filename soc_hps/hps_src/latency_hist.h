@@ -0,0 +1,38 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Histogramas de latencia estilo HDR en microsegundos: log2 con 16
+// sub-buckets lineales por potencia de 2, así el error relativo de un
+// percentil queda por debajo del 6.25% en todo el rango (0 us a ~71 min).
+// Un solo hilo registra en cada histograma; cualquiera puede leerlo.
+//
+// Índice de v: shift = max(0, log2(v) - 4), índice = shift * 16 + (v >> shift).
+// v < 32 cae en un bucket exacto.
+
+#define LATENCY_SUB_BITS      4
+#define LATENCY_SUB_BUCKETS   (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS       ((32 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)   // 464
+
+typedef struct {
+    const char *name;                   // Clave en el JSON
+    _Atomic uint32_t counts[LATENCY_BUCKETS];
+    _Atomic uint32_t count;
+    _Atomic uint32_t max;
+    _Atomic uint64_t sum;
+} latency_hist_t;
+
+void latency_hist_init(latency_hist_t *hist, const char *name);
+void latency_hist_record(latency_hist_t *hist, uint32_t value_us);
+
+// Cota superior del bucket donde cae el percentil 'pct' (0-100), 0 sin muestras
+uint32_t latency_hist_percentile(latency_hist_t *hist, double pct);
+
+// "nombre": { count, mean, max, p50, p90, p99, p999, buckets: [[desde, hasta, n], ...] }
+// Solo buckets no vacíos; 'hasta' es inclusivo
+void latency_hist_write_json(latency_hist_t *hist, FILE *file);
+
+#endif /* LATENCY_HIST_H */
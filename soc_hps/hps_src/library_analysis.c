@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <math.h>
+#include "library_analysis.h"
+#include "audio_dsp.h"
+#include "flac_decoder.h"
+#include "wav_reader.h"
+
+#define ANALYSIS_BUFFER_FRAMES  4096
+#define ANALYSIS_SEGMENT_FRAMES 64          // Resolución de la búsqueda de silencio
+#define ANALYSIS_GAIN_MAX       16384       // +12 dB (Q12), como VOLUME_MAX
+
+// --- Base de resultados ---
+
+// Pocas pistas (cientos) y una búsqueda por apertura: alcanza con recorrerla
+static analysis_record_t *db_lookup(analysis_db_t *db, const char *path) {
+    for (uint32_t i = 0; i < db->count; i++) {
+        if (strcmp(db->records[i].path, path) == 0) {
+            return &db->records[i];
+        }
+    }
+    return NULL;
+}
+
+int analysis_db_open(analysis_db_t *db, const char *path) {
+    analysis_header_t header;
+
+    pthread_mutexattr_t attr;
+
+    memset(db, 0, sizeof(*db));
+    snprintf(db->path, sizeof(db->path), "%s", path);
+    // La consulta la hace el hilo de lectura (tiempo real) y el lock lo
+    // tienen hilos SCHED_IDLE: con herencia de prioridad no queda esperando
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&db->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == ANALYSIS_DB_MAGIC &&
+        header.version == ANALYSIS_DB_VERSION && header.record_size == ANALYSIS_RECORD_SIZE &&
+        header.count > 0) {
+        db->records = malloc((size_t)header.count * ANALYSIS_RECORD_SIZE);
+        if (!db->records) {
+            fclose(file);
+            return -1;
+        }
+        db->capacity = header.count;
+        db->count = fread(db->records, ANALYSIS_RECORD_SIZE, header.count, file);
+        // Una base corrupta no puede llevar a strcmp fuera del registro
+        for (uint32_t i = 0; i < db->count; i++) {
+            db->records[i].path[ANALYSIS_PATH_MAX - 1] = '\0';
+        }
+    }
+    fclose(file);
+    return (int)db->count;
+}
+
+void analysis_db_close(analysis_db_t *db) {
+    free(db->records);
+    db->records = NULL;
+    db->count = 0;
+    db->capacity = 0;
+    pthread_mutex_destroy(&db->lock);
+}
+
+int analysis_db_find(analysis_db_t *db, const char *path, const struct stat *st, analysis_record_t *out) {
+    int found = 0;
+
+    pthread_mutex_lock(&db->lock);
+    const analysis_record_t *rec = db_lookup(db, path);
+    if (rec && rec->mtime == (int64_t)st->st_mtime && rec->size == (uint64_t)st->st_size) {
+        if (out) {
+            memcpy(out, rec, sizeof(*out));
+        }
+        found = 1;
+    }
+    pthread_mutex_unlock(&db->lock);
+    return found;
+}
+
+int analysis_db_store(analysis_db_t *db, const analysis_record_t *rec) {
+    int result = 0;
+
+    pthread_mutex_lock(&db->lock);
+    analysis_record_t *slot = db_lookup(db, rec->path);
+    if (!slot) {
+        if (db->count == db->capacity) {
+            uint32_t capacity = db->capacity ? db->capacity * 2 : 64;
+            analysis_record_t *records = realloc(db->records, (size_t)capacity * ANALYSIS_RECORD_SIZE);
+            if (!records) {
+                result = -1;
+                goto out;
+            }
+            db->records = records;
+            db->capacity = capacity;
+        }
+        slot = &db->records[db->count++];
+    }
+    memcpy(slot, rec, sizeof(*slot));
+    db->dirty++;
+
+out:
+    pthread_mutex_unlock(&db->lock);
+    return result;
+}
+
+int analysis_db_save(analysis_db_t *db) {
+    analysis_header_t header = {
+        .magic = ANALYSIS_DB_MAGIC, .version = ANALYSIS_DB_VERSION, .record_size = ANALYSIS_RECORD_SIZE,
+    };
+    char tmp_path[ANALYSIS_PATH_MAX + 8];
+    analysis_record_t *copy = NULL;
+    uint32_t dirty;
+
+    // Copia bajo el lock; la SD se escribe sin frenar a los que consultan
+    pthread_mutex_lock(&db->lock);
+    dirty = db->dirty;
+    if (dirty > 0) {
+        header.count = db->count;
+        copy = malloc((size_t)db->count * ANALYSIS_RECORD_SIZE);
+        if (copy) {
+            memcpy(copy, db->records, (size_t)db->count * ANALYSIS_RECORD_SIZE);
+            db->dirty = 0;
+        }
+    }
+    pthread_mutex_unlock(&db->lock);
+    if (dirty == 0) {
+        return 0;
+    }
+    if (!copy) {
+        return -1;
+    }
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", db->path);
+    FILE *file = fopen(tmp_path, "wb");
+    int ok = file && fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(copy, ANALYSIS_RECORD_SIZE, header.count, file) == header.count;
+    if (file && fclose(file) != 0) {
+        ok = 0;
+    }
+    free(copy);
+    if (!ok || rename(tmp_path, db->path) != 0) {
+        unlink(tmp_path);
+        pthread_mutex_lock(&db->lock);
+        db->dirty += dirty;
+        pthread_mutex_unlock(&db->lock);
+        return -1;
+    }
+    return 0;
+}
+
+// --- Decodificación: estéreo de 16 bits, como lo ve la reproducción ---
+
+typedef struct {
+    int flac;
+    flac_decoder_t dec;
+    FILE *file;
+    wav_format_t fmt;
+    uint64_t remaining;         // WAV: frames que faltan del chunk data
+    uint8_t *raw;
+} analysis_source_t;
+
+static int source_open(analysis_source_t *src, const char *path, const struct stat *st) {
+    size_t len = strlen(path);
+
+    memset(src, 0, sizeof(*src));
+    if (len > 5 && strcasecmp(path + len - 5, ".flac") == 0) {
+        src->flac = 1;
+        return flac_open(&src->dec, path, 0);
+    }
+
+    src->file = fopen(path, "rb");
+    if (!src->file || wav_parse(src->file, st->st_size, &src->fmt) != 0 ||
+        fseek(src->file, src->fmt.data_offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    src->remaining = src->fmt.total_frames;
+    src->raw = malloc((size_t)ANALYSIS_BUFFER_FRAMES * src->fmt.block_align);
+    return src->raw ? 0 : -1;
+}
+
+static void source_close(analysis_source_t *src) {
+    if (src->flac) {
+        flac_close(&src->dec);
+    } else if (src->file) {
+        fclose(src->file);
+    }
+    free(src->raw);
+}
+
+static uint32_t source_rate(const analysis_source_t *src) {
+    return src->flac ? src->dec.sample_rate : src->fmt.sample_rate;
+}
+
+static uint64_t source_frames(const analysis_source_t *src) {
+    return src->flac ? src->dec.total_samples : src->fmt.total_frames;
+}
+
+// Hasta ANALYSIS_BUFFER_FRAMES frames; 0 al final
+static uint32_t source_read(analysis_source_t *src, int16_t *out) {
+    if (src->flac) {
+        int read = flac_read_frames(&src->dec, out, ANALYSIS_BUFFER_FRAMES);
+        return (read > 0) ? (uint32_t)read : 0;
+    }
+
+    uint32_t frames = (src->remaining < ANALYSIS_BUFFER_FRAMES) ? (uint32_t)src->remaining : ANALYSIS_BUFFER_FRAMES;
+    uint32_t read = fread(src->raw, src->fmt.block_align, frames, src->file);
+    uint32_t channels = src->fmt.channels;
+    src->remaining -= read;
+
+    for (uint32_t i = 0; i < read * 2; i++) {
+        uint32_t sample = (channels == 2) ? i : i / 2;
+        if (src->fmt.bits_per_sample == 24) {
+            const uint8_t *b = src->raw + 3 * sample;
+            out[i] = (int16_t)(b[1] | (b[2] << 8));
+        } else {
+            const uint8_t *b = src->raw + 2 * sample;
+            out[i] = (int16_t)(b[0] | (b[1] << 8));
+        }
+    }
+    return read;
+}
+
+// --- Loudness (BS.1770) ---
+// Filtro K: shelving de +4 dB y pasa-altos de 38 Hz, con los coeficientes
+// calculados para la tasa del archivo. En double: los polos del pasa-altos
+// quedan muy cerca de 1 a 96 kHz. Recursivo, así que no se vectoriza.
+
+typedef struct {
+    double b0, b1, b2, a1, a2;
+    double z1[2], z2[2];
+} biquad_t;
+
+static void k_filter_init(biquad_t *shelf, biquad_t *highpass, uint32_t rate) {
+    double k = tan(M_PI * 1681.974450955533 / rate);
+    double q = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+
+    memset(shelf, 0, sizeof(*shelf));
+    shelf->b0 = (vh + vb * k / q + k * k) / a0;
+    shelf->b1 = 2.0 * (k * k - vh) / a0;
+    shelf->b2 = (vh - vb * k / q + k * k) / a0;
+    shelf->a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf->a2 = (1.0 - k / q + k * k) / a0;
+
+    k = tan(M_PI * 38.13547087602444 / rate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    memset(highpass, 0, sizeof(*highpass));
+    highpass->b0 = 1.0;
+    highpass->b1 = -2.0;
+    highpass->b2 = 1.0;
+    highpass->a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass->a2 = (1.0 - k / q + k * k) / a0;
+}
+
+static inline double biquad_run(biquad_t *f, int ch, double x) {
+    double y = f->b0 * x + f->z1[ch];
+    f->z1[ch] = f->b1 * x - f->a1 * y + f->z2[ch];
+    f->z2[ch] = f->b2 * x - f->a2 * y;
+    return y;
+}
+
+// Bloques de 400 ms solapados (paso de 100 ms = un sub-bloque), gate
+// absoluto de -70 LUFS y relativo de -10 LU. Centésimas de LUFS.
+static int32_t integrated_loudness(const double *power, uint32_t subblocks) {
+    uint32_t span = (subblocks < 4) ? subblocks : 4;
+    uint32_t blocks = subblocks - span + 1;
+    double threshold = pow(10.0, (-70.0 + 0.691) / 10.0);
+    double sum = 0;
+    uint32_t count = 0;
+
+    if (subblocks == 0) {
+        return ANALYSIS_SILENT;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        sum = 0;
+        count = 0;
+        for (uint32_t b = 0; b < blocks; b++) {
+            double z = 0;
+            for (uint32_t s = 0; s < span; s++) {
+                z += power[b + s];
+            }
+            z /= span;
+            if (z > threshold) {
+                sum += z;
+                count++;
+            }
+        }
+        if (count == 0) {
+            return ANALYSIS_SILENT;
+        }
+        // Segunda pasada: 10 LU por debajo de lo que pasó el gate absoluto
+        threshold = sum / count * pow(10.0, -10.0 / 10.0);
+    }
+    return (int32_t)lround((-0.691 + 10.0 * log10(sum / count)) * 100.0);
+}
+
+int analysis_run(const char *path, const struct stat *st, analysis_record_t *rec) {
+    analysis_source_t src;
+    biquad_t shelf, highpass;
+    int16_t *pcm = NULL;
+    double *power = NULL;
+    int result = -1;
+
+    memset(rec, 0, sizeof(*rec));
+    snprintf(rec->path, sizeof(rec->path), "%s", path);
+    rec->mtime = st->st_mtime;
+    rec->size = st->st_size;
+
+    if (source_open(&src, path, st) != 0 || source_rate(&src) == 0) {
+        goto out;
+    }
+    uint32_t rate = source_rate(&src);
+    uint64_t expected = source_frames(&src);
+    uint32_t sub_frames = rate / 10;
+    uint32_t sub_capacity = (uint32_t)(expected / sub_frames) + 2;
+
+    pcm = malloc(ANALYSIS_BUFFER_FRAMES * 4);
+    power = malloc(sub_capacity * sizeof(double));
+    if (!pcm || !power) {
+        goto out;
+    }
+    k_filter_init(&shelf, &highpass, rate);
+
+    rec->sample_rate = rate;
+    rec->overview_frames = (uint32_t)((expected + ANALYSIS_OVERVIEW_POINTS - 1) / ANALYSIS_OVERVIEW_POINTS);
+    if (rec->overview_frames == 0) {
+        rec->overview_frames = rate;
+    }
+    int16_t view_min[ANALYSIS_OVERVIEW_POINTS], view_max[ANALYSIS_OVERVIEW_POINTS];
+    for (int i = 0; i < ANALYSIS_OVERVIEW_POINTS; i++) {
+        view_min[i] = 0;
+        view_max[i] = 0;
+    }
+
+    uint64_t frame = 0;
+    uint32_t subblocks = 0, sub_fill = 0, peak = 0;
+    double energy = 0;
+    int found = 0;
+    uint32_t read;
+
+    while ((read = source_read(&src, pcm)) > 0) {
+        // Pico, silencio y vista con los kernels NEON
+        int32_t block_peak = dsp_peak_s16(pcm, read * 2);
+        if ((uint32_t)block_peak > peak) {
+            peak = block_peak;
+        }
+        for (uint32_t i = 0; block_peak > ANALYSIS_SILENCE_LEVEL && i < read; i += ANALYSIS_SEGMENT_FRAMES) {
+            uint32_t n = (read - i < ANALYSIS_SEGMENT_FRAMES) ? read - i : ANALYSIS_SEGMENT_FRAMES;
+            if (dsp_peak_s16(pcm + 2 * i, n * 2) <= ANALYSIS_SILENCE_LEVEL) {
+                continue;
+            }
+            for (uint32_t j = 0; j < n; j++) {
+                const int16_t *f = pcm + 2 * (i + j);
+                if (abs(f[0]) > ANALYSIS_SILENCE_LEVEL || abs(f[1]) > ANALYSIS_SILENCE_LEVEL) {
+                    if (!found) {
+                        rec->first_frame = frame + i + j;
+                        found = 1;
+                    }
+                    rec->end_frame = frame + i + j + 1;
+                }
+            }
+        }
+        for (uint32_t i = 0; i < read; ) {
+            uint64_t point = (frame + i) / rec->overview_frames;
+            uint32_t n = (uint32_t)((point + 1) * rec->overview_frames - (frame + i));
+            if (n > read - i) {
+                n = read - i;
+            }
+            if (point >= ANALYSIS_OVERVIEW_POINTS) {
+                point = ANALYSIS_OVERVIEW_POINTS - 1;      // Más frames que los de la cabecera
+            }
+            int16_t lo, hi;
+            dsp_minmax_s16(pcm + 2 * i, n * 2, &lo, &hi);
+            if (lo < view_min[point]) view_min[point] = lo;
+            if (hi > view_max[point]) view_max[point] = hi;
+            i += n;
+        }
+
+        // Filtro K y potencia por sub-bloque de 100 ms (los dos canales suman)
+        for (uint32_t i = 0; i < read; i++) {
+            for (int ch = 0; ch < 2; ch++) {
+                double y = biquad_run(&highpass, ch, biquad_run(&shelf, ch, pcm[2 * i + ch] / 32768.0));
+                energy += y * y;
+            }
+            if (++sub_fill == sub_frames) {
+                if (subblocks < sub_capacity) {
+                    power[subblocks++] = energy / sub_frames;
+                }
+                energy = 0;
+                sub_fill = 0;
+            }
+        }
+        frame += read;
+    }
+
+    rec->total_frames = frame;
+    rec->peak = peak;
+    rec->loudness = integrated_loudness(power, subblocks);
+    for (int i = 0; i < ANALYSIS_OVERVIEW_POINTS; i++) {
+        rec->overview[i][0] = (int8_t)(view_min[i] >> 8);
+        rec->overview[i][1] = (int8_t)(view_max[i] >> 8);
+    }
+    result = (frame > 0) ? 0 : -1;
+
+out:
+    source_close(&src);
+    free(pcm);
+    free(power);
+    return result;
+}
+
+int32_t analysis_gain(const analysis_record_t *rec) {
+    if (rec->loudness == ANALYSIS_SILENT) {
+        return LIMITER_UNITY_GAIN;
+    }
+    double db = ANALYSIS_TARGET_LUFS - rec->loudness / 100.0;
+    double gain = LIMITER_UNITY_GAIN * pow(10.0, db / 20.0);
+
+    if (rec->peak > 0 && gain * rec->peak > 32767.0 * LIMITER_UNITY_GAIN) {
+        gain = 32767.0 * LIMITER_UNITY_GAIN / rec->peak;
+    }
+    if (gain > ANALYSIS_GAIN_MAX) {
+        gain = ANALYSIS_GAIN_MAX;
+    }
+    return (int32_t)gain;
+}
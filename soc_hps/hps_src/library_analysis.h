@@ -0,0 +1,86 @@
+#ifndef LIBRARY_ANALYSIS_H
+#define LIBRARY_ANALYSIS_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// Análisis de las pistas fuera de tiempo real: loudness integrada (BS.1770 /
+// EBU R128: filtro K, bloques de 400 ms con gate absoluto y relativo), pico,
+// silencio al principio y al final y una vista de forma de onda (mínimo y
+// máximo por bloque). Lo hacen hilos de baja prioridad del loader; la
+// reproducción solo consulta el resultado.
+//
+// Los resultados van a una base aparte del índice de la biblioteca (ese es
+// del hilo de lectura): un archivo con registros de tamaño fijo que se carga
+// entero en memoria. Un registro vale mientras el archivo conserve mtime y
+// tamaño. Las funciones de la base son thread-safe; guardar escribe una
+// copia (archivo temporal + rename) fuera del lock.
+
+#define ANALYSIS_DB_MAGIC           0x5A4C4E41      // "ANLZ"
+#define ANALYSIS_DB_VERSION         1
+#define ANALYSIS_RECORD_SIZE        1024
+#define ANALYSIS_PATH_MAX           256
+#define ANALYSIS_OVERVIEW_POINTS    256
+#define ANALYSIS_SILENT             INT32_MIN       // loudness: ningún bloque pasó el gate absoluto
+#define ANALYSIS_SILENCE_LEVEL      33              // -60 dBFS en 16 bits
+#define ANALYSIS_TARGET_LUFS        (-18)           // Referencia de ReplayGain 2.0
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t count;
+    uint32_t reserved[12];      // 64 bytes
+} analysis_header_t;
+
+typedef struct __attribute__((packed)) {
+    char path[ANALYSIS_PATH_MAX];
+    int64_t mtime;
+    uint64_t size;
+    uint64_t total_frames;
+    uint32_t sample_rate;
+    int32_t loudness;           // Centésimas de LUFS o ANALYSIS_SILENT
+    uint32_t peak;              // Pico de muestra (16 bits)
+    uint32_t overview_frames;   // Frames por punto de la vista
+    uint64_t first_frame;       // Primer frame sobre ANALYSIS_SILENCE_LEVEL
+    uint64_t end_frame;         // Después del último (first = end: todo silencio)
+    int8_t overview[ANALYSIS_OVERVIEW_POINTS][2];   // Mínimo y máximo (muestra >> 8)
+    uint8_t reserved[200];
+} analysis_record_t;
+
+_Static_assert(sizeof(analysis_header_t) == 64, "cabecera del análisis: 64 bytes");
+_Static_assert(sizeof(analysis_record_t) == ANALYSIS_RECORD_SIZE, "registro del análisis: 1 KB");
+
+typedef struct {
+    char path[ANALYSIS_PATH_MAX];
+    pthread_mutex_t lock;
+    analysis_record_t *records;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t dirty;             // Registros nuevos desde el último guardado
+} analysis_db_t;
+
+// Carga la base (vacía si no existe o no es válida). Devuelve los
+// registros cargados o -1.
+int analysis_db_open(analysis_db_t *db, const char *path);
+void analysis_db_close(analysis_db_t *db);
+
+// Copia en 'out' el registro de 'path' si sigue valiendo para 'st'. 1 o 0.
+int analysis_db_find(analysis_db_t *db, const char *path, const struct stat *st, analysis_record_t *out);
+
+// Agrega o reemplaza el registro de rec->path
+int analysis_db_store(analysis_db_t *db, const analysis_record_t *rec);
+
+// Escribe la base si cambió. 0 o -1.
+int analysis_db_save(analysis_db_t *db);
+
+// Decodifica la pista entera y llena 'rec' (ruta, mtime y tamaño de 'st').
+// 0 o -1. Lo llama cualquier hilo: no usa estado compartido.
+int analysis_run(const char *path, const struct stat *st, analysis_record_t *rec);
+
+// Ganancia (Q12) para llevar la pista a ANALYSIS_TARGET_LUFS sin que el
+// pico pase de 0 dBFS
+int32_t analysis_gain(const analysis_record_t *rec);
+
+#endif /* LIBRARY_ANALYSIS_H */
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "library_index.h"
+
+static uint32_t path_hash(const char *path) {
+    uint32_t h = 2166136261u;       // FNV-1a
+    while (*path) {
+        h = (h ^ (uint8_t)*path++) * 16777619u;
+    }
+    return h;
+}
+
+// Casilla de la tabla hash para 'path': la ocupada por su registro o la
+// vacía donde iría
+static uint32_t *hash_slot(library_index_t *lib, const char *path) {
+    uint32_t i = path_hash(path) & lib->hash_mask;
+
+    while (lib->hash[i] && strcmp(lib->records[lib->hash[i] - 1].path, path) != 0) {
+        i = (i + 1) & lib->hash_mask;
+    }
+    return &lib->hash[i];
+}
+
+// Tabla con al menos el doble de casillas que registros posibles
+static int rehash(library_index_t *lib) {
+    uint32_t size = 1;
+    while (size < lib->capacity * 2) {
+        size <<= 1;
+    }
+
+    uint32_t *hash = calloc(size, sizeof(uint32_t));
+    if (!hash) {
+        return -1;
+    }
+    free(lib->hash);
+    lib->hash = hash;
+    lib->hash_mask = size - 1;
+
+    for (uint32_t i = 0; i < lib->header->count; i++) {
+        // Un índice corrupto no puede llevar a strcmp fuera del registro
+        if (lib->records[i].path[LIBRARY_PATH_MAX - 1] != '\0') {
+            lib->records[i].path[LIBRARY_PATH_MAX - 1] = '\0';
+        }
+        uint32_t *slot = hash_slot(lib, lib->records[i].path);
+        if (*slot == 0) {
+            *slot = i + 1;
+        }
+    }
+    return 0;
+}
+
+// (Re)mapea el archivo con lugar para 'capacity' registros
+static int map_records(library_index_t *lib, uint32_t capacity) {
+    size_t size = sizeof(library_header_t) + (size_t)capacity * LIBRARY_RECORD_SIZE;
+
+    if (ftruncate(lib->fd, size) != 0) {
+        return -1;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, lib->fd, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    if (lib->base) {
+        munmap(lib->base, lib->map_size);
+    }
+    lib->base = base;
+    lib->map_size = size;
+    lib->header = base;
+    lib->records = (library_record_t *)((uint8_t *)base + sizeof(library_header_t));
+    lib->capacity = capacity;
+    return rehash(lib);
+}
+
+int library_open(library_index_t *lib, const char *path) {
+    library_header_t header;
+    struct stat st;
+    uint32_t capacity = 0;
+    int valid = 0;
+
+    memset(lib, 0, sizeof(*lib));
+    lib->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (lib->fd < 0) {
+        return -1;
+    }
+
+    if (fstat(lib->fd, &st) == 0 && st.st_size >= (off_t)sizeof(header) &&
+        pread(lib->fd, &header, sizeof(header), 0) == sizeof(header) &&
+        header.magic == LIBRARY_INDEX_MAGIC && header.version == LIBRARY_INDEX_VERSION &&
+        header.record_size == LIBRARY_RECORD_SIZE) {
+        capacity = (st.st_size - sizeof(header)) / LIBRARY_RECORD_SIZE;
+        valid = (header.count <= capacity);
+    }
+    if (capacity < LIBRARY_MIN_CAPACITY) {
+        capacity = LIBRARY_MIN_CAPACITY;
+    }
+
+    // Un índice de otra versión o truncado se descarta entero
+    if (!valid && ftruncate(lib->fd, 0) != 0) {
+        library_close(lib);
+        return -1;
+    }
+    if (map_records(lib, capacity) != 0) {
+        library_close(lib);
+        return -1;
+    }
+    if (!valid) {
+        memset(lib->header, 0, sizeof(library_header_t));
+        lib->header->magic = LIBRARY_INDEX_MAGIC;
+        lib->header->version = LIBRARY_INDEX_VERSION;
+        lib->header->record_size = LIBRARY_RECORD_SIZE;
+    }
+    return (int)lib->header->count;
+}
+
+void library_close(library_index_t *lib) {
+    if (lib->base) {
+        msync(lib->base, lib->map_size, MS_SYNC);
+        munmap(lib->base, lib->map_size);
+    }
+    if (lib->fd >= 0) {
+        close(lib->fd);
+    }
+    free(lib->hash);
+    memset(lib, 0, sizeof(*lib));
+    lib->fd = -1;
+}
+
+library_record_t *library_lookup(library_index_t *lib, const char *path) {
+    if (!lib->base) {
+        return NULL;
+    }
+    uint32_t index = *hash_slot(lib, path);
+    return index ? &lib->records[index - 1] : NULL;
+}
+
+library_record_t *library_find(library_index_t *lib, const char *path, const struct stat *st) {
+    library_record_t *rec = library_lookup(lib, path);
+
+    if (!rec || !rec->valid || rec->mtime != (int64_t)st->st_mtime || rec->size != (uint64_t)st->st_size) {
+        return NULL;
+    }
+    return rec;
+}
+
+library_record_t *library_update(library_index_t *lib, const char *path, const struct stat *st) {
+    if (!lib->base || strlen(path) >= LIBRARY_PATH_MAX) {
+        return NULL;
+    }
+
+    uint32_t *slot = hash_slot(lib, path);
+    if (*slot == 0) {
+        if (lib->header->count == lib->capacity) {
+            if (map_records(lib, lib->capacity * 2) != 0) {
+                return NULL;
+            }
+            slot = hash_slot(lib, path);
+        }
+        *slot = ++lib->header->count;
+    }
+
+    library_record_t *rec = &lib->records[*slot - 1];
+    memset(rec, 0, sizeof(*rec));
+    snprintf(rec->path, sizeof(rec->path), "%s", path);
+    rec->mtime = st->st_mtime;
+    rec->size = st->st_size;
+    return rec;
+}
@@ -0,0 +1,96 @@
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+// Índice persistente de la biblioteca: un archivo en la SD con registros de
+// tamaño fijo (ruta, formato, frames, duración, tabla de búsqueda) que se
+// mapea entero con mmap. Un registro vale mientras el archivo conserve el
+// mtime y el tamaño con que se indexó; si cambió, o no estaba, se reescribe
+// en su lugar o se agrega al final (el archivo crece con ftruncate).
+//
+// El mapeo es MAP_SHARED: las escrituras llegan a la SD aunque el proceso
+// termine sin library_close(). Un registro a medio escribir queda con
+// valid = 0 y se rehace la próxima vez.
+//
+// No es thread-safe: lo usa un solo hilo (el de lectura) una vez arrancado
+// el pipeline.
+
+#define LIBRARY_INDEX_MAGIC     0x5844494C      // "LIDX"
+#define LIBRARY_INDEX_VERSION   2               // 2: offsets y frames del parser RIFF
+#define LIBRARY_RECORD_SIZE     1024
+#define LIBRARY_PATH_MAX        256
+#define LIBRARY_POINTS          44              // Tabla de búsqueda por registro
+#define LIBRARY_MIN_CAPACITY    64
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t count;             // Registros en uso
+    uint32_t reserved[12];      // 64 bytes
+} library_header_t;
+
+// Sample inicial de un frame FLAC y su offset relativo al primer frame
+typedef struct __attribute__((packed)) {
+    uint64_t sample;
+    uint64_t offset;
+} library_point_t;
+
+typedef struct __attribute__((packed)) {
+    char path[LIBRARY_PATH_MAX];
+    int64_t mtime;
+    uint64_t size;
+    uint64_t total_frames;
+    uint32_t format;            // SONG_FORMAT_* del loader
+    uint32_t sample_rate;
+    uint32_t bits_per_sample;
+    uint32_t channels;
+    uint32_t data_offset;       // WAV: inicio de las muestras
+    uint32_t duration_sec;
+    uint32_t num_points;        // FLAC: puntos en points[] (WAV no los necesita)
+    uint32_t valid;             // Se escribe último
+    library_point_t points[LIBRARY_POINTS];
+    uint8_t reserved[8];
+} library_record_t;
+
+_Static_assert(sizeof(library_header_t) == 64, "cabecera del índice: 64 bytes");
+_Static_assert(sizeof(library_record_t) == LIBRARY_RECORD_SIZE, "registro del índice: 1 KB");
+
+typedef struct {
+    int fd;
+    void *base;
+    size_t map_size;
+    library_header_t *header;
+    library_record_t *records;
+    uint32_t capacity;
+    uint32_t *hash;             // Ruta → registro + 1 (0 = vacío), direccionamiento abierto
+    uint32_t hash_mask;
+} library_index_t;
+
+// Mapea el índice (lo crea o lo reinicia si no es válido). Devuelve los
+// registros existentes o -1; con -1 el resto de las funciones no hacen nada.
+int library_open(library_index_t *lib, const char *path);
+void library_close(library_index_t *lib);
+
+// Registro de 'path' sin validar (NULL si no está)
+library_record_t *library_lookup(library_index_t *lib, const char *path);
+
+// Registro de 'path' si sigue valiendo para 'st'
+library_record_t *library_find(library_index_t *lib, const char *path, const struct stat *st);
+
+// Registro a completar para 'path' (el existente o uno nuevo), con ruta,
+// mtime y tamaño cargados y valid = 0. El puntero deja de valer en la
+// próxima llamada a library_update(): el índice puede remapearse al crecer.
+library_record_t *library_update(library_index_t *lib, const char *path, const struct stat *st);
+
+static inline int library_record_index(const library_index_t *lib, const library_record_t *rec) {
+    return (int)(rec - lib->records);
+}
+
+static inline library_record_t *library_record(library_index_t *lib, int index) {
+    return (lib->records && index >= 0 && (uint32_t)index < lib->header->count) ? &lib->records[index] : NULL;
+}
+
+#endif /* LIBRARY_INDEX_H */
@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "native_track.h"
+
+static uint64_t align_up(uint64_t value) {
+    return (value + NATIVE_ALIGN - 1) & ~(uint64_t)(NATIVE_ALIGN - 1);
+}
+
+static uint32_t format_frame_bytes(uint32_t format) {
+    return (format == NATIVE_FORMAT_PCM24) ? 8 : 4;
+}
+
+int native_open(native_track_t *nt, const char *path) {
+    memset(nt, 0, sizeof(*nt));
+    nt->file = fopen(path, "rb");
+    if (!nt->file) {
+        return -1;
+    }
+
+    native_header_t *h = &nt->header;
+    if (fread(h, sizeof(*h), 1, nt->file) != 1 || h->magic != NATIVE_MAGIC || h->version != NATIVE_VERSION ||
+        (h->format != NATIVE_FORMAT_PCM16 && h->format != NATIVE_FORMAT_PCM24) ||
+        h->sample_rate == 0 || h->chunk_frames == 0 || h->num_chunks == 0 ||
+        h->num_chunks > SIZE_MAX / sizeof(native_chunk_t)) {
+        native_close(nt);
+        return -1;
+    }
+    nt->frame_bytes = format_frame_bytes(h->format);
+
+    // Un chunk tiene que entrar en el buffer que va al bridge
+    uint64_t max_bytes = (h->format == NATIVE_FORMAT_PCM24) ? NATIVE_PCM24_CHUNK_BYTES : NATIVE_PCM16_CHUNK_BYTES;
+    if ((uint64_t)h->chunk_frames * nt->frame_bytes > max_bytes) {
+        native_close(nt);
+        return -1;
+    }
+
+    nt->chunks = malloc((size_t)h->num_chunks * sizeof(native_chunk_t));
+    if (!nt->chunks || fread(nt->chunks, sizeof(native_chunk_t), h->num_chunks, nt->file) != h->num_chunks) {
+        native_close(nt);
+        return -1;
+    }
+    for (uint32_t i = 0; i < h->num_chunks; i++) {
+        const native_chunk_t *c = &nt->chunks[i];
+        if (c->frames > h->chunk_frames || c->bytes != (uint64_t)c->frames * nt->frame_bytes ||
+            c->offset % NATIVE_ALIGN) {
+            native_close(nt);
+            return -1;
+        }
+    }
+
+    // Se lee de corrido: que el kernel adelante la lectura
+    posix_fadvise(fileno(nt->file), 0, 0, POSIX_FADV_SEQUENTIAL);
+    return 0;
+}
+
+void native_close(native_track_t *nt) {
+    if (nt->file) {
+        fclose(nt->file);
+    }
+    free(nt->chunks);
+    nt->file = NULL;
+    nt->chunks = NULL;
+}
+
+uint32_t native_read_chunk(native_track_t *nt, uint32_t chunk, void *out, uint32_t out_capacity,
+                           uint32_t *bytes) {
+    if (chunk >= nt->header.num_chunks) {
+        return 0;
+    }
+    const native_chunk_t *c = &nt->chunks[chunk];
+    if (c->bytes > out_capacity || pread(fileno(nt->file), out, c->bytes, c->offset) != (ssize_t)c->bytes) {
+        return 0;
+    }
+    *bytes = c->bytes;
+    return c->frames;
+}
+
+int native_create(native_writer_t *w, const char *path, uint32_t format, uint32_t sample_rate,
+                  uint32_t chunk_frames, uint32_t max_chunks) {
+    memset(w, 0, sizeof(*w));
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    w->header.magic = NATIVE_MAGIC;
+    w->header.version = NATIVE_VERSION;
+    w->header.format = format;
+    w->header.sample_rate = sample_rate;
+    w->header.chunk_frames = chunk_frames;
+    w->frame_bytes = format_frame_bytes(format);
+    w->capacity = max_chunks;
+    w->offset = align_up(sizeof(native_header_t) + (uint64_t)max_chunks * sizeof(native_chunk_t));
+
+    w->chunks = calloc(max_chunks, sizeof(native_chunk_t));
+    w->file = fopen(path, "wb");
+    if (!w->chunks || !w->file) {
+        native_abort(w);
+        return -1;
+    }
+    return 0;
+}
+
+int native_write_chunk(native_writer_t *w, const void *words, uint32_t frames) {
+    native_chunk_t *c;
+    uint32_t bytes = frames * w->frame_bytes;
+
+    if (w->header.num_chunks == w->capacity || frames == 0 || frames > w->header.chunk_frames) {
+        return -1;
+    }
+    c = &w->chunks[w->header.num_chunks];
+    c->offset = w->offset;
+    c->bytes = bytes;
+    c->frames = frames;
+
+    // El relleno hasta el chunk siguiente queda como hueco (ceros)
+    if (fseeko(w->file, (off_t)c->offset, SEEK_SET) != 0 || fwrite(words, 1, bytes, w->file) != bytes) {
+        return -1;
+    }
+    w->offset = align_up(c->offset + bytes);
+    w->header.num_chunks++;
+    w->header.total_frames += frames;
+    return 0;
+}
+
+int native_finish(native_writer_t *w, int32_t loudness, uint32_t peak, int32_t gain) {
+    w->header.loudness = loudness;
+    w->header.peak = peak;
+    w->header.gain = gain;
+
+    int ok = w->header.num_chunks > 0 &&
+             fseeko(w->file, 0, SEEK_SET) == 0 &&
+             fwrite(&w->header, sizeof(w->header), 1, w->file) == 1 &&
+             fwrite(w->chunks, sizeof(native_chunk_t), w->header.num_chunks, w->file) == w->header.num_chunks;
+    // El último chunk también ocupa su página entera
+    ok = ok && ftruncate(fileno(w->file), (off_t)w->offset) == 0;
+    ok = (fclose(w->file) == 0) && ok;
+    w->file = NULL;
+    if (!ok) {
+        native_abort(w);
+        return -1;
+    }
+    free(w->chunks);
+    w->chunks = NULL;
+    return 0;
+}
+
+void native_abort(native_writer_t *w) {
+    if (w->file) {
+        fclose(w->file);
+        w->file = NULL;
+    }
+    free(w->chunks);
+    w->chunks = NULL;
+    unlink(w->path);
+}
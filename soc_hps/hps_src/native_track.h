@@ -0,0 +1,100 @@
+#ifndef NATIVE_TRACK_H
+#define NATIVE_TRACK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+// Contenedor de pistas ya convertidas a palabras del codec (.ntrk): lo que
+// el loader copiaría al bridge, armado de antemano por --transcode. El
+// audio va en chunks de tamaño fijo (los del transporte: 30 KB en PCM16,
+// un slot en PCM24), con frames enteros, y cada chunk empieza en un límite
+// de NATIVE_ALIGN. Reproducirlo es leer el chunk al buffer que va al bridge,
+// sin trabajo por muestra: tasa, ganancia y recorte ya se aplicaron.
+//
+//   cabecera (64 bytes) | tabla de chunks | relleno | chunk 0 | relleno | chunk 1 ...
+
+#define NATIVE_MAGIC            0x4B52544E      // "NTRK"
+#define NATIVE_VERSION          1
+#define NATIVE_ALIGN            4096            // Chunks alineados a página
+#define NATIVE_EXTENSION        ".ntrk"
+
+// Tope de un chunk: lo que entra en el transporte del loader
+// (AUDIO_CHUNK_SIZE en PCM16, HIRATE_SLOT_SIZE en PCM24)
+#define NATIVE_PCM16_CHUNK_BYTES  (30 * 1024)
+#define NATIVE_PCM24_CHUNK_BYTES  0x7E00
+
+// Mismos valores que SAMPLE_FORMAT_* del bridge
+#define NATIVE_FORMAT_PCM16     0               // Estéreo, 16 bits
+#define NATIVE_FORMAT_PCM24     2               // Palabras de 24 bits del codec en 32 bits
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;            // NATIVE_FORMAT_*
+    uint32_t sample_rate;       // Tasa del codec
+    uint32_t chunk_frames;      // Todos los chunks salvo el último
+    uint32_t num_chunks;
+    uint64_t total_frames;
+    int32_t loudness;           // Centésimas de LUFS del original (ANALYSIS_SILENT si no se midió)
+    uint32_t peak;              // Pico del original (16 bits)
+    int32_t gain;               // Ganancia ya aplicada (Q12)
+    uint32_t reserved[5];       // 64 bytes
+} native_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t offset;            // Múltiplo de NATIVE_ALIGN
+    uint32_t bytes;
+    uint32_t frames;
+} native_chunk_t;
+
+_Static_assert(sizeof(native_header_t) == 64, "cabecera .ntrk: 64 bytes");
+
+typedef struct {
+    FILE *file;
+    native_header_t header;
+    native_chunk_t *chunks;
+    uint32_t frame_bytes;
+} native_track_t;
+
+typedef struct {
+    FILE *file;
+    native_header_t header;
+    native_chunk_t *chunks;
+    uint32_t capacity;          // Lugar reservado para la tabla
+    uint32_t frame_bytes;
+    uint64_t offset;            // Dónde va el próximo chunk
+    char path[256];
+} native_writer_t;
+
+static inline int native_track_name(const char *path) {
+    size_t len = strlen(path);
+    size_t ext = sizeof(NATIVE_EXTENSION) - 1;
+    return len > ext && strcasecmp(path + len - ext, NATIVE_EXTENSION) == 0;
+}
+
+// Lee cabecera y tabla; rechaza chunks más grandes que el transporte. 0 o -1.
+int native_open(native_track_t *nt, const char *path);
+void native_close(native_track_t *nt);
+
+// Lee el chunk entero en 'out' (de 'out_capacity' bytes). Devuelve los
+// frames y deja en 'bytes' su tamaño, o 0 si no se pudo o no entra.
+uint32_t native_read_chunk(native_track_t *nt, uint32_t chunk, void *out, uint32_t out_capacity,
+                           uint32_t *bytes);
+
+// 'max_chunks' reserva la tabla: el total exacto se sabe al terminar.
+// 0 o -1.
+int native_create(native_writer_t *w, const char *path, uint32_t format, uint32_t sample_rate,
+                  uint32_t chunk_frames, uint32_t max_chunks);
+
+// Agrega un chunk (chunk_frames frames, salvo el último). 0 o -1.
+int native_write_chunk(native_writer_t *w, const void *words, uint32_t frames);
+
+// Escribe cabecera y tabla y cierra. Con error borra el archivo. 0 o -1.
+int native_finish(native_writer_t *w, int32_t loudness, uint32_t peak, int32_t gain);
+
+// Descarta lo escrito
+void native_abort(native_writer_t *w);
+
+#endif /* NATIVE_TRACK_H */
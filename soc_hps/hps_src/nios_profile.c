@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+#include "nios_profile.h"
+
+#define PROFILE_MAX_SYMBOLS   1024
+#define PROFILE_TOP           25
+
+typedef struct {
+    uint32_t address;
+    char name[64];
+    uint32_t samples;
+} profile_symbol_t;
+
+static profile_symbol_t symbols[PROFILE_MAX_SYMBOLS];
+static int num_symbols = 0;
+
+static void add_symbol(uint32_t address, const char *name) {
+    if (num_symbols >= PROFILE_MAX_SYMBOLS) {
+        return;
+    }
+    symbols[num_symbols].address = address;
+    snprintf(symbols[num_symbols].name, sizeof(symbols[num_symbols].name), "%.63s", name);
+    symbols[num_symbols].samples = 0;
+    num_symbols++;
+}
+
+// Etiquetas del desensamblado: "00000b98 <main>:"
+static int load_objdump_symbols(FILE *file) {
+    char line[512];
+    char name[256];
+    unsigned int address;
+
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "%x <%255[^>]>:", &address, name) == 2) {
+            add_symbol(address, name);
+        }
+    }
+    return 0;
+}
+
+// Tabla de símbolos ELF32 (solo funciones)
+static int load_elf_symbols(FILE *file) {
+    Elf32_Ehdr ehdr;
+    Elf32_Shdr symtab, strtab;
+    int found = 0;
+
+    if (fseek(file, 0, SEEK_SET) != 0 || fread(&ehdr, sizeof(ehdr), 1, file) != 1 ||
+        ehdr.e_ident[EI_CLASS] != ELFCLASS32 || ehdr.e_shentsize != sizeof(Elf32_Shdr)) {
+        printf("ERROR: ELF no soportado (se espera ELF32 del Nios)\n");
+        return -1;
+    }
+
+    for (int i = 0; i < ehdr.e_shnum && !found; i++) {
+        if (fseek(file, ehdr.e_shoff + i * sizeof(Elf32_Shdr), SEEK_SET) != 0 ||
+            fread(&symtab, sizeof(symtab), 1, file) != 1) {
+            return -1;
+        }
+        found = (symtab.sh_type == SHT_SYMTAB);
+    }
+    if (!found) {
+        printf("ERROR: El ELF no tiene tabla de símbolos\n");
+        return -1;
+    }
+
+    if (fseek(file, ehdr.e_shoff + symtab.sh_link * sizeof(Elf32_Shdr), SEEK_SET) != 0 ||
+        fread(&strtab, sizeof(strtab), 1, file) != 1) {
+        return -1;
+    }
+
+    char *names = malloc(strtab.sh_size + 1);
+    if (!names || fseek(file, strtab.sh_offset, SEEK_SET) != 0 ||
+        fread(names, 1, strtab.sh_size, file) != strtab.sh_size) {
+        free(names);
+        return -1;
+    }
+    names[strtab.sh_size] = '\0';
+
+    uint32_t count = symtab.sh_size / sizeof(Elf32_Sym);
+    for (uint32_t i = 0; i < count; i++) {
+        Elf32_Sym sym;
+        if (fseek(file, symtab.sh_offset + i * sizeof(Elf32_Sym), SEEK_SET) != 0 ||
+            fread(&sym, sizeof(sym), 1, file) != 1) {
+            break;
+        }
+        if (ELF32_ST_TYPE(sym.st_info) == STT_FUNC && sym.st_name < strtab.sh_size) {
+            add_symbol(sym.st_value, names + sym.st_name);
+        }
+    }
+
+    free(names);
+    return 0;
+}
+
+static int compare_address(const void *a, const void *b) {
+    const profile_symbol_t *sa = a, *sb = b;
+    return (sa->address > sb->address) - (sa->address < sb->address);
+}
+
+static int compare_samples(const void *a, const void *b) {
+    const profile_symbol_t *sa = a, *sb = b;
+    return (sb->samples > sa->samples) - (sb->samples < sa->samples);
+}
+
+static int load_symbols(const char *path) {
+    FILE *file = fopen(path, "rb");
+    unsigned char magic[4] = { 0 };
+    int result;
+
+    if (!file) {
+        printf("ERROR: No se pudo abrir %s\n", path);
+        return -1;
+    }
+
+    num_symbols = 0;
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, ELFMAG, SELFMAG) == 0) {
+        result = load_elf_symbols(file);
+    } else {
+        fseek(file, 0, SEEK_SET);
+        result = load_objdump_symbols(file);
+    }
+    fclose(file);
+
+    qsort(symbols, num_symbols, sizeof(symbols[0]), compare_address);
+    return result;
+}
+
+// Último símbolo con dirección <= address
+static profile_symbol_t *find_symbol(uint32_t address) {
+    int lo = 0, hi = num_symbols - 1, best = -1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (symbols[mid].address <= address) {
+            best = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return (best >= 0) ? &symbols[best] : NULL;
+}
+
+int profile_dump(volatile profile_area_t *profile, const char *symbols_path) {
+    if (profile->magic != PROFILE_MAGIC) {
+        printf("ERROR: Perfil no inicializado por el Nios (magic = 0x%08x)\n", profile->magic);
+        return -1;
+    }
+
+    uint32_t num_buckets = profile->num_buckets;
+    uint32_t shift = profile->bucket_shift;
+    uint32_t text_start = profile->text_start;
+    uint32_t samples = profile->samples;
+    uint32_t outside = profile->samples_outside;
+
+    if (num_buckets > PROFILE_MAX_BUCKETS) {
+        num_buckets = PROFILE_MAX_BUCKETS;
+    }
+
+    printf("=== Perfil Nios ===\n");
+    printf(".text: 0x%08x - 0x%08x, %u buckets de %u bytes\n",
+           text_start, profile->text_end, num_buckets, 1u << shift);
+    printf("Muestras: %u en .text, %u fuera (%u por segundo, ~%u s de captura)\n",
+           samples, outside, profile->sample_rate,
+           profile->sample_rate ? (samples + outside) / profile->sample_rate : 0);
+
+    if (samples == 0) {
+        return 0;
+    }
+
+    if (symbols_path && load_symbols(symbols_path) == 0 && num_symbols > 0) {
+        uint32_t unknown = 0;
+
+        for (uint32_t i = 0; i < num_buckets; i++) {
+            uint32_t count = profile->buckets[i];
+            if (count == 0) {
+                continue;
+            }
+            profile_symbol_t *sym = find_symbol(text_start + (i << shift));
+            if (sym) {
+                sym->samples += count;
+            } else {
+                unknown += count;
+            }
+        }
+
+        qsort(symbols, num_symbols, sizeof(symbols[0]), compare_samples);
+        printf("\n%8s %7s  %-10s %s\n", "Muestras", "%", "Dirección", "Función");
+        for (int i = 0; i < num_symbols && i < PROFILE_TOP && symbols[i].samples > 0; i++) {
+            printf("%8u %6.1f%%  0x%08x %s\n", symbols[i].samples,
+                   100.0 * symbols[i].samples / samples, symbols[i].address, symbols[i].name);
+        }
+        if (unknown) {
+            printf("%8u %6.1f%%  %-10s (sin símbolo)\n", unknown, 100.0 * unknown / samples, "-");
+        }
+        return 0;
+    }
+
+    // Sin símbolos: buckets crudos
+    printf("\n%8s  %s\n", "Muestras", "Rango");
+    for (uint32_t i = 0; i < num_buckets; i++) {
+        uint32_t count = profile->buckets[i];
+        if (count) {
+            uint32_t start = text_start + (i << shift);
+            printf("%8u  0x%08x - 0x%08x\n", count, start, start + (1u << shift) - 1);
+        }
+    }
+    return 0;
+}
+
+void profile_reset(volatile profile_area_t *profile) {
+    for (uint32_t i = 0; i < PROFILE_MAX_BUCKETS; i++) {
+        profile->buckets[i] = 0;
+    }
+    profile->samples = 0;
+    profile->samples_outside = 0;
+}
+
+// --- Histogramas de ISR ---
+
+static const char *isr_source_names[ISR_STATS_SOURCES] = {
+    "timer_isr",
+    "audio_isr",
+    "buttons_isr",
+    "process_audio_data",
+};
+
+// Fuentes cuya latencia el Nios estima por el espacio libre del FIFO del
+// codec en lugar de medirla contra un instante de hardware
+static const int isr_latency_estimated[ISR_STATS_SOURCES] = { 0, 1, 0, 1 };
+
+// Cota superior (en ciclos) del bin donde cae el percentil 'pct'
+static uint32_t histogram_percentile(const uint32_t *bins, uint32_t count, uint32_t pct) {
+    uint64_t target = ((uint64_t)count * pct + 99) / 100;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < ISR_STATS_BINS; i++) {
+        seen += bins[i];
+        if (seen >= target) {
+            return (i >= 31) ? 0xFFFFFFFF : (2u << i) - 1;
+        }
+    }
+    return 0xFFFFFFFF;
+}
+
+static void print_histogram(const char *name, const char *kind,
+                            volatile isr_histogram_t *hist, double cycles_per_us) {
+    uint32_t bins[ISR_STATS_BINS];
+    uint32_t count = hist->count;
+    uint32_t max = hist->max;
+    uint64_t sum = ((uint64_t)hist->sum_hi << 32) | hist->sum_lo;
+
+    for (int i = 0; i < ISR_STATS_BINS; i++) {
+        bins[i] = hist->bins[i];
+    }
+
+    if (count == 0) {
+        printf("%-20s %-9s sin muestras\n", name, kind);
+        return;
+    }
+
+    // La cota del bin nunca puede superar el máximo observado
+    uint32_t p50 = histogram_percentile(bins, count, 50);
+    uint32_t p99 = histogram_percentile(bins, count, 99);
+    if (p50 > max) p50 = max;
+    if (p99 > max) p99 = max;
+
+    printf("%-20s %-9s n=%-9u prom=%8.1f us  p50<=%8.1f us  p99<=%8.1f us  max=%8.1f us\n",
+           name, kind, count, sum / (double)count / cycles_per_us,
+           p50 / cycles_per_us, p99 / cycles_per_us, max / cycles_per_us);
+
+    for (int i = 0; i < ISR_STATS_BINS; i++) {
+        if (bins[i]) {
+            printf("%31s[%10u, %10u) ciclos: %u\n", "", i ? (1u << i) : 0,
+                   (i >= 31) ? 0xFFFFFFFF : (2u << i), bins[i]);
+        }
+    }
+}
+
+int isr_stats_dump(volatile isr_stats_area_t *stats) {
+    if (stats->magic != ISR_STATS_MAGIC) {
+        printf("ERROR: Estadísticas no inicializadas por el Nios (magic = 0x%08x)\n", stats->magic);
+        return -1;
+    }
+
+    double cycles_per_us = stats->ticks_freq / 1e6;
+    uint32_t sources = stats->num_sources;
+    if (sources > ISR_STATS_SOURCES) {
+        sources = ISR_STATS_SOURCES;
+    }
+
+    printf("=== Latencia y duración de ISR (Nios @ %u Hz) ===\n", stats->ticks_freq);
+    for (uint32_t i = 0; i < sources; i++) {
+        print_histogram(isr_source_names[i], isr_latency_estimated[i] ? "latencia*" : "latencia",
+                        &stats->sources[i].latency, cycles_per_us);
+        print_histogram(isr_source_names[i], "duración", &stats->sources[i].duration, cycles_per_us);
+    }
+    printf("* Estimada por el espacio libre del FIFO, no medida; process_audio_data solo\n"
+           "  registra las pasadas que escribieron frames\n");
+    return 0;
+}
+
+void isr_stats_reset(volatile isr_stats_area_t *stats) {
+    stats->reset_request = 1;
+}
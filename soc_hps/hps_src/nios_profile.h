@@ -0,0 +1,77 @@
+#ifndef NIOS_PROFILE_H
+#define NIOS_PROFILE_H
+
+#include <stdint.h>
+
+// Perfil estadístico del Nios: el ISR del timer muestrea el PC interrumpido
+// (registro ea) y acumula un histograma sobre stext..etext en este bloque
+// de la memoria compartida. El HPS lo lee y lo simboliza con el .objdump/.elf.
+
+#define PROFILE_OFFSET        0x1F000     // Relativo a la memoria compartida
+#define PROFILE_SIZE          0x800       // 2 KB
+#define PROFILE_MAGIC         0x464F5250  // "PROF"
+#define PROFILE_HEADER_SIZE   32
+#define PROFILE_MAX_BUCKETS   ((PROFILE_SIZE - PROFILE_HEADER_SIZE) / 2)
+
+// *** ESTRUCTURA EXACTAMENTE IGUAL QUE NIOS ***
+typedef struct __attribute__((packed)) {
+    volatile uint32_t magic;            // PROFILE_MAGIC cuando el Nios lo inicializó
+    volatile uint32_t text_start;       // stext
+    volatile uint32_t text_end;         // etext
+    volatile uint32_t bucket_shift;     // Bytes por bucket = 1 << bucket_shift
+    volatile uint32_t num_buckets;
+    volatile uint32_t samples;          // Muestras dentro de stext..etext
+    volatile uint32_t samples_outside;  // PC fuera de .text
+    volatile uint32_t sample_rate;      // Muestras por segundo
+    volatile uint16_t buckets[PROFILE_MAX_BUCKETS];  // Saturan en 65535
+} profile_area_t;
+
+// Histogramas log2 de latencia y duración de cada ISR del Nios y de
+// process_audio_data(), en ciclos de 50 MHz.
+#define ISR_STATS_OFFSET      0x1F800     // Relativo a la memoria compartida
+#define ISR_STATS_SIZE        0x800       // 2 KB
+#define ISR_STATS_MAGIC       0x54415453  // "STAT"
+#define ISR_STATS_BINS        32          // Bin i: [2^i, 2^(i+1)) ciclos (bin 0 incluye 0)
+
+#define ISR_SRC_TIMER         0
+#define ISR_SRC_AUDIO         1
+#define ISR_SRC_BUTTONS       2
+#define ISR_SRC_PROCESS       3           // process_audio_data()
+#define ISR_STATS_SOURCES     4
+
+// *** ESTRUCTURAS EXACTAMENTE IGUALES QUE NIOS ***
+typedef struct __attribute__((packed)) {
+    volatile uint32_t count;
+    volatile uint32_t max;              // Peor caso en ciclos
+    volatile uint32_t sum_lo;           // Suma de ciclos (64 bits) para el promedio
+    volatile uint32_t sum_hi;
+    volatile uint32_t bins[ISR_STATS_BINS];
+} isr_histogram_t;
+
+typedef struct __attribute__((packed)) {
+    isr_histogram_t latency;            // Retardo de entrada
+    isr_histogram_t duration;           // Tiempo de ejecución
+} isr_source_stats_t;
+
+typedef struct __attribute__((packed)) {
+    volatile uint32_t magic;            // ISR_STATS_MAGIC cuando el Nios lo inicializó
+    volatile uint32_t ticks_freq;       // Ciclos por segundo
+    volatile uint32_t num_sources;
+    volatile uint32_t reset_request;    // HPS escribe 1, el Nios limpia en el próximo tick
+    isr_source_stats_t sources[ISR_STATS_SOURCES];
+} isr_stats_area_t;
+
+// Imprime el perfil por función. 'symbols_path' es el .objdump o el .elf
+// del firmware del Nios (NULL = solo buckets crudos).
+int profile_dump(volatile profile_area_t *profile, const char *symbols_path);
+
+// Pone a cero los contadores para perfilar una ventana concreta
+void profile_reset(volatile profile_area_t *profile);
+
+// Imprime conteo, promedio, percentiles y máximo de cada histograma
+int isr_stats_dump(volatile isr_stats_area_t *stats);
+
+// Pide al Nios que limpie los histogramas (se aplica en el próximo tick)
+void isr_stats_reset(volatile isr_stats_area_t *stats);
+
+#endif /* NIOS_PROFILE_H */
@@ -0,0 +1,349 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/ioctl.h>
+#include "pcm_ingest.h"
+#include "wav_reader.h"
+
+#define INGEST_HEADER_TIMEOUT_MS   1000    // La cabecera llega junta con el primer write()
+
+// 1 = hay datos o el productor cerró, 0 = timeout, -1 = error
+static int wait_readable(int fd, int timeout_ms) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int r = poll(&pfd, 1, timeout_ms);
+
+    if (r < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    return r > 0;
+}
+
+// Cabecera: todo o nada
+static int read_exact(int fd, uint8_t *buf, uint32_t length) {
+    uint32_t got = 0;
+
+    while (got < length) {
+        if (wait_readable(fd, INGEST_HEADER_TIMEOUT_MS) <= 0) {
+            return -1;
+        }
+        ssize_t n = read(fd, buf + got, length - got);
+        if (n == 0) {
+            return -1;
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -1;
+        }
+        got += n;
+    }
+    return 0;
+}
+
+static void limit_kernel_buffer(pcm_ingest_t *in) {
+    struct stat st;
+
+    in->kernel_buffer = 0;
+    if (fstat(in->fd, &st) != 0) {
+        return;
+    }
+    if (S_ISFIFO(st.st_mode)) {
+        int size = fcntl(in->fd, F_SETPIPE_SZ, INGEST_KERNEL_BUFFER);
+        in->kernel_buffer = (size > 0) ? (uint32_t)size : 0;
+    } else if (S_ISSOCK(st.st_mode)) {
+        int size = INGEST_KERNEL_BUFFER / 2;        // El kernel lo duplica
+        socklen_t length = sizeof(size);
+        setsockopt(in->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        if (getsockopt(in->fd, SOL_SOCKET, SO_RCVBUF, &size, &length) == 0) {
+            in->kernel_buffer = size;
+        }
+    }
+}
+
+// WAV: recorre los chunks hasta 'data' (su tamaño no importa: en un stream
+// suele ser 0 o 0xFFFFFFFF). Sin "RIFF" los 4 bytes ya son audio crudo.
+static int read_header(pcm_ingest_t *in) {
+    uint8_t head[12], chunk[8], body[WAV_FMT_MAX_SIZE], skip[256];
+    wav_format_t fmt;
+    int have_fmt = 0;
+
+    in->sample_rate = in->raw_rate;
+    in->channels = 2;
+    in->bits_per_sample = 16;
+    in->wav = 0;
+    in->carry_len = 0;
+
+    if (read_exact(in->fd, head, 4) != 0) {
+        return -1;
+    }
+    if (memcmp(head, "RIFF", 4) != 0) {
+        memcpy(in->carry, head, 4);
+        in->carry_len = 4;
+        return 0;
+    }
+    if (read_exact(in->fd, head + 4, 8) != 0 || memcmp(head + 8, "WAVE", 4) != 0) {
+        printf("⚠ Ingesta: RIFF sin WAVE\n");
+        return -1;
+    }
+
+    for (;;) {
+        if (read_exact(in->fd, chunk, sizeof(chunk)) != 0) {
+            return -1;
+        }
+        uint32_t size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+        uint64_t remaining = (uint64_t)size + (size & 1);
+
+        if (memcmp(chunk, "data", 4) == 0) {
+            break;
+        }
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint32_t length = (size < sizeof(body)) ? size : sizeof(body);
+            if (read_exact(in->fd, body, length) != 0) {
+                return -1;
+            }
+            if (wav_parse_fmt(body, length, &fmt) != 0) {
+                printf("⚠ Ingesta: WAV no soportado (%s)\n", fmt.error);
+                return -1;
+            }
+            have_fmt = 1;
+            remaining -= length;
+        }
+        while (remaining > 0) {
+            uint32_t n = (remaining < sizeof(skip)) ? (uint32_t)remaining : sizeof(skip);
+            if (read_exact(in->fd, skip, n) != 0) {
+                return -1;
+            }
+            remaining -= n;
+        }
+    }
+
+    if (!have_fmt) {
+        printf("⚠ Ingesta: WAV sin chunk fmt antes de data\n");
+        return -1;
+    }
+    in->sample_rate = fmt.sample_rate;
+    in->channels = fmt.channels;
+    in->bits_per_sample = fmt.bits_per_sample;
+    in->wav = 1;
+    return 0;
+}
+
+// El FIFO queda abierto sin bloquear: poll despierta cuando un productor escribe
+static int open_fifo(pcm_ingest_t *in) {
+    in->listen_fd = open(in->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    return (in->listen_fd >= 0) ? 0 : -1;
+}
+
+static void end_stream(pcm_ingest_t *in) {
+    if (in->fd >= 0 && in->kind != INGEST_STDIN) {
+        close(in->fd);
+    }
+    in->fd = -1;
+    in->carry_len = 0;
+    if (in->kind == INGEST_FIFO && open_fifo(in) != 0) {
+        in->finished = 1;
+    }
+}
+
+int ingest_open(pcm_ingest_t *in, const char *spec, uint32_t raw_rate, uint32_t max_frames) {
+    struct stat st;
+    int saved;
+
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+    in->listen_fd = -1;
+    in->raw_rate = raw_rate;
+    in->max_frames = max_frames;
+    in->staging = malloc((size_t)max_frames * 6);
+    if (!in->staging) {
+        return -1;
+    }
+
+    if (strcmp(spec, "-") == 0) {
+        in->kind = INGEST_STDIN;
+        snprintf(in->path, sizeof(in->path), "stdin");
+        return 0;
+    }
+
+    if (strncmp(spec, "unix:", 5) == 0) {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        in->kind = INGEST_SOCKET;
+        if (strlen(spec + 5) >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            goto fail;
+        }
+        snprintf(in->path, sizeof(in->path), "%s", spec + 5);
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", in->path);
+        if (stat(in->path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(in->path);       // De una ejecución anterior
+        }
+        in->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (in->listen_fd < 0 || bind(in->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            goto fail;
+        }
+        in->bound = 1;
+        if (listen(in->listen_fd, 1) != 0) {
+            goto fail;
+        }
+        return 0;
+    }
+
+    snprintf(in->path, sizeof(in->path), "%s", spec);
+    if (stat(in->path, &st) != 0 && (mkfifo(in->path, 0666) != 0 || stat(in->path, &st) != 0)) {
+        goto fail;
+    }
+    in->kind = S_ISFIFO(st.st_mode) ? INGEST_FIFO : INGEST_FILE;
+    if (in->kind == INGEST_FIFO && open_fifo(in) != 0) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    saved = errno;
+    ingest_close(in);
+    errno = saved;
+    return -1;
+}
+
+int ingest_accept(pcm_ingest_t *in, int timeout_ms) {
+    if (in->fd >= 0) {
+        return 1;
+    }
+    if (in->finished) {
+        return -1;
+    }
+
+    switch (in->kind) {
+        case INGEST_STDIN:
+            in->fd = STDIN_FILENO;
+            in->finished = 1;
+            break;
+        case INGEST_FILE:
+            in->fd = open(in->path, O_RDONLY | O_CLOEXEC);
+            in->finished = 1;
+            break;
+        case INGEST_FIFO:
+            if (wait_readable(in->listen_fd, timeout_ms) <= 0) {
+                return 0;
+            }
+            in->fd = in->listen_fd;
+            in->listen_fd = -1;
+            break;
+        case INGEST_SOCKET:
+            if (wait_readable(in->listen_fd, timeout_ms) <= 0) {
+                return 0;
+            }
+            in->fd = accept4(in->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            break;
+    }
+    if (in->fd < 0) {
+        return in->finished ? -1 : 0;
+    }
+
+    limit_kernel_buffer(in);
+    if (read_header(in) != 0) {
+        end_stream(in);
+        return in->finished ? -1 : 0;
+    }
+    in->streams++;
+    return 1;
+}
+
+int ingest_read(pcm_ingest_t *in, int16_t *out, uint32_t frames, int timeout_ms) {
+    uint32_t frame_bytes = in->bits_per_sample / 8 * in->channels;
+    // 16 bits se lee directo en 'out' (mono se abre después en el lugar)
+    uint8_t *dst = (in->bits_per_sample == 16) ? (uint8_t *)out : in->staging;
+    int eof = 0;
+
+    if (in->fd < 0) {
+        return -1;
+    }
+    if (frames > in->max_frames) {
+        frames = in->max_frames;
+    }
+
+    size_t want = (size_t)frames * frame_bytes;
+    size_t got = in->carry_len;
+    memcpy(dst, in->carry, in->carry_len);
+    in->carry_len = 0;
+
+    while (got < want) {
+        int ready = wait_readable(in->fd, timeout_ms);
+        if (ready <= 0) {
+            eof = (ready < 0);
+            break;
+        }
+        ssize_t n = read(in->fd, dst + got, want - got);
+        if (n == 0) {
+            eof = 1;
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            eof = 1;
+            break;
+        }
+        got += n;
+        in->bytes += n;
+    }
+
+    uint32_t whole = got / frame_bytes;
+    in->carry_len = got % frame_bytes;
+    memcpy(in->carry, dst + (size_t)whole * frame_bytes, in->carry_len);
+
+    if (in->bits_per_sample == 16) {
+        for (uint32_t i = whole; in->channels == 1 && i-- > 0; ) {
+            int16_t sample = out[i];
+            out[2 * i] = sample;
+            out[2 * i + 1] = sample;
+        }
+    } else {
+        for (uint32_t i = 0; i < whole * 2; i++) {
+            const uint8_t *b = in->staging + 3 * (in->channels == 2 ? i : i / 2);
+            out[i] = (int16_t)(b[1] | (b[2] << 8));
+        }
+    }
+
+    if (whole == 0 && eof) {
+        end_stream(in);
+        return -1;
+    }
+    return (int)whole;
+}
+
+uint32_t ingest_queued(const pcm_ingest_t *in) {
+    int queued = 0;
+
+    if (in->fd < 0 || ioctl(in->fd, FIONREAD, &queued) != 0 || queued < 0) {
+        return 0;
+    }
+    return (uint32_t)queued;
+}
+
+void ingest_close(pcm_ingest_t *in) {
+    if (in->fd >= 0 && in->kind != INGEST_STDIN) {
+        close(in->fd);
+    }
+    if (in->listen_fd >= 0) {
+        close(in->listen_fd);
+    }
+    if (in->bound) {
+        unlink(in->path);
+    }
+    free(in->staging);
+    in->staging = NULL;
+    in->bound = 0;
+    in->fd = -1;
+    in->listen_fd = -1;
+}
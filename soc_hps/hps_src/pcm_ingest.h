@@ -0,0 +1,67 @@
+#ifndef PCM_INGEST_H
+#define PCM_INGEST_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Audio de otros procesos del HPS: PCM crudo (16 bits little endian,
+// estéreo, a la tasa pedida) o WAV, desde stdin, un FIFO con nombre o un
+// socket Unix (SOCK_STREAM, un cliente a la vez). Cada productor es un
+// stream: la cabecera RIFF se detecta al conectarse y al cerrar termina.
+//
+// Las muestras se leen directo a los buffers del que llama (una sola copia
+// kernel → DRAM; estéreo de 16 bits ni siquiera pasa por staging). El
+// buffer del kernel se limita a INGEST_KERNEL_BUFFER con F_SETPIPE_SZ o
+// SO_RCVBUF: si el pipeline se llena, el productor se bloquea en write()
+// en lugar de acumular latencia.
+
+#define INGEST_KERNEL_BUFFER    (64 * 1024)
+
+#define INGEST_STDIN    0
+#define INGEST_FIFO     1       // Se crea si no existe
+#define INGEST_SOCKET   2       // "unix:/ruta"
+#define INGEST_FILE     3
+
+typedef struct {
+    int kind;
+    int fd;                     // Stream actual, -1 = esperando productor
+    int listen_fd;              // Socket de escucha o FIFO esperando productor
+    int bound;                  // El socket es nuestro: se borra al cerrar
+    char path[108];             // sun_path
+    uint32_t raw_rate;          // Tasa del PCM crudo
+    uint32_t kernel_buffer;     // Bytes que el kernel retiene como máximo
+
+    // Formato del stream actual
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t bits_per_sample;
+    int wav;
+
+    uint8_t carry[8];           // Bytes leídos de más (frame incompleto o no era RIFF)
+    uint32_t carry_len;
+    uint8_t *staging;           // Mono o 24 bits antes de convertir
+    uint32_t max_frames;
+    int finished;               // stdin/archivo: no habrá más productores
+
+    _Atomic uint32_t streams;   // Los lee control para el reporte
+    _Atomic uint64_t bytes;
+} pcm_ingest_t;
+
+// 'spec': "-" (stdin), "unix:/ruta" o una ruta (FIFO o archivo). Devuelve 0 o -1.
+int ingest_open(pcm_ingest_t *in, const char *spec, uint32_t raw_rate, uint32_t max_frames);
+
+// Espera hasta timeout_ms un productor nuevo y lee su cabecera. 1 = stream
+// listo, 0 = todavía no, -1 = no habrá más.
+int ingest_accept(pcm_ingest_t *in, int timeout_ms);
+
+// Hasta 'frames' frames como estéreo de 16 bits. Devuelve los frames
+// leídos (puede ser menos si el productor no manda más en timeout_ms),
+// 0 si no llegó nada o -1 si el stream terminó.
+int ingest_read(pcm_ingest_t *in, int16_t *out, uint32_t frames, int timeout_ms);
+
+// Bytes esperando en el buffer del kernel (presión del productor)
+uint32_t ingest_queued(const pcm_ingest_t *in);
+
+void ingest_close(pcm_ingest_t *in);
+
+#endif /* PCM_INGEST_H */
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "playlist.h"
+
+int playlist_add(playlist_t *pl, const char *path) {
+    if (pl->count == pl->capacity) {
+        uint32_t capacity = pl->capacity ? pl->capacity * 2 : 64;
+        char **paths = realloc(pl->paths, capacity * sizeof(char*));
+        if (!paths) {
+            return -1;
+        }
+        pl->paths = paths;
+        pl->capacity = capacity;
+    }
+
+    pl->paths[pl->count] = strdup(path);
+    if (!pl->paths[pl->count]) {
+        return -1;
+    }
+    pl->count++;
+    return 0;
+}
+
+int playlist_load_m3u(playlist_t *pl, const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[1024];
+    char full[2048];
+    int added = 0;
+
+    if (!file) {
+        return -1;
+    }
+
+    // Directorio del M3U para las rutas relativas
+    const char *slash = strrchr(path, '/');
+    int dir_len = slash ? (int)(slash - path) + 1 : 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        char *entry = line;
+        size_t len;
+
+        // BOM de M3U8 y espacios alrededor
+        if (added == 0 && memcmp(entry, "\xEF\xBB\xBF", 3) == 0) {
+            entry += 3;
+        }
+        while (*entry == ' ' || *entry == '\t') {
+            entry++;
+        }
+        len = strlen(entry);
+        while (len > 0 && (entry[len - 1] == '\n' || entry[len - 1] == '\r' ||
+                           entry[len - 1] == ' ' || entry[len - 1] == '\t')) {
+            entry[--len] = '\0';
+        }
+        if (len == 0 || entry[0] == '#') {
+            continue;
+        }
+
+        if (entry[0] == '/') {
+            snprintf(full, sizeof(full), "%s", entry);
+        } else {
+            snprintf(full, sizeof(full), "%.*s%s", dir_len, path, entry);
+        }
+        if (playlist_add(pl, full) != 0) {
+            break;
+        }
+        added++;
+    }
+
+    fclose(file);
+    return added;
+}
+
+int playlist_finalize(playlist_t *pl, int shuffle, int repeat) {
+    uint32_t capacity = pl->count + PLAYLIST_SPARE;
+    char **paths = realloc(pl->paths, capacity * sizeof(char*));
+
+    if (!paths) {
+        return -1;
+    }
+    pl->paths = paths;
+    pl->capacity = capacity;
+    pl->repeat = repeat;
+    pl->order = malloc(capacity * sizeof(uint32_t));
+    pl->removed = calloc(capacity, sizeof(uint8_t));
+    if (!pl->order || !pl->removed) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < pl->count; i++) {
+        pl->order[i] = i;
+    }
+    if (shuffle) {
+        srand((unsigned)time(NULL));
+        for (uint32_t i = pl->count; i > 1; i--) {
+            uint32_t j = (uint32_t)rand() % i;
+            uint32_t tmp = pl->order[i - 1];
+            pl->order[i - 1] = pl->order[j];
+            pl->order[j] = tmp;
+        }
+    }
+    return 0;
+}
+
+int playlist_append(playlist_t *pl, const char *path) {
+    uint32_t track = atomic_load_explicit(&pl->count, memory_order_relaxed);
+
+    if (track >= pl->capacity) {
+        return -1;
+    }
+    pl->paths[track] = strdup(path);
+    if (!pl->paths[track]) {
+        return -1;
+    }
+    pl->order[track] = track;
+    atomic_store_explicit(&pl->removed[track], 0, memory_order_relaxed);
+    atomic_store_explicit(&pl->count, track + 1, memory_order_release);
+    return (int)track;
+}
+
+void playlist_set_removed(playlist_t *pl, uint32_t track, int removed) {
+    atomic_store_explicit(&pl->removed[track], removed ? 1 : 0, memory_order_relaxed);
+}
+
+int playlist_find(const playlist_t *pl, const char *path) {
+    uint32_t count = atomic_load_explicit(&pl->count, memory_order_acquire);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(pl->paths[i], path) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int position_live(const playlist_t *pl, uint32_t position) {
+    return !playlist_removed(pl, pl->order[position]);
+}
+
+uint32_t playlist_next(const playlist_t *pl, uint32_t position) {
+    uint32_t count = atomic_load_explicit(&pl->count, memory_order_acquire);
+    uint32_t next = position;
+
+    for (uint32_t i = 0; i < count; i++) {
+        next = (next + 1 < count) ? next + 1 : 0;
+        if (position_live(pl, next)) {
+            return next;
+        }
+    }
+    return (position + 1 < count) ? position + 1 : 0;
+}
+
+uint32_t playlist_prev(const playlist_t *pl, uint32_t position) {
+    uint32_t count = atomic_load_explicit(&pl->count, memory_order_acquire);
+    uint32_t prev = position;
+
+    for (uint32_t i = 0; i < count; i++) {
+        prev = (prev > 0) ? prev - 1 : count - 1;
+        if (position_live(pl, prev)) {
+            return prev;
+        }
+    }
+    return (position > 0) ? position - 1 : count - 1;
+}
+
+int playlist_advance(const playlist_t *pl, uint32_t position) {
+    uint32_t count = atomic_load_explicit(&pl->count, memory_order_acquire);
+
+    switch (pl->repeat) {
+        case PLAYLIST_REPEAT_ONE:
+            return (int)position;
+        case PLAYLIST_REPEAT_NONE:
+            for (uint32_t next = position + 1; next < count; next++) {
+                if (position_live(pl, next)) {
+                    return (int)next;
+                }
+            }
+            return -1;
+        default:
+            return (int)playlist_next(pl, position);
+    }
+}
+
+void playlist_free(playlist_t *pl) {
+    for (uint32_t i = 0; i < pl->count; i++) {
+        free(pl->paths[i]);
+    }
+    free(pl->paths);
+    free(pl->order);
+    free(pl->removed);
+    memset(pl, 0, sizeof(*pl));
+}
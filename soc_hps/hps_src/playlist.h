@@ -0,0 +1,70 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Lista de reproducción: solo rutas, sin abrir archivos (eso lo hace el
+// hilo de lectura bajo demanda, con un caché acotado de descriptores).
+//
+// Las pistas se recorren por posición; order[] traduce posición → pista
+// (identidad o una permutación fija con --shuffle). next/prev/fin de
+// canción son O(1) sobre la posición.
+//
+// Después de playlist_finalize() la lista solo crece por el final (hasta
+// PLAYLIST_SPARE pistas, sin realloc) y las pistas quitadas quedan marcadas:
+// las posiciones no se mueven y los hilos la leen sin locks. Un solo hilo
+// la modifica; count se publica después de escribir la pista nueva.
+
+#define PLAYLIST_REPEAT_NONE  0     // Al terminar la última pista no sigue
+#define PLAYLIST_REPEAT_ALL   1     // Vuelve a la primera (comportamiento histórico)
+#define PLAYLIST_REPEAT_ONE   2     // Repite la pista actual
+
+#define PLAYLIST_SPARE        1024  // Lugar reservado para playlist_append()
+
+typedef struct {
+    char **paths;
+    _Atomic uint32_t count;
+    uint32_t capacity;
+    uint32_t *order;            // Posición → índice en paths
+    _Atomic uint8_t *removed;   // Por pista: el archivo ya no está
+    int repeat;
+} playlist_t;
+
+int playlist_add(playlist_t *pl, const char *path);
+
+// M3U/M3U8: una ruta por línea; '#' y líneas vacías se ignoran. Las rutas
+// relativas se resuelven contra el directorio del archivo. Devuelve las
+// pistas agregadas o -1 si no se pudo abrir.
+int playlist_load_m3u(playlist_t *pl, const char *path);
+
+// Arma order[] (Fisher-Yates si shuffle) y fija el modo de repetición
+int playlist_finalize(playlist_t *pl, int shuffle, int repeat);
+
+static inline uint32_t playlist_track(const playlist_t *pl, uint32_t position) {
+    return pl->order[position];
+}
+
+static inline int playlist_removed(const playlist_t *pl, uint32_t track) {
+    return atomic_load_explicit(&pl->removed[track], memory_order_relaxed);
+}
+
+// Después de finalize: la pista nueva va al final del orden (también con
+// shuffle). Devuelve su índice o -1 si no queda lugar.
+int playlist_append(playlist_t *pl, const char *path);
+void playlist_set_removed(playlist_t *pl, uint32_t track, int removed);
+
+// Índice de la pista con esa ruta exacta o -1
+int playlist_find(const playlist_t *pl, const char *path);
+
+// Botones: siempre circulares. Saltan las pistas quitadas (salvo que lo
+// estén todas).
+uint32_t playlist_next(const playlist_t *pl, uint32_t position);
+uint32_t playlist_prev(const playlist_t *pl, uint32_t position);
+
+// Fin de canción según el modo de repetición: -1 = terminar
+int playlist_advance(const playlist_t *pl, uint32_t position);
+
+void playlist_free(playlist_t *pl);
+
+#endif /* PLAYLIST_H */
@@ -0,0 +1,47 @@
+#include <stddef.h>
+#include "spsc_queue.h"
+
+void spsc_init(spsc_queue_t *q) {
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+int spsc_push(spsc_queue_t *q, void *item) {
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (tail - head >= SPSC_QUEUE_CAPACITY) {
+        return 0;
+    }
+    q->items[tail & (SPSC_QUEUE_CAPACITY - 1)] = item;
+    // release: el consumidor ve el elemento (y lo que apunta) antes que el nuevo tail
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+void *spsc_peek(spsc_queue_t *q) {
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head == tail) {
+        return NULL;
+    }
+    return q->items[head & (SPSC_QUEUE_CAPACITY - 1)];
+}
+
+void *spsc_pop(spsc_queue_t *q) {
+    void *item = spsc_peek(q);
+
+    if (item) {
+        uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+        // release: el productor no reutiliza la posición hasta que terminamos de leerla
+        atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    }
+    return item;
+}
+
+uint32_t spsc_depth(spsc_queue_t *q) {
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    return tail - head;
+}
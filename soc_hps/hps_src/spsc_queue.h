@@ -0,0 +1,33 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Cola acotada de punteros entre dos hilos (un productor, un consumidor)
+// sin locks. head y tail son contadores libres: la ocupación es tail - head
+// y cada uno lo escribe un solo hilo. Van en líneas de caché distintas para
+// que productor y consumidor no se invaliden mutuamente.
+
+#define SPSC_QUEUE_CAPACITY   8           // Potencia de 2
+#define SPSC_CACHE_LINE       64
+
+typedef struct {
+    void *items[SPSC_QUEUE_CAPACITY];
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint32_t head;   // Próximo a leer (consumidor)
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint32_t tail;   // Próximo a escribir (productor)
+} spsc_queue_t;
+
+void spsc_init(spsc_queue_t *q);
+
+// Productor: devuelve 0 si la cola está llena
+int spsc_push(spsc_queue_t *q, void *item);
+
+// Consumidor: NULL si la cola está vacía. peek no retira el elemento.
+void *spsc_peek(spsc_queue_t *q);
+void *spsc_pop(spsc_queue_t *q);
+
+// Ocupación aproximada (cualquier hilo)
+uint32_t spsc_depth(spsc_queue_t *q);
+
+#endif /* SPSC_QUEUE_H */
@@ -0,0 +1,117 @@
+#include <string.h>
+#include "wav_reader.h"
+
+static uint32_t get_le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return get_le16(p) | (get_le16(p + 2) << 16);
+}
+
+// KSDATAFORMAT_SUBTYPE_PCM sin los 2 primeros bytes (el código de formato)
+static const uint8_t pcm_guid_tail[14] = {
+    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+int wav_parse_fmt(const uint8_t *body, uint32_t length, wav_format_t *fmt) {
+    if (length < 16) {
+        fmt->error = "chunk fmt incompleto";
+        return -1;
+    }
+
+    uint32_t tag = get_le16(body);
+    fmt->channels = get_le16(body + 2);
+    fmt->sample_rate = get_le32(body + 4);
+    fmt->block_align = get_le16(body + 12);
+    fmt->bits_per_sample = get_le16(body + 14);
+
+    // Extensible: el formato real está en el GUID del subformato
+    if (tag == WAV_FORMAT_EXTENSIBLE) {
+        if (length < 40 || get_le16(body + 16) < 22 || memcmp(body + 26, pcm_guid_tail, sizeof(pcm_guid_tail)) != 0) {
+            fmt->error = "extensible con subformato no PCM";
+            return -1;
+        }
+        tag = get_le16(body + 24);
+    }
+
+    if (tag != WAV_FORMAT_PCM) {
+        fmt->error = "formato no PCM (comprimido o flotante)";
+        return -1;
+    }
+    if (fmt->channels < 1 || fmt->channels > 2) {
+        fmt->error = "solo mono o estéreo";
+        return -1;
+    }
+    if (fmt->bits_per_sample != 16 && fmt->bits_per_sample != 24) {
+        fmt->error = "solo 16 o 24 bits";
+        return -1;
+    }
+    if (fmt->block_align != fmt->channels * fmt->bits_per_sample / 8 || fmt->sample_rate == 0) {
+        fmt->error = "block_align o tasa inválidos";
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_fmt(FILE *file, uint32_t size, wav_format_t *fmt) {
+    uint8_t body[WAV_FMT_MAX_SIZE];
+    uint32_t length = (size < sizeof(body)) ? size : sizeof(body);
+
+    if (fread(body, 1, length, file) != length) {
+        fmt->error = "chunk fmt incompleto";
+        return -1;
+    }
+    return wav_parse_fmt(body, length, fmt);
+}
+
+int wav_parse(FILE *file, uint64_t file_size, wav_format_t *fmt) {
+    uint8_t header[12], chunk[8];
+    uint64_t offset = sizeof(header);
+    int have_fmt = 0, have_data = 0;
+
+    memset(fmt, 0, sizeof(*fmt));
+
+    if (fseek(file, 0, SEEK_SET) != 0 || fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fmt->error = "no es RIFF/WAVE";
+        return -1;
+    }
+
+    while (offset + sizeof(chunk) <= file_size && !(have_fmt && have_data)) {
+        if (fseek(file, (long)offset, SEEK_SET) != 0 || fread(chunk, 1, sizeof(chunk), file) != sizeof(chunk)) {
+            break;
+        }
+        uint64_t body = offset + sizeof(chunk);
+        uint64_t size = get_le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (parse_fmt(file, (uint32_t)size, fmt) != 0) {
+                return -1;
+            }
+            have_fmt = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            // Cabecera sin corregir (grabación cortada): hasta el final del archivo
+            if (size == 0 || body + size > file_size) {
+                size = file_size - body;
+            }
+            fmt->data_offset = (uint32_t)body;
+            fmt->data_bytes = size;
+            have_data = 1;
+        }
+
+        // Los chunks de tamaño impar llevan un byte de relleno
+        offset = body + size + (size & 1);
+    }
+
+    if (!have_fmt) {
+        fmt->error = "sin chunk fmt";
+        return -1;
+    }
+    if (!have_data) {
+        fmt->error = "sin chunk data";
+        return -1;
+    }
+    fmt->total_frames = fmt->data_bytes / fmt->block_align;
+    return 0;
+}
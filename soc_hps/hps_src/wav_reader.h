@@ -0,0 +1,37 @@
+#ifndef WAV_READER_H
+#define WAV_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Lectura de la estructura RIFF/WAVE: recorre los chunks (con el byte de
+// relleno de los de tamaño impar) hasta encontrar 'fmt ' y 'data', saltando
+// LIST, fact, JUNK, bext, etc. Acepta PCM entero de 16 o 24 bits, mono o
+// estéreo, también como WAVE_FORMAT_EXTENSIBLE.
+//
+// Los frames salen del tamaño del chunk data (recortado al archivo si la
+// cabecera quedó sin corregir): lo que viene después no es audio.
+
+#define WAV_FORMAT_PCM          0x0001
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE
+#define WAV_FMT_MAX_SIZE        40      // fmt extensible completo
+
+typedef struct {
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t bits_per_sample;   // Del contenedor (16 o 24)
+    uint32_t block_align;       // Bytes por frame
+    uint32_t data_offset;       // Inicio de las muestras en el archivo
+    uint64_t data_bytes;
+    uint64_t total_frames;
+    const char *error;          // Motivo si wav_parse() falla
+} wav_format_t;
+
+// Devuelve 0 o -1 (no es un WAV soportado; ver fmt->error)
+int wav_parse(FILE *file, uint64_t file_size, wav_format_t *fmt);
+
+// Solo el cuerpo de un chunk fmt (hasta WAV_FMT_MAX_SIZE bytes), para
+// streams que no se pueden recorrer con fseek
+int wav_parse_fmt(const uint8_t *body, uint32_t length, wav_format_t *fmt);
+
+#endif /* WAV_READER_H */
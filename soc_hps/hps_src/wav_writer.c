@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "wav_writer.h"
+
+static void put_le16(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, v & 0xFFFF);
+    put_le16(p + 2, v >> 16);
+}
+
+// RIFF + fmt (36 bytes) + JUNK de relleno + cabecera de data = 4096 bytes
+static void build_header(const wav_writer_t *wav, uint8_t *header, uint32_t data_bytes) {
+    uint32_t block_align = wav->channels * 2;
+    uint32_t junk_size = WAV_HEADER_SIZE - 12 - 24 - 8 - 8;
+
+    memset(header, 0, WAV_HEADER_SIZE);
+    memcpy(header, "RIFF", 4);
+    put_le32(header + 4, WAV_HEADER_SIZE - 8 + data_bytes);
+    memcpy(header + 8, "WAVE", 4);
+
+    memcpy(header + 12, "fmt ", 4);
+    put_le32(header + 16, 16);
+    put_le16(header + 20, 1);                      // PCM
+    put_le16(header + 22, wav->channels);
+    put_le32(header + 24, wav->sample_rate);
+    put_le32(header + 28, wav->sample_rate * block_align);
+    put_le16(header + 32, block_align);
+    put_le16(header + 34, 16);
+
+    memcpy(header + 36, "JUNK", 4);
+    put_le32(header + 40, junk_size);
+
+    memcpy(header + WAV_HEADER_SIZE - 8, "data", 4);
+    put_le32(header + WAV_HEADER_SIZE - 4, data_bytes);
+}
+
+static int write_all(int fd, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("ERROR: Escritura WAV falló: %s\n", strerror(errno));
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int open_file(wav_writer_t *wav) {
+    char path[300];
+
+    if (wav->file_index == 0) {
+        snprintf(path, sizeof(path), "%s", wav->base_path);
+    } else {
+        // grabacion.wav -> grabacion_001.wav
+        const char *dot = strrchr(wav->base_path, '.');
+        int stem = dot ? (int)(dot - wav->base_path) : (int)strlen(wav->base_path);
+        snprintf(path, sizeof(path), "%.*s_%03u%s", stem, wav->base_path,
+                 wav->file_index, dot ? dot : "");
+    }
+
+    wav->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (wav->fd < 0) {
+        printf("ERROR: No se pudo crear %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    // Cabecera provisional con tamaños en 0; se corrige al cerrar
+    uint8_t *header = wav->buffer;
+    build_header(wav, header, 0);
+    if (write_all(wav->fd, header, WAV_HEADER_SIZE) != 0) {
+        close(wav->fd);
+        wav->fd = -1;
+        return -1;
+    }
+
+    wav->data_bytes = 0;
+    printf("✓ Grabando en %s\n", path);
+    return 0;
+}
+
+static int flush_buffer(wav_writer_t *wav) {
+    if (wav->buffered == 0) {
+        return 0;
+    }
+    if (write_all(wav->fd, wav->buffer, wav->buffered) != 0) {
+        return -1;
+    }
+    wav->data_bytes += wav->buffered;
+    wav->buffered = 0;
+    return 0;
+}
+
+static int close_file(wav_writer_t *wav) {
+    uint8_t header[WAV_HEADER_SIZE];
+    int result = flush_buffer(wav);
+
+    build_header(wav, header, (uint32_t)wav->data_bytes);
+    if (pwrite(wav->fd, header, WAV_HEADER_SIZE, 0) != WAV_HEADER_SIZE) {
+        printf("ERROR: No se pudo corregir la cabecera WAV: %s\n", strerror(errno));
+        result = -1;
+    }
+    if (close(wav->fd) != 0) {
+        result = -1;
+    }
+    wav->fd = -1;
+    return result;
+}
+
+int wav_writer_open(wav_writer_t *wav, const char *path, uint32_t sample_rate, uint32_t channels) {
+    memset(wav, 0, sizeof(*wav));
+    wav->fd = -1;
+    wav->sample_rate = sample_rate;
+    wav->channels = channels;
+    snprintf(wav->base_path, sizeof(wav->base_path), "%s", path);
+
+    if (posix_memalign((void **)&wav->buffer, WAV_HEADER_SIZE, WAV_WRITE_SIZE) != 0) {
+        printf("ERROR: Sin memoria para el buffer WAV\n");
+        return -1;
+    }
+
+    if (open_file(wav) != 0) {
+        free(wav->buffer);
+        wav->buffer = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int wav_writer_write(wav_writer_t *wav, const int16_t *samples, uint32_t frames) {
+    const uint8_t *data = (const uint8_t *)samples;
+    uint32_t bytes = frames * wav->channels * 2;
+
+    wav->total_frames += frames;
+
+    while (bytes > 0) {
+        uint32_t n = WAV_WRITE_SIZE - wav->buffered;
+        if (n > bytes) {
+            n = bytes;
+        }
+        memcpy(wav->buffer + wav->buffered, data, n);
+        wav->buffered += n;
+        data += n;
+        bytes -= n;
+
+        if (wav->buffered == WAV_WRITE_SIZE) {
+            if (flush_buffer(wav) != 0) {
+                return -1;
+            }
+            if (wav->data_bytes >= WAV_MAX_DATA_BYTES) {
+                if (close_file(wav) != 0) {
+                    return -1;
+                }
+                wav->file_index++;
+                if (open_file(wav) != 0) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int wav_writer_close(wav_writer_t *wav) {
+    int result = 0;
+
+    if (wav->fd >= 0) {
+        result = close_file(wav);
+    }
+    free(wav->buffer);
+    wav->buffer = NULL;
+    return result;
+}
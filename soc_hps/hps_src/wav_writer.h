@@ -0,0 +1,36 @@
+#ifndef WAV_WRITER_H
+#define WAV_WRITER_H
+
+#include <stdint.h>
+
+// Escritura de WAV PCM 16 bits pensada para la SD: la cabecera ocupa un
+// bloque de 4 KB completo (relleno con un chunk JUNK) para que los datos
+// empiecen alineados, y se escribe al disco en bloques de WAV_WRITE_SIZE.
+// Los tamaños de la cabecera se corrigen al cerrar cada archivo.
+
+#define WAV_HEADER_SIZE     4096
+#define WAV_WRITE_SIZE      (64 * 1024)
+// Rotar antes del límite de 4 GB de RIFF (y de FAT32)
+#define WAV_MAX_DATA_BYTES  (0xFFFFFFFFu - WAV_HEADER_SIZE - WAV_WRITE_SIZE)
+
+typedef struct {
+    int fd;
+    char base_path[256];       // Ruta pedida; las rotaciones agregan _NNN
+    uint32_t file_index;       // 0 = ruta original
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint8_t *buffer;           // Alineado a 4 KB, WAV_WRITE_SIZE bytes
+    uint32_t buffered;         // Bytes pendientes en buffer
+    uint64_t data_bytes;       // Bytes de audio en el archivo actual
+    uint64_t total_frames;     // Frames escritos en todos los archivos
+} wav_writer_t;
+
+int wav_writer_open(wav_writer_t *wav, const char *path, uint32_t sample_rate, uint32_t channels);
+
+// Agrega 'frames' frames intercalados de 16 bits. Devuelve 0 o -1 en error.
+int wav_writer_write(wav_writer_t *wav, const int16_t *samples, uint32_t frames);
+
+// Vacía el buffer, corrige la cabecera y cierra
+int wav_writer_close(wav_writer_t *wav);
+
+#endif /* WAV_WRITER_H */
@@ -0,0 +1,702 @@
+// Emulador de host del Nios: corre hello_world_small.c sin cambios en Linux
+// con un modelo de los periféricos que usa (timer, PIO de botones, displays
+// y FIFOs del codec). La memoria compartida es un archivo que también mapea
+// hps_audio_loader con FPGA_AUDIO_EMU=<archivo>.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include "system.h"
+#include "io.h"
+#include "sys/alt_irq.h"
+#include "sys/alt_stdio.h"
+#include "altera_up_avalon_audio.h"
+#include "altera_up_avalon_audio_and_video_config.h"
+
+#define EMU_SHM_DEFAULT     "/tmp/fpga_audio_emu.shm"
+#define EMU_IRQ_TICK_US     1000        // Resolución del despacho de IRQs
+#define EMU_SAMPLE_RATE     48000       // Tasa del codec al arrancar
+#define EMU_FIFO_DEPTH      128
+#define EMU_MAX_IRQS        32
+#define EMU_KEY_PRESS_NS    50000000LL  // Tecla "apretada" 50 ms
+#define EMU_LOOPBACK_MAX    4096        // Retardo máximo del loopback (frames)
+
+// Registros del timer (altera_avalon_timer_regs.h)
+#define TIMER_REG_STATUS    0
+#define TIMER_REG_CONTROL   1
+#define TIMER_REG_SNAPL     4
+#define TIMER_REG_SNAPH     5
+#define TIMER_STATUS_TO     0x1
+#define TIMER_CONTROL_ITO   0x1
+#define TIMER_CONTROL_START 0x4
+
+// Registros del core de audio (altera_up_avalon_audio_regs.h)
+#define AUDIO_REG_FIFOSPACE 1
+#define AUDIO_REG_LEFTDATA  2
+#define AUDIO_REG_RIGHTDATA 3
+
+// Registros del PIO (altera_avalon_pio_regs.h)
+#define PIO_REG_DATA        0
+#define PIO_REG_IRQ_MASK    2
+#define PIO_REG_EDGE_CAP    3
+
+int nios_main(void);
+
+// --- Fuente de entrada del codec ---
+typedef enum { INPUT_RAMP, INPUT_SINE, INPUT_SILENCE, INPUT_LOOPBACK } input_source_t;
+
+static input_source_t input_source = INPUT_RAMP;
+
+// Loopback: la entrada es la salida de hace loopback_delay frames
+// (modela DAC + cable + ADC)
+static uint32_t loopback_delay = 0;
+static uint32_t loopback_history[EMU_LOOPBACK_MAX][2];
+static int64_t t0_ns;
+
+// Reloj del hardware emulado: CLOCK_MONOTONIC, o con --clock cpu el tiempo de
+// CPU del hilo del firmware (el Nios tiene su núcleo; en un host con pocos
+// CPUs así las pausas del planificador no se ven como desbordes del codec)
+static clockid_t hw_clock = CLOCK_MONOTONIC;
+
+// --- IRQs ---
+static alt_isr_func irq_handlers[EMU_MAX_IRQS];
+static void *irq_contexts[EMU_MAX_IRQS];
+static volatile uint32_t interrupted_pc;
+
+// --- Timer ---
+static uint32_t timer_control;
+static uint32_t timer_status;
+static uint64_t timer_periods_seen;
+static uint32_t timer_snapshot;
+static uint32_t profile_timer_control;
+static uint32_t profile_timer_status;
+
+// --- Botones (activos en bajo) ---
+static uint32_t buttons_irq_mask;
+static volatile uint32_t buttons_edge_cap;
+static int64_t buttons_press_until[3];
+
+// --- Displays ---
+static uint32_t seven_segments = 0xFFFFFFFF;
+
+// --- FIFOs del codec ---
+typedef struct {
+    uint32_t data[EMU_FIFO_DEPTH];
+    uint32_t head;
+    uint32_t count;
+} emu_fifo_t;
+
+static emu_fifo_t read_fifo[2], write_fifo[2];
+static uint32_t codec_rate = EMU_SAMPLE_RATE;
+static int64_t codec_rate_since_ns;         // Instante del último cambio de tasa
+static uint64_t codec_rate_since_frames;    // Frames procesados hasta ese instante
+static uint32_t codec_active = 1;
+static uint32_t codec_sampling;             // Último valor escrito en R8
+static uint64_t audio_frames_done;
+static uint64_t input_frames;
+static uint64_t output_frames;
+static uint64_t underruns;
+static uint64_t overflows;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(hw_clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Las funciones del modelo no son reentrantes: el código "principal" del
+// firmware las llama con SIGALRM bloqueada, como con IRQs deshabilitadas
+static int block_irqs(sigset_t *old) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    return pthread_sigmask(SIG_BLOCK, &set, old);
+}
+
+static void restore_irqs(const sigset_t *old) {
+    pthread_sigmask(SIG_SETMASK, old, NULL);
+}
+
+static void fifo_push(emu_fifo_t *fifo, uint32_t value) {
+    fifo->data[(fifo->head + fifo->count) % EMU_FIFO_DEPTH] = value;
+    fifo->count++;
+}
+
+static uint32_t fifo_pop(emu_fifo_t *fifo) {
+    uint32_t value = fifo->data[fifo->head];
+    fifo->head = (fifo->head + 1) % EMU_FIFO_DEPTH;
+    fifo->count--;
+    return value;
+}
+
+// Muestra de 16 bits -> palabra de 24 bits del codec
+static uint32_t to_codec_word(int16_t sample) {
+    return ((uint32_t)(uint16_t)sample << 8) & 0xFFFFFF;
+}
+
+// Rampa: L cuenta de a 1, R = ~L (permite detectar frames perdidos o cruzados)
+static void input_sample(uint64_t n, int16_t *left, int16_t *right) {
+    switch (input_source) {
+    case INPUT_LOOPBACK:        // Lo resuelve audio_advance con palabras de 24 bits
+        *left = *right = 0;
+        break;
+    case INPUT_RAMP:
+        *left = (int16_t)n;
+        *right = (int16_t)~n;
+        break;
+    case INPUT_SINE:
+        *left = (int16_t)(16384 * sin(2 * M_PI * 1000.0 * n / codec_rate));
+        *right = *left;
+        break;
+    default:
+        *left = *right = 0;
+        break;
+    }
+}
+
+// Avanza el codec hasta el instante actual: por cada frame consume un frame
+// de los FIFOs de salida y produce uno en los de entrada
+static void audio_advance(void) {
+    uint64_t due = codec_rate_since_frames +
+                   (uint64_t)(now_ns() - codec_rate_since_ns) * codec_rate / 1000000000ULL;
+
+    if (!codec_active) {
+        return;     // Interfaz digital desactivada: no hay LRCK
+    }
+
+    for (; audio_frames_done < due; audio_frames_done++) {
+        uint32_t *played = loopback_history[audio_frames_done % EMU_LOOPBACK_MAX];
+
+        if (write_fifo[0].count > 0 && write_fifo[1].count > 0) {
+            played[0] = fifo_pop(&write_fifo[0]);
+            played[1] = fifo_pop(&write_fifo[1]);
+            output_frames++;
+        } else {
+            played[0] = played[1] = 0;
+            if (output_frames > 0) {
+                underruns++;
+            }
+        }
+
+        if (read_fifo[0].count < EMU_FIFO_DEPTH && read_fifo[1].count < EMU_FIFO_DEPTH) {
+            if (input_source == INPUT_LOOPBACK) {
+                uint32_t *heard = loopback_history[(audio_frames_done - loopback_delay) % EMU_LOOPBACK_MAX];
+                int delayed = audio_frames_done >= loopback_delay;
+                fifo_push(&read_fifo[0], delayed ? heard[0] : 0);
+                fifo_push(&read_fifo[1], delayed ? heard[1] : 0);
+            } else {
+                int16_t left, right;
+                input_sample(input_frames, &left, &right);
+                fifo_push(&read_fifo[0], to_codec_word(left));
+                fifo_push(&read_fifo[1], to_codec_word(right));
+            }
+        } else {
+            overflows++;
+        }
+        input_frames++;
+    }
+}
+
+// Contador del timer de período fijo (TIMER_LOAD_VALUE del firmware)
+static uint32_t timer_counter(void) {
+    uint64_t ticks = (uint64_t)(now_ns() - t0_ns) * TIMER_FREQ / 1000000000ULL;
+    uint64_t period = (uint64_t)TIMER_FREQ * TIMER_PERIOD / 1000;
+    uint64_t periods = ticks / period;
+
+    if (periods > timer_periods_seen) {
+        timer_periods_seen = periods;
+        timer_status |= TIMER_STATUS_TO;
+    }
+    return (uint32_t)(period - 1 - ticks % period);
+}
+
+static uint32_t buttons_data(void) {
+    int64_t now = now_ns();
+    uint32_t data = 0x7;
+
+    for (int i = 0; i < 3; i++) {
+        if (now < buttons_press_until[i]) {
+            data &= ~(1u << i);
+        }
+    }
+    return data;
+}
+
+static void seven_segments_print(uint32_t value) {
+    static const unsigned char patterns[10] = {
+        0x40, 0x79, 0x24, 0x30, 0x19, 0x12, 0x02, 0x78, 0x00, 0x10
+    };
+    char digits[4];
+
+    for (int d = 0; d < 4; d++) {
+        uint32_t segments = (value >> (21 - 7 * d)) & 0x7F;
+        digits[d] = '?';
+        for (int i = 0; i < 10; i++) {
+            if (patterns[i] == segments) {
+                digits[d] = '0' + i;
+            }
+        }
+    }
+    printf("[EMU] Display: %c%c:%c%c\n", digits[0], digits[1], digits[2], digits[3]);
+}
+
+// --- io.h ---
+
+alt_u32 emu_iord(alt_u32 base, alt_u32 regnum) {
+    sigset_t old;
+    alt_u32 value = 0;
+
+    block_irqs(&old);
+    if (base == TIMER_BASE) {
+        timer_counter();
+        if (regnum == TIMER_REG_STATUS) {
+            value = timer_status | ((timer_control & TIMER_CONTROL_START) ? 0x2 : 0);
+        } else if (regnum == TIMER_REG_CONTROL) {
+            value = timer_control;
+        } else if (regnum == TIMER_REG_SNAPL) {
+            value = timer_snapshot & 0xFFFF;
+        } else if (regnum == TIMER_REG_SNAPH) {
+            value = timer_snapshot >> 16;
+        }
+    } else if (base == PROFILE_TIMER_BASE) {
+        if (regnum == TIMER_REG_STATUS) {
+            value = profile_timer_status |
+                    ((profile_timer_control & TIMER_CONTROL_START) ? 0x2 : 0);
+        } else if (regnum == TIMER_REG_CONTROL) {
+            value = profile_timer_control;
+        }
+    } else if (base == AUDIO_BASE) {
+        audio_advance();
+        if (regnum == AUDIO_REG_FIFOSPACE) {
+            value = ((EMU_FIFO_DEPTH - write_fifo[0].count) << 24) |
+                    ((EMU_FIFO_DEPTH - write_fifo[1].count) << 16) |
+                    (read_fifo[0].count << 8) | read_fifo[1].count;
+        } else if (regnum == AUDIO_REG_LEFTDATA || regnum == AUDIO_REG_RIGHTDATA) {
+            emu_fifo_t *fifo = &read_fifo[regnum - AUDIO_REG_LEFTDATA];
+            value = fifo->count ? fifo_pop(fifo) : 0;
+        }
+    } else if (base == BUTTONS_BASE) {
+        if (regnum == PIO_REG_DATA) {
+            value = buttons_data();
+        } else if (regnum == PIO_REG_IRQ_MASK) {
+            value = buttons_irq_mask;
+        } else if (regnum == PIO_REG_EDGE_CAP) {
+            value = buttons_edge_cap;
+        }
+    }
+    restore_irqs(&old);
+    return value;
+}
+
+void emu_iowr(alt_u32 base, alt_u32 regnum, alt_u32 data) {
+    sigset_t old;
+
+    block_irqs(&old);
+    if (base == TIMER_BASE) {
+        timer_counter();
+        if (regnum == TIMER_REG_STATUS) {
+            timer_status &= ~TIMER_STATUS_TO;
+        } else if (regnum == TIMER_REG_CONTROL) {
+            timer_control = data;
+        } else if (regnum == TIMER_REG_SNAPL || regnum == TIMER_REG_SNAPH) {
+            timer_snapshot = timer_counter();
+        }
+    } else if (base == PROFILE_TIMER_BASE) {
+        if (regnum == TIMER_REG_STATUS) {
+            profile_timer_status &= ~TIMER_STATUS_TO;
+        } else if (regnum == TIMER_REG_CONTROL) {
+            profile_timer_control = data;
+        }
+    } else if (base == AUDIO_BASE) {
+        if (regnum == AUDIO_REG_LEFTDATA || regnum == AUDIO_REG_RIGHTDATA) {
+            emu_fifo_t *fifo = &write_fifo[regnum - AUDIO_REG_LEFTDATA];
+            audio_advance();
+            if (fifo->count < EMU_FIFO_DEPTH) {
+                fifo_push(fifo, data);
+            }
+        }
+    } else if (base == BUTTONS_BASE) {
+        if (regnum == PIO_REG_IRQ_MASK) {
+            buttons_irq_mask = data;
+        } else if (regnum == PIO_REG_EDGE_CAP) {
+            __atomic_and_fetch(&buttons_edge_cap, ~data, __ATOMIC_SEQ_CST);
+        }
+    } else if (base == SEVEN_SEGMENTS_BASE && regnum == 0) {
+        if (data != seven_segments) {
+            seven_segments = data;
+            seven_segments_print(data);
+        }
+    }
+    restore_irqs(&old);
+}
+
+// --- sys/alt_irq.h ---
+
+int alt_irq_register(alt_u32 id, void *context, alt_isr_func handler) {
+    if (id >= EMU_MAX_IRQS) {
+        return -1;
+    }
+    irq_contexts[id] = context;
+    irq_handlers[id] = handler;
+    return 0;
+}
+
+alt_irq_context alt_irq_disable_all(void) {
+    sigset_t old;
+    block_irqs(&old);
+    return !sigismember(&old, SIGALRM);
+}
+
+void alt_irq_enable_all(alt_irq_context context) {
+    if (context) {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGALRM);
+        pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+    }
+}
+
+uint32_t emu_interrupted_pc(void) {
+    return interrupted_pc;
+}
+
+static void irq_dispatch(int sig, siginfo_t *info, void *ucontext) {
+    (void)sig;
+    (void)info;
+#ifdef REG_RIP
+    interrupted_pc = (uint32_t)((ucontext_t *)ucontext)->uc_mcontext.gregs[REG_RIP];
+#else
+    (void)ucontext;
+#endif
+
+    audio_advance();
+    timer_counter();
+
+    if ((timer_control & TIMER_CONTROL_ITO) && (timer_status & TIMER_STATUS_TO) &&
+        irq_handlers[TIMER_IRQ]) {
+        irq_handlers[TIMER_IRQ](irq_contexts[TIMER_IRQ], TIMER_IRQ);
+    }
+    if (profile_timer_control & TIMER_CONTROL_START) {
+        profile_timer_status |= TIMER_STATUS_TO;
+    }
+    if ((profile_timer_control & TIMER_CONTROL_ITO) && (profile_timer_status & TIMER_STATUS_TO) &&
+        irq_handlers[PROFILE_TIMER_IRQ]) {
+        irq_handlers[PROFILE_TIMER_IRQ](irq_contexts[PROFILE_TIMER_IRQ], PROFILE_TIMER_IRQ);
+    }
+    if ((buttons_edge_cap & buttons_irq_mask) && irq_handlers[BUTTONS_IRQ]) {
+        irq_handlers[BUTTONS_IRQ](irq_contexts[BUTTONS_IRQ], BUTTONS_IRQ);
+    }
+}
+
+// --- sys/alt_stdio.h ---
+
+void alt_printf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+int alt_putstr(const char *str) {
+    return fputs(str, stdout);
+}
+
+// --- altera_up_avalon_audio.h ---
+
+alt_up_audio_dev *alt_up_audio_open_dev(const char *name) {
+    static alt_up_audio_dev dev;
+    (void)name;
+    return &dev;
+}
+
+void alt_up_audio_reset_audio_core(alt_up_audio_dev *audio) {
+    sigset_t old;
+    (void)audio;
+
+    block_irqs(&old);
+    audio_advance();
+    memset(read_fifo, 0, sizeof(read_fifo));
+    memset(write_fifo, 0, sizeof(write_fifo));
+    restore_irqs(&old);
+}
+
+unsigned int alt_up_audio_read_fifo_avail(alt_up_audio_dev *audio, int channel) {
+    sigset_t old;
+    unsigned int avail;
+    (void)audio;
+
+    block_irqs(&old);
+    audio_advance();
+    avail = read_fifo[channel & 1].count;
+    restore_irqs(&old);
+    return avail;
+}
+
+unsigned int alt_up_audio_write_fifo_space(alt_up_audio_dev *audio, int channel) {
+    sigset_t old;
+    unsigned int space;
+    (void)audio;
+
+    block_irqs(&old);
+    audio_advance();
+    space = EMU_FIFO_DEPTH - write_fifo[channel & 1].count;
+    restore_irqs(&old);
+    return space;
+}
+
+int alt_up_audio_read_fifo(alt_up_audio_dev *audio, unsigned int *buf, int len, int channel) {
+    sigset_t old;
+    int count = 0;
+    (void)audio;
+
+    block_irqs(&old);
+    audio_advance();
+    while (count < len && read_fifo[channel & 1].count > 0) {
+        buf[count++] = fifo_pop(&read_fifo[channel & 1]);
+    }
+    restore_irqs(&old);
+    return count;
+}
+
+int alt_up_audio_write_fifo(alt_up_audio_dev *audio, unsigned int *buf, int len, int channel) {
+    sigset_t old;
+    int count = 0;
+    (void)audio;
+
+    block_irqs(&old);
+    audio_advance();
+    while (count < len && write_fifo[channel & 1].count < EMU_FIFO_DEPTH) {
+        fifo_push(&write_fifo[channel & 1], buf[count++]);
+    }
+    restore_irqs(&old);
+    return count;
+}
+
+// --- altera_up_avalon_audio_and_video_config.h ---
+
+alt_up_av_config_dev *alt_up_av_config_open_dev(const char *name) {
+    static alt_up_av_config_dev dev;
+    (void)name;
+    return &dev;
+}
+
+int alt_up_av_config_read_ready(alt_up_av_config_dev *av_config) {
+    (void)av_config;
+    return 1;
+}
+
+// R8 con MCLK = 12.288 MHz (SR[3:0] en los bits 2..5)
+static uint32_t sampling_to_rate(uint32_t value) {
+    switch ((value >> 2) & 0xF) {
+        case 0x3: return 8000;
+        case 0x6: return 32000;
+        case 0x7: return 96000;
+        default:  return 48000;
+    }
+}
+
+int alt_up_av_config_write_audio_cfg_register(alt_up_av_config_dev *av_config, alt_u32 addr, alt_u32 data) {
+    sigset_t old;
+    (void)av_config;
+
+    block_irqs(&old);
+    audio_advance();
+    if (addr == 0x08) {
+        codec_sampling = data;
+    } else if (addr == 0x09) {
+        if (!codec_active && (data & 1)) {
+            // La nueva tasa cuenta desde que se reactiva la interfaz
+            codec_rate = sampling_to_rate(codec_sampling);
+            codec_rate_since_ns = now_ns();
+            codec_rate_since_frames = audio_frames_done;
+            printf("[EMU] Codec: %u Hz\n", codec_rate);
+        }
+        codec_active = data & 1;
+    }
+    restore_irqs(&old);
+    return 0;
+}
+
+// --- Teclado: '0', '1', '2' = KEY0..KEY2 ---
+
+static void *keyboard_thread(void *arg) {
+    int c;
+    (void)arg;
+
+    while ((c = getchar()) != EOF) {
+        if (c >= '0' && c <= '2') {
+            int key = c - '0';
+            buttons_press_until[key] = now_ns() + EMU_KEY_PRESS_NS;
+            __atomic_or_fetch(&buttons_edge_cap, 1u << key, __ATOMIC_SEQ_CST);
+        }
+    }
+    return NULL;
+}
+
+// --- Memoria compartida ---
+
+static int map_shared_memory(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0 || ftruncate(fd, SHARED_MEMORY_SIZE_VALUE) != 0) {
+        printf("ERROR: No se pudo crear %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    void *base = mmap((void *)SHARED_MEMORY_BASE, SHARED_MEMORY_SIZE_VALUE,
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    close(fd);
+    if (base != (void *)SHARED_MEMORY_BASE) {
+        printf("ERROR: No se pudo mapear la memoria compartida en 0x%x: %s\n",
+               SHARED_MEMORY_BASE, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void print_stats(int sig) {
+    (void)sig;
+    printf("\n[EMU] Codec: %llu frames de entrada, %llu desbordes del FIFO de entrada\n",
+           (unsigned long long)input_frames, (unsigned long long)overflows);
+    printf("[EMU] Codec: %llu frames de salida, %llu underruns del FIFO de salida\n",
+           (unsigned long long)output_frames, (unsigned long long)underruns);
+    fflush(stdout);
+    _exit(0);
+}
+
+// --- Verificación de una grabación de la rampa ---
+
+static int check_ramp(const char *path) {
+    FILE *file = fopen(path, "rb");
+    uint8_t header[12], chunk[8];
+    uint32_t data_size = 0;
+
+    if (!file || fread(header, 1, 12, file) != 12 || memcmp(header, "RIFF", 4) != 0 ||
+        memcmp(header + 8, "WAVE", 4) != 0) {
+        printf("ERROR: %s no es un WAV\n", path);
+        return 1;
+    }
+    while (fread(chunk, 1, 8, file) == 8) {
+        uint32_t size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+        if (memcmp(chunk, "data", 4) == 0) {
+            data_size = size;
+            break;
+        }
+        fseek(file, size + (size & 1), SEEK_CUR);
+    }
+
+    uint64_t frames = 0, gaps = 0, missing = 0, bad_right = 0;
+    int16_t frame[2];
+    uint16_t last = 0;
+
+    while (frames * 4 < data_size && fread(frame, sizeof(frame), 1, file) == 1) {
+        uint16_t left = (uint16_t)frame[0];
+        if ((uint16_t)frame[1] != (uint16_t)~left) {
+            bad_right++;
+        }
+        if (frames > 0 && left != (uint16_t)(last + 1)) {
+            gaps++;
+            missing += (uint16_t)(left - last - 1);
+        }
+        last = left;
+        frames++;
+    }
+    fclose(file);
+
+    printf("%s: %llu frames (%.2f s), %llu saltos (~%llu frames perdidos), %llu frames L/R inconsistentes\n",
+           path, (unsigned long long)frames, frames / (double)EMU_SAMPLE_RATE,
+           (unsigned long long)gaps, (unsigned long long)missing, (unsigned long long)bad_right);
+    if (frames == 0 || gaps || bad_right) {
+        printf("✗ Rampa con errores\n");
+        return 1;
+    }
+    printf("✓ Rampa continua, sin pérdidas\n");
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *shm_path = getenv("FPGA_AUDIO_EMU") ? getenv("FPGA_AUDIO_EMU") : EMU_SHM_DEFAULT;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check-ramp") == 0 && i + 1 < argc) {
+            return check_ramp(argv[i + 1]);
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "ramp") == 0) {
+                input_source = INPUT_RAMP;
+            } else if (strcmp(argv[i], "sine") == 0) {
+                input_source = INPUT_SINE;
+            } else if (strcmp(argv[i], "silence") == 0) {
+                input_source = INPUT_SILENCE;
+            } else if (strcmp(argv[i], "loopback") == 0) {
+                input_source = INPUT_LOOPBACK;
+            } else {
+                printf("ERROR: Entrada desconocida: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--loopback-delay") == 0 && i + 1 < argc) {
+            input_source = INPUT_LOOPBACK;
+            loopback_delay = (uint32_t)atoi(argv[++i]);
+            if (loopback_delay >= EMU_LOOPBACK_MAX) {
+                printf("ERROR: Retardo de loopback máximo: %d frames\n", EMU_LOOPBACK_MAX - 1);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "cpu") == 0) {
+                pthread_getcpuclockid(pthread_self(), &hw_clock);
+            } else if (strcmp(argv[i], "wall") != 0) {
+                printf("ERROR: Reloj desconocido: %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            printf("Uso: %s [--input ramp|sine|silence|loopback] [--loopback-delay frames]\n", argv[0]);
+            printf("          [--clock wall|cpu]\n");
+            printf("     %s --check-ramp <grabacion.wav>\n", argv[0]);
+            printf("Memoria compartida: $FPGA_AUDIO_EMU (por defecto %s)\n", EMU_SHM_DEFAULT);
+            printf("Teclas: 0/1/2 + Enter = KEY0/KEY1/KEY2\n");
+            return 1;
+        }
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    if (map_shared_memory(shm_path) != 0) {
+        return 1;
+    }
+    printf("[EMU] Memoria compartida: %s\n", shm_path);
+
+    t0_ns = now_ns();
+    codec_rate_since_ns = t0_ns;
+
+    // El teclado no debe recibir SIGALRM: las "IRQs" corren en el hilo del firmware
+    sigset_t old;
+    pthread_t keyboard;
+    block_irqs(&old);
+    pthread_create(&keyboard, NULL, keyboard_thread, NULL);
+    restore_irqs(&old);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = irq_dispatch;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigaction(SIGALRM, &sa, NULL);
+    signal(SIGINT, print_stats);
+    signal(SIGTERM, print_stats);
+
+    struct itimerval tick = { { 0, EMU_IRQ_TICK_US }, { 0, EMU_IRQ_TICK_US } };
+    setitimer(ITIMER_REAL, &tick, NULL);
+
+    return nios_main();
+}
@@ -0,0 +1,23 @@
+#ifndef EMU_ALTERA_UP_AVALON_AUDIO_H
+#define EMU_ALTERA_UP_AVALON_AUDIO_H
+
+// Misma API y semántica que el driver University Program:
+// read_fifo/write_fifo devuelven cuántas palabras transfirieron.
+#include "alt_types.h"
+
+#define ALT_UP_AUDIO_LEFT   0
+#define ALT_UP_AUDIO_RIGHT  1
+#define BUF_THRESHOLD       96  // 75% de los FIFOs de 128 palabras
+
+typedef struct alt_up_audio_dev {
+    int unused;
+} alt_up_audio_dev;
+
+alt_up_audio_dev *alt_up_audio_open_dev(const char *name);
+void alt_up_audio_reset_audio_core(alt_up_audio_dev *audio);
+unsigned int alt_up_audio_read_fifo_avail(alt_up_audio_dev *audio, int channel);
+unsigned int alt_up_audio_write_fifo_space(alt_up_audio_dev *audio, int channel);
+int alt_up_audio_read_fifo(alt_up_audio_dev *audio, unsigned int *buf, int len, int channel);
+int alt_up_audio_write_fifo(alt_up_audio_dev *audio, unsigned int *buf, int len, int channel);
+
+#endif /* EMU_ALTERA_UP_AVALON_AUDIO_H */
@@ -0,0 +1,16 @@
+#ifndef EMU_ALTERA_UP_AVALON_AUDIO_AND_VIDEO_CONFIG_H
+#define EMU_ALTERA_UP_AVALON_AUDIO_AND_VIDEO_CONFIG_H
+
+// Configuración del WM8731 por I2C: emu.c interpreta los registros de
+// tasa de muestreo y activación
+#include "alt_types.h"
+
+typedef struct alt_up_av_config_dev {
+    int unused;
+} alt_up_av_config_dev;
+
+alt_up_av_config_dev *alt_up_av_config_open_dev(const char *name);
+int alt_up_av_config_read_ready(alt_up_av_config_dev *av_config);
+int alt_up_av_config_write_audio_cfg_register(alt_up_av_config_dev *av_config, alt_u32 addr, alt_u32 data);
+
+#endif /* EMU_ALTERA_UP_AVALON_AUDIO_AND_VIDEO_CONFIG_H */
@@ -0,0 +1,14 @@
+#ifndef EMU_IO_H
+#define EMU_IO_H
+
+// Accesos a periféricos: los atiende el modelo de hardware de emu.c
+#include "alt_types.h"
+
+alt_u32 emu_iord(alt_u32 base, alt_u32 regnum);
+void emu_iowr(alt_u32 base, alt_u32 regnum, alt_u32 data);
+
+#define __IO_CALC_ADDRESS_NATIVE(BASE, REGNUM) ((BASE) + (REGNUM) * 4)
+#define IORD(BASE, REGNUM)          emu_iord((BASE), (REGNUM))
+#define IOWR(BASE, REGNUM, DATA)    emu_iowr((BASE), (REGNUM), (DATA))
+
+#endif /* EMU_IO_H */
@@ -0,0 +1,15 @@
+#ifndef EMU_ALT_IRQ_H
+#define EMU_ALT_IRQ_H
+
+// API legacy de IRQs del HAL. Las "interrupciones" se despachan desde
+// SIGALRM; deshabilitarlas es bloquear la señal.
+#include "alt_types.h"
+
+typedef alt_u32 alt_irq_context;
+typedef void (*alt_isr_func)(void *context, alt_u32 id);
+
+int alt_irq_register(alt_u32 id, void *context, alt_isr_func handler);
+alt_irq_context alt_irq_disable_all(void);
+void alt_irq_enable_all(alt_irq_context context);
+
+#endif /* EMU_ALT_IRQ_H */
@@ -0,0 +1,8 @@
+#ifndef EMU_ALT_STDIO_H
+#define EMU_ALT_STDIO_H
+
+// Salida del JTAG UART al stdout del emulador
+void alt_printf(const char *fmt, ...);
+int alt_putstr(const char *str);
+
+#endif /* EMU_ALT_STDIO_H */
@@ -0,0 +1,22 @@
+#ifndef EMU_SYSTEM_H
+#define EMU_SYSTEM_H
+
+// system.h del BSP con la memoria compartida movida a una dirección del host
+#include "../../soc_audio_system_ec_bsp/system.h"
+
+#include <stdint.h>
+
+#undef SHARED_MEMORY_BASE
+#define SHARED_MEMORY_BASE  0x10040000     // Archivo mapeado por emu.c
+
+// Timer de perfil de 1 ms (en la placa hace falta agregarlo en qsys): el
+// emulador lo vence en cada despacho de IRQs
+#define PROFILE_TIMER_BASE    0x8880
+#define PROFILE_TIMER_IRQ     4
+#define PROFILE_TIMER_PERIOD  1
+
+// PC interrumpido (RIP guardado por el handler de SIGALRM)
+uint32_t emu_interrupted_pc(void);
+#define NIOS2_READ_EA(pc)   ((pc) = emu_interrupted_pc())
+
+#endif /* EMU_SYSTEM_H */
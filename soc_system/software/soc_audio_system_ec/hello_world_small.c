@@ -4,12 +4,41 @@
 #include <stdint.h>
 #include <unistd.h>
 #include "altera_up_avalon_audio.h"
+#include "altera_up_avalon_audio_regs.h"
+#include "altera_up_avalon_audio_and_video_config.h"
+#include "altera_avalon_timer_regs.h"
+#include "altera_avalon_pio_regs.h"
 
-#define SAMPLE_RATE 48000
+#define SAMPLE_RATE 48000             // Tasa por defecto del codec (AUDIO_CONFIG en Qsys)
 #define AUDIO_CHUNK_SIZE (30 * 1024)  // 30 KB chunks
 #define CONTROL_OFFSET 0x0000
 #define AUDIO_DATA_OFFSET 0x0400
 
+// WM8731: registros usados para cambiar la tasa (MCLK = 12.288 MHz, modo normal)
+#define WM8731_DAC_PATH         0x05
+#define WM8731_SAMPLING         0x08
+#define WM8731_ACTIVE           0x09
+#define WM8731_DAC_PATH_PLAY    0x000   // DAC sin mute ni de-énfasis, HPF del ADC activo
+#define WM8731_DAC_PATH_MUTE    0x008   // DACMU: soft mute
+#define WM8731_MUTE_US          5000    // Tiempo para que el soft mute llegue a cero
+#define CODEC_DRAIN_TIMEOUT     100000  // Iteraciones esperando que se vacíe el FIFO
+
+// Formato de las muestras en el chunk compartido
+#define SAMPLE_FORMAT_PCM16   0
+#define SAMPLE_FORMAT_ADPCM   1   // IMA-ADPCM 4:1, bloques de 1 KB
+#define SAMPLE_FORMAT_PCM24   2   // Palabras de 24 bits del codec (L, R) en dos slots alternados
+
+// Alta tasa (PCM24): mientras el Nios vacía un slot el HPS llena el otro
+#define HIRATE_SLOT_SIZE      0x7E00      // 31.5 KB = 4032 frames, 42 ms a 96 kHz
+#define HIRATE_RATE           96000
+#define HIRATE_BUDGET_CYCLES  (ALT_CPU_FREQ / HIRATE_RATE / 2)  // Mitad del frame; el resto para ISRs y loop
+#define HIRATE_MAX_UNDERRUNS  4           // FIFO vacío tolerado por ventana de 500 ms
+#define CODEC_FIFO_DEPTH      128
+
+// Bloque ADPCM: cabecera L/R (predictor int16, índice u8, 0) + 1 byte por frame
+#define ADPCM_BLOCK_SIZE   1024
+#define ADPCM_HEADER_SIZE  8
+
 // *** COMANDOS Y ESTADOS ***
 #define CMD_NONE    0
 #define CMD_PLAY    1
@@ -17,10 +46,30 @@
 #define CMD_STOP    3
 #define CMD_NEXT    4
 #define CMD_PREV    5
+#define CMD_VOLUME  6   // Lo procesa el HPS (limitador), el Nios no hace nada
+#define CMD_RECORD       7   // HPS → NIOS: iniciar captura de line-in
+#define CMD_RECORD_STOP  8   // HPS → NIOS: detener captura
+#define CMD_LATENCY      9   // HPS → NIOS: medir latencia de ida y vuelta (loopback)
 
 #define STATUS_READY    0
 #define STATUS_PLAYING  1
 #define STATUS_PAUSED   2
+#define STATUS_RECORDING 3
+#define STATUS_MEASURING 4
+
+// Ring de grabación: frames estéreo de 16 bits (L, R) en la memoria compartida
+#define RECORD_RING_OFFSET  0x10000
+#define RECORD_RING_SIZE    0xF000                  // 60 KB (hasta el área de perfil)
+#define RECORD_RING_FRAMES  (RECORD_RING_SIZE / 4)  // 15360 frames = 320 ms a 48 kHz
+#define RECORD_BATCH_FRAMES 32                      // Frames leídos del FIFO por lote
+
+// Medición de latencia: pulsos en la salida detectados en line-in (cable de loopback)
+#define LATENCY_PULSES          16
+#define LATENCY_PULSE_FRAMES    4           // Ancho del pulso
+#define LATENCY_PULSE_LEVEL     0x400000    // Media escala en 24 bits
+#define LATENCY_THRESHOLD       0x080000    // 1/16 de escala
+#define LATENCY_GAP_FRAMES      12000       // 250 ms entre pulsos (deja decaer ecos)
+#define LATENCY_TIMEOUT_FRAMES  9600        // 200 ms sin detectar = pulso perdido
 
 // *** ESTRUCTURA EXACTAMENTE IGUAL QUE HPS ***
 typedef struct __attribute__((packed)) {
@@ -28,7 +77,7 @@ typedef struct __attribute__((packed)) {
     volatile uint32_t magic;           // 0xABCD2025
     volatile uint32_t command;         // HPS → NIOS comandos
     volatile uint32_t status;          // NIOS → HPS estado
-    volatile uint32_t song_id;         // Canción actual (0-2)
+    volatile uint32_t song_id;         // Pista actual (índice en la playlist)
     
     // Control de chunks (16 bytes)
     volatile uint32_t chunk_ready;     // 1=HPS cargó, 0=NIOS consumió
@@ -39,37 +88,194 @@ typedef struct __attribute__((packed)) {
     // Información de canción (16 bytes)
     volatile uint32_t total_chunks;    // Total chunks de la canción
     volatile uint32_t song_total_size; // Tamaño total del archivo
-    volatile uint32_t song_position;   // Posición actual en bytes
+    volatile uint32_t song_position;   // NIOS: posición reproducida en bytes PCM (frames * 4)
     volatile uint32_t duration_sec;    // Duración en segundos
     
     // Sistema y comunicación (16 bytes)
     volatile uint32_t hps_connected;   // 1=HPS activo
     volatile uint32_t fpga_heartbeat;  // Contador de NIOS
-    volatile uint32_t sample_rate;     // 48000 Hz
+    volatile uint32_t sample_rate;     // HPS: tasa de la canción actual (el NIOS reprograma el codec)
     volatile uint32_t channels;        // 2 (estéreo)
     
     // Estado y debugging (16 bytes)
     volatile uint32_t buffer_level;    // Nivel de buffer (0-100%)
     volatile uint32_t error_flags;     // Flags de error
-    volatile uint32_t bytes_played;    // Bytes reproducidos total
+    volatile uint32_t bytes_played;    // NIOS: bytes PCM entregados al codec (32 bits bajos)
     volatile uint32_t chunks_loaded;   // Total de chunks cargados
     
-    // Reservado para expansión (176 bytes = 256 bytes total)
-    volatile uint32_t reserved[44];
+    // Volumen y limitador (8 bytes)
+    volatile uint32_t volume;          // Volumen en % (100 = unitario, máx 400)
+    volatile uint32_t limiter_gain;    // Menor ganancia del limitador en el último chunk (Q12)
+    
+    // Transporte (16 bytes)
+    volatile uint32_t sample_format;     // SAMPLE_FORMAT_PCM16 / SAMPLE_FORMAT_ADPCM
+    volatile uint32_t chunk_frames;      // Frames de audio en el chunk actual
+    volatile uint32_t decode_cycles;     // NIOS: ciclos promedio por frame ADPCM (últimos 500 ms)
+    volatile uint32_t decode_cycles_max; // NIOS: peor lote, ciclos por frame
+    
+    // Contador de frames y marca de tiempo (24 bytes). Leer con position_seq:
+    // impar = el NIOS está escribiendo, reintentar si cambia durante la lectura
+    volatile uint32_t position_seq;
+    volatile uint32_t frames_played_lo;  // Frames entregados al FIFO del codec (64 bits)
+    volatile uint32_t frames_played_hi;
+    volatile uint32_t frames_ticks_lo;   // Ticks NIOS de la última actualización (64 bits)
+    volatile uint32_t frames_ticks_hi;
+    volatile uint32_t ticks_freq;        // Frecuencia de los ticks (Hz)
+    
+    // Grabación (16 bytes)
+    volatile uint32_t rec_write_frames;  // NIOS: frames escritos en el ring (contador libre)
+    volatile uint32_t rec_read_frames;   // HPS: frames consumidos del ring
+    volatile uint32_t rec_dropped;       // NIOS: frames perdidos por ring lleno
+    volatile uint32_t rec_fifo_full;     // NIOS: lecturas con el FIFO de entrada lleno (posible pérdida)
+    
+    // Latencia (32 bytes), en frames salvo lat_cmd_ticks
+    volatile uint32_t lat_pulses;        // NIOS: pulsos detectados
+    volatile uint32_t lat_timeouts;      // NIOS: pulsos no detectados
+    volatile uint32_t lat_min;           // NIOS: ida y vuelta mínima
+    volatile uint32_t lat_max;           // NIOS: ida y vuelta máxima
+    volatile uint32_t lat_sum;           // NIOS: suma de ida y vuelta (promedio = sum / pulses)
+    volatile uint32_t lat_queue_sum;     // NIOS: suma de la ocupación del FIFO de salida al escribir cada pulso
+    volatile uint32_t lat_first;         // NIOS: ida y vuelta del primer pulso (FIFO de salida vacío)
+    volatile uint32_t lat_cmd_ticks;     // NIOS: ticks desde ver CMD_LATENCY hasta escribir el primer pulso
+    
+    // Alta tasa, PCM24 en dos slots (24 bytes)
+    volatile uint32_t slot_bytes[2];     // HPS: bytes cargados en cada slot; NIOS: 0 al terminarlo
+    volatile uint32_t hirate_cycles;     // NIOS: ciclos por frame promedio (últimos 500 ms)
+    volatile uint32_t hirate_cycles_max; // NIOS: ciclos por frame del lote más largo
+    volatile uint32_t hirate_underruns;  // NIOS: FIFO de salida encontrado vacío con datos en el slot
+    volatile uint32_t hirate_fallback;   // NIOS: 1 = presupuesto excedido, el HPS debe pasar a 48 kHz
+    
+    // Reservado para expansión (56 bytes = 256 bytes total)
+    volatile uint32_t reserved[14];
 } compact_shared_control_t;
 
+// *** PERFIL ESTADÍSTICO (EXACTAMENTE IGUAL QUE nios_profile.h DEL HPS) ***
+#define PROFILE_OFFSET        0x1F000     // Relativo a la memoria compartida
+#define PROFILE_SIZE          0x800       // 2 KB
+#define PROFILE_MAGIC         0x464F5250  // "PROF"
+#define PROFILE_HEADER_SIZE   32
+#define PROFILE_MAX_BUCKETS   ((PROFILE_SIZE - PROFILE_HEADER_SIZE) / 2)
+
+typedef struct __attribute__((packed)) {
+    volatile uint32_t magic;            // PROFILE_MAGIC cuando el Nios lo inicializó
+    volatile uint32_t text_start;       // stext
+    volatile uint32_t text_end;         // etext
+    volatile uint32_t bucket_shift;     // Bytes por bucket = 1 << bucket_shift
+    volatile uint32_t num_buckets;
+    volatile uint32_t samples;          // Muestras dentro de stext..etext
+    volatile uint32_t samples_outside;  // PC fuera de .text
+    volatile uint32_t sample_rate;      // Muestras por segundo
+    volatile uint16_t buckets[PROFILE_MAX_BUCKETS];  // Saturan en 65535
+} profile_area_t;
+
+// *** HISTOGRAMAS DE ISR (EXACTAMENTE IGUAL QUE nios_profile.h DEL HPS) ***
+#define ISR_STATS_OFFSET      0x1F800     // Relativo a la memoria compartida
+#define ISR_STATS_SIZE        0x800       // 2 KB
+#define ISR_STATS_MAGIC       0x54415453  // "STAT"
+#define ISR_STATS_BINS        32          // Bin i: [2^i, 2^(i+1)) ciclos (bin 0 incluye 0)
+
+#define ISR_SRC_TIMER         0
+#define ISR_SRC_AUDIO         1
+#define ISR_SRC_BUTTONS       2
+#define ISR_SRC_PROCESS       3           // process_audio_data()
+#define ISR_STATS_SOURCES     4
+
+typedef struct __attribute__((packed)) {
+    volatile uint32_t count;
+    volatile uint32_t max;              // Peor caso en ciclos
+    volatile uint32_t sum_lo;           // Suma de ciclos (64 bits) para el promedio
+    volatile uint32_t sum_hi;
+    volatile uint32_t bins[ISR_STATS_BINS];
+} isr_histogram_t;
+
+typedef struct __attribute__((packed)) {
+    isr_histogram_t latency;            // Retardo de entrada
+    isr_histogram_t duration;           // Tiempo de ejecución
+} isr_source_stats_t;
+
+typedef struct __attribute__((packed)) {
+    volatile uint32_t magic;            // ISR_STATS_MAGIC cuando el Nios lo inicializó
+    volatile uint32_t ticks_freq;       // Ciclos por segundo
+    volatile uint32_t num_sources;
+    volatile uint32_t reset_request;    // HPS escribe 1, el Nios limpia en el próximo tick
+    isr_source_stats_t sources[ISR_STATS_SOURCES];
+} isr_stats_area_t;
+
+// Límites de .text definidos en el linker script
+extern char stext[];
+extern char etext[];
+
 // *** VARIABLES GLOBALES ***
 alt_up_audio_dev *audio_dev = NULL;
+alt_up_av_config_dev *av_config = NULL;
+uint32_t codec_rate = SAMPLE_RATE;      // Tasa programada en el WM8731
 
 // USAR DIRECCIONES DE TU SYSTEM.H
 volatile compact_shared_control_t *shared_ctrl = (compact_shared_control_t*)SHARED_MEMORY_BASE;
 volatile uint8_t *shared_data = (uint8_t*)(SHARED_MEMORY_BASE + AUDIO_DATA_OFFSET);
+volatile profile_area_t *profile = (profile_area_t*)(SHARED_MEMORY_BASE + PROFILE_OFFSET);
+volatile isr_stats_area_t *isr_stats = (isr_stats_area_t*)(SHARED_MEMORY_BASE + ISR_STATS_OFFSET);
+volatile uint32_t *record_ring = (uint32_t*)(SHARED_MEMORY_BASE + RECORD_RING_OFFSET);
 
 volatile int is_playing = 0;
-volatile int elapsed_ms = 0, elapsed_seconds = 0, elapsed_minutes = 0;
+volatile int is_recording = 0;
+uint32_t record_ring_pos = 0;   // Próximo frame a escribir en el ring (0..RECORD_RING_FRAMES-1)
+volatile int elapsed_seconds = 0, elapsed_minutes = 0;
 volatile uint32_t audio_read_ptr = 0;
 volatile uint32_t system_uptime_ms = 0;
 
+// Base de la marca de tiempo: ticks de 50 MHz acumulados por el timer
+volatile uint64_t timer_ticks_base = 0;
+
+// Frames entregados al FIFO del codec: total (64 bits) y desde el inicio de la canción
+volatile uint64_t frames_played = 0;
+volatile uint32_t song_frames = 0;
+
+// Botones: teclas pendientes capturadas por el ISR
+#define BUTTONS_ALL         0x7
+volatile uint32_t buttons_pending = 0;  // Flancos aún no atendidos por el loop
+volatile uint32_t buttons_masked = 0;   // Teclas en antirrebote (IRQ deshabilitada)
+
+// Estado del decodificador ADPCM (se resincroniza en cada cabecera de bloque)
+typedef struct {
+    int32_t predictor;
+    int32_t index;
+} adpcm_state_t;
+
+adpcm_state_t adpcm_state[2];
+
+// Medición del decodificador ADPCM (se publica cada 500 ms)
+volatile uint32_t adpcm_cycles_acc = 0;
+volatile uint32_t adpcm_frames_acc = 0;
+volatile uint32_t adpcm_cycles_max = 0;
+
+// Alta tasa: slot en reproducción y medición del camino PCM24
+uint32_t hirate_slot = 0;
+int hirate_primed = 0;                  // El FIFO ya recibió datos: vacío = underrun
+volatile uint32_t hirate_cycles_acc = 0;
+volatile uint32_t hirate_frames_acc = 0;
+volatile uint32_t hirate_batch_cycles = 0;   // Lote más largo de la ventana
+volatile uint32_t hirate_batch_frames = 0;
+volatile uint32_t hirate_underruns_acc = 0;
+
+// Tablas IMA estándar (iguales que adpcm.c del HPS)
+const signed char adpcm_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+const unsigned short adpcm_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
 // 7 segmentos: patrones para 0-9
 const unsigned char seven_seg_patterns[10] = {
     0x40, 0x79, 0x24, 0x30, 0x19,
@@ -83,43 +289,268 @@ void process_audio_data(void);
 void send_command_to_hps(uint32_t cmd);
 void request_next_chunk(void);
 int check_hps_connection(void);
+uint64_t timestamp_ticks64(void);
+uint32_t timestamp_ticks(void);
+void account_frames(uint32_t frames);
+void profile_init(void);
+void process_record_data(void);
+void handle_record_command(void);
+void handle_latency_command(void);
+int codec_set_sample_rate(uint32_t rate);
+void isr_stats_init(void);
 
 // --- Verificar conexión HPS ---
 int check_hps_connection(void) {
     return (shared_ctrl->magic == 0xABCD2025 && shared_ctrl->hps_connected == 1) ? 1 : 0;
 }
 
+// --- Marca de tiempo en ciclos (50 MHz) usando el snapshot del timer ---
+// Mismo método que altera_avalon_timer_ts, pero sobre el timer de 500 ms
+// (el BSP no tiene timer de timestamp). La base la suma el ISR.
+uint64_t timestamp_ticks64(void) {
+    alt_irq_context context = alt_irq_disable_all();
+
+    IOWR_ALTERA_AVALON_TIMER_SNAPL(TIMER_BASE, 0); // Captura snapshot
+    uint32_t count = (IORD_ALTERA_AVALON_TIMER_SNAPH(TIMER_BASE) << 16) |
+                     (IORD_ALTERA_AVALON_TIMER_SNAPL(TIMER_BASE) & 0xFFFF);
+    uint64_t ticks = timer_ticks_base + (TIMER_LOAD_VALUE - count);
+
+    // TO pendiente y contador recién recargado: el ISR aún no sumó el periodo
+    if ((IORD_ALTERA_AVALON_TIMER_STATUS(TIMER_BASE) & ALTERA_AVALON_TIMER_STATUS_TO_MSK) &&
+        count > (TIMER_LOAD_VALUE / 2)) {
+        ticks += TIMER_LOAD_VALUE + 1;
+    }
+
+    alt_irq_enable_all(context);
+    return ticks;
+}
+
+// Versión de 32 bits para medir intervalos cortos (vuelve a 0 cada ~85 s)
+uint32_t timestamp_ticks(void) {
+    return (uint32_t)timestamp_ticks64();
+}
+
+// --- Contabilizar frames entregados al FIFO del codec ---
+// Única fuente de posición: todo (reloj, song_position, HPS) sale de aquí.
+void account_frames(uint32_t frames) {
+    if (frames == 0) {
+        return;
+    }
+
+    alt_irq_context context = alt_irq_disable_all();
+    uint64_t now = timestamp_ticks64();
+
+    frames_played += frames;
+    song_frames += frames;
+
+    shared_ctrl->position_seq++;
+    shared_ctrl->frames_played_lo = (uint32_t)frames_played;
+    shared_ctrl->frames_played_hi = (uint32_t)(frames_played >> 32);
+    shared_ctrl->frames_ticks_lo = (uint32_t)now;
+    shared_ctrl->frames_ticks_hi = (uint32_t)(now >> 32);
+    shared_ctrl->position_seq++;
+
+    shared_ctrl->song_position = song_frames << 2;
+    shared_ctrl->bytes_played = (uint32_t)frames_played << 2;
+
+    alt_irq_enable_all(context);
+}
+
+// --- Perfil: inicializar histograma sobre stext..etext ---
+void profile_init(void) {
+    uint32_t text_size = (uint32_t)(etext - stext);
+    uint32_t shift = 2;  // Mínimo una instrucción por bucket
+
+    while ((text_size >> shift) >= PROFILE_MAX_BUCKETS) {
+        shift++;
+    }
+
+    profile->magic = 0;
+    profile->text_start = (uint32_t)stext;
+    profile->text_end = (uint32_t)etext;
+    profile->bucket_shift = shift;
+    profile->num_buckets = (text_size >> shift) + 1;
+    profile->samples = 0;
+    profile->samples_outside = 0;
+#ifdef PROFILE_TIMER_BASE
+    profile->sample_rate = 1000 / PROFILE_TIMER_PERIOD;
+#else
+    profile->sample_rate = 1000 / TIMER_PERIOD;
+#endif
+    for (int i = 0; i < PROFILE_MAX_BUCKETS; i++) {
+        profile->buckets[i] = 0;
+    }
+    profile->magic = PROFILE_MAGIC;
+}
+
+// El emulador de host (nios_emu) define su propia versión
+#ifndef NIOS2_READ_EA
+#define NIOS2_READ_EA(pc) __asm__ volatile ("mov %0, ea" : "=r" (pc))
+#endif
+
+// --- Perfil: muestrear el PC interrumpido (llamar desde un ISR de timer) ---
+// Como alt_gmon: ea es la dirección de retorno de la interrupción. El código
+// de los ISR y de las secciones con IRQs deshabilitadas no se ve (la muestra
+// cae justo al rehabilitarlas). El timer de 500 ms solo da 2 muestras/s: con
+// el timer dedicado PROFILE_TIMER se muestrea a 1 kHz.
+static void profile_sample(void) {
+    uint32_t pc;
+    NIOS2_READ_EA(pc);
+
+    uint32_t offset = pc - (uint32_t)stext;
+    if (pc >= (uint32_t)stext && pc < (uint32_t)etext) {
+        uint32_t index = offset >> profile->bucket_shift;
+        if (profile->buckets[index] != 0xFFFF) {
+            profile->buckets[index]++;
+        }
+        profile->samples++;
+    } else {
+        profile->samples_outside++;
+    }
+}
+
+#ifdef PROFILE_TIMER_BASE
+// --- Interrupción Timer de perfil (1 ms) - USAR TU PROFILE_TIMER_IRQ ---
+// Requiere en qsys un altera_avalon_timer "PROFILE_TIMER" de período fijo
+// 1 ms con su IRQ conectada al NIOSII, y regenerar el BSP para que system.h
+// defina PROFILE_TIMER_BASE/IRQ/PERIOD. Sin él el perfil usa el timer de 500 ms.
+static void profile_timer_isr(void* context, alt_u32 id) {
+    IOWR_ALTERA_AVALON_TIMER_STATUS(PROFILE_TIMER_BASE, 0); // Limpia TO
+    profile_sample();
+}
+#endif
+
+// --- Histogramas de ISR: limpiar contadores ---
+static void isr_stats_clear(void) {
+    volatile uint32_t *words = (volatile uint32_t*)isr_stats->sources;
+    for (int i = 0; i < sizeof(isr_stats->sources) / 4; i++) {
+        words[i] = 0;
+    }
+    isr_stats->reset_request = 0;
+}
+
+void isr_stats_init(void) {
+    isr_stats->magic = 0;
+    isr_stats->ticks_freq = ALT_CPU_FREQ;
+    isr_stats->num_sources = ISR_STATS_SOURCES;
+    isr_stats_clear();
+    isr_stats->magic = ISR_STATS_MAGIC;
+}
+
+// --- Histogramas de ISR: acumular una medición en ciclos ---
+// Solo shifts y sumas: barato para dejarlo siempre activo.
+static void isr_stats_record(volatile isr_histogram_t *hist, uint32_t cycles) {
+    uint32_t value = cycles;
+    uint32_t bin = 0;
+
+    if (value >= (1 << 16)) { value >>= 16; bin += 16; }
+    if (value >= (1 << 8))  { value >>= 8;  bin += 8; }
+    if (value >= (1 << 4))  { value >>= 4;  bin += 4; }
+    if (value >= (1 << 2))  { value >>= 2;  bin += 2; }
+    if (value >= (1 << 1))  { bin += 1; }
+
+    alt_irq_context context = alt_irq_disable_all();
+    hist->count++;
+    hist->bins[bin]++;
+    hist->sum_lo += cycles;
+    if (hist->sum_lo < cycles) {
+        hist->sum_hi++;
+    }
+    if (cycles > hist->max) {
+        hist->max = cycles;
+    }
+    alt_irq_enable_all(context);
+}
+
+// --- Interrupción Botones - flanco de bajada capturado por el PIO ---
+// La primera pulsación se acepta al instante; la tecla queda enmascarada
+// hasta que el timer la vea suelta, así los rebotes no generan más IRQs.
+static void buttons_isr(void* context, alt_u32 id) {
+    uint32_t start = timestamp_ticks();
+    uint32_t edges = IORD_ALTERA_AVALON_PIO_EDGE_CAP(BUTTONS_BASE) & BUTTONS_ALL;
+
+    IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTONS_BASE, edges);  // Borrado por bit
+    buttons_pending |= edges;
+    buttons_masked |= edges;
+    IOWR_ALTERA_AVALON_PIO_IRQ_MASK(BUTTONS_BASE, BUTTONS_ALL & ~buttons_masked);
+
+    // Sin latencia: el PIO no guarda el instante del flanco
+    isr_stats_record(&isr_stats->sources[ISR_SRC_BUTTONS].duration, timestamp_ticks() - start);
+}
+
+// --- Antirrebote: rearmar teclas soltadas (llamado desde el timer) ---
+static void buttons_rearm(void) {
+    uint32_t released = buttons_masked & IORD_ALTERA_AVALON_PIO_DATA(BUTTONS_BASE);  // 1 = suelta
+
+    if (released) {
+        IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTONS_BASE, released);  // Descartar flancos de rebote
+        buttons_masked &= ~released;
+        IOWR_ALTERA_AVALON_PIO_IRQ_MASK(BUTTONS_BASE, BUTTONS_ALL & ~buttons_masked);
+    }
+}
+
 // --- Interrupción Timer (500ms) - USAR TU TIMER_IRQ ---
 static void timer_isr(void* context, alt_u32 id) {
-    volatile unsigned int* timer_status = (unsigned int*) TIMER_BASE;
-    *timer_status = 0; // Limpia TO
+    // Latencia exacta: ciclos desde la recarga del contador (instante del TO)
+    uint32_t start = timestamp_ticks();
+    uint32_t latency = start - (uint32_t)(timer_ticks_base + TIMER_LOAD_VALUE + 1);
+
+    IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER_BASE, 0); // Limpia TO
+    timer_ticks_base += TIMER_LOAD_VALUE + 1;
+
+#ifndef PROFILE_TIMER_BASE
+    profile_sample();
+#endif
+
+    buttons_rearm();
+
+    // Publicar costo del decodificador ADPCM
+    if (adpcm_frames_acc > 0) {
+        shared_ctrl->decode_cycles = adpcm_cycles_acc / adpcm_frames_acc;
+        shared_ctrl->decode_cycles_max = adpcm_cycles_max;
+        adpcm_cycles_acc = 0;
+        adpcm_frames_acc = 0;
+        adpcm_cycles_max = 0;
+    }
+
+    // Camino de alta tasa: publicar costo y pedir fallback si no entra en el presupuesto
+    if (hirate_frames_acc > 0) {
+        uint32_t average = hirate_cycles_acc / hirate_frames_acc;
+        shared_ctrl->hirate_cycles = average;
+        shared_ctrl->hirate_cycles_max = hirate_batch_cycles / hirate_batch_frames;
+        shared_ctrl->hirate_underruns += hirate_underruns_acc;
+        if (!shared_ctrl->hirate_fallback &&
+            (average > HIRATE_BUDGET_CYCLES || hirate_underruns_acc > HIRATE_MAX_UNDERRUNS)) {
+            shared_ctrl->hirate_fallback = 1;
+            shared_ctrl->error_flags |= 0x08;
+        }
+        hirate_cycles_acc = 0;
+        hirate_frames_acc = 0;
+        hirate_batch_cycles = 0;
+        hirate_batch_frames = 0;
+        hirate_underruns_acc = 0;
+    }
 
     // Incrementar uptime del sistema
     system_uptime_ms += 500;
 
     // Actualizar heartbeat de FPGA
     shared_ctrl->fpga_heartbeat++;
+    shared_ctrl->ticks_freq = TIMER_FREQ;   // El HPS borra la estructura al arrancar
 
+    // Reloj mm:ss derivado de los frames realmente reproducidos
     if (is_playing && check_hps_connection()) {
-        elapsed_ms += 500;
-        if (elapsed_ms >= 1000) {
-            elapsed_ms = 0;
-            elapsed_seconds++;
-            if (elapsed_seconds >= 60) {
-                elapsed_seconds = 0;
-                elapsed_minutes++;
-                if (elapsed_minutes >= 100)
-                    elapsed_minutes = 0;
-            }
-        }
+        uint32_t total_seconds = song_frames / codec_rate;
+        elapsed_minutes = (total_seconds / 60) % 100;
+        elapsed_seconds = total_seconds % 60;
         update_seven_segment_display();
-        
-        // Actualizar bytes reproducidos
-        shared_ctrl->bytes_played += (audio_read_ptr > 0) ? 4 : 0;
     }
 
-    // Actualizar posición de reproducción
-    shared_ctrl->song_position = (elapsed_minutes * 60 + elapsed_seconds) * SAMPLE_RATE * 4;
+    if (isr_stats->reset_request) {
+        isr_stats_clear();
+    }
+    isr_stats_record(&isr_stats->sources[ISR_SRC_TIMER].latency, latency);
+    isr_stats_record(&isr_stats->sources[ISR_SRC_TIMER].duration, timestamp_ticks() - start);
 }
 
 // --- Solicitar siguiente chunk ---
@@ -138,11 +569,171 @@ void request_next_chunk(void) {
               shared_ctrl->current_chunk + 1, shared_ctrl->total_chunks);
 }
 
-// --- Procesar datos de audio ---
-void process_audio_data(void) {
+// --- Decodificar un nibble IMA-ADPCM: solo sumas y shifts (sin multiplicador) ---
+static inline int32_t adpcm_decode_nibble(adpcm_state_t *state, uint32_t nibble) {
+    int32_t step = adpcm_step_table[state->index];
+    int32_t diff = step >> 3;
+
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+
+    if (nibble & 8) {
+        state->predictor -= diff;
+        if (state->predictor < -32768) state->predictor = -32768;
+    } else {
+        state->predictor += diff;
+        if (state->predictor > 32767) state->predictor = 32767;
+    }
+
+    state->index += adpcm_index_table[nibble];
+    if (state->index < 0) state->index = 0;
+    if (state->index > 88) state->index = 88;
+
+    return state->predictor;
+}
+
+static void adpcm_read_header(adpcm_state_t *state, volatile uint8_t *header) {
+    state->predictor = (int16_t)(header[0] | (header[1] << 8));
+    state->index = (header[2] > 88) ? 88 : header[2];
+}
+
+// --- Decodificar y escribir hasta 'frames' frames de un chunk ADPCM ---
+// Devuelve los frames escritos.
+int write_adpcm_frames(int frames) {
+    int32_t left[8], right[8];
+    int count = 0;
+
+    // El estado del decodificador es compartido con el ISR de audio
+    alt_irq_context context = alt_irq_disable_all();
+    uint32_t start = timestamp_ticks();
+
+    while (count < frames && audio_read_ptr < shared_ctrl->chunk_size) {
+        if ((audio_read_ptr & (ADPCM_BLOCK_SIZE - 1)) == 0) {
+            adpcm_read_header(&adpcm_state[0], shared_data + audio_read_ptr);
+            adpcm_read_header(&adpcm_state[1], shared_data + audio_read_ptr + 4);
+            audio_read_ptr += ADPCM_HEADER_SIZE;
+            continue;
+        }
+
+        uint32_t byte = shared_data[audio_read_ptr++];
+        left[count] = adpcm_decode_nibble(&adpcm_state[0], byte & 0xF) << 8;
+        right[count] = adpcm_decode_nibble(&adpcm_state[1], byte >> 4) << 8;
+        count++;
+    }
+
+    uint32_t cycles = timestamp_ticks() - start;
+    adpcm_cycles_acc += cycles;
+    adpcm_frames_acc += count;
+    if (count == 8 && (cycles >> 3) > adpcm_cycles_max) {
+        adpcm_cycles_max = cycles >> 3;   // Lotes completos: /8 sin divisor
+    }
+    alt_irq_enable_all(context);
+
+    // Hay espacio verificado en el FIFO para 'frames' frames
+    for (int i = 0; i < count; i++) {
+        alt_up_audio_write_fifo(audio_dev, (unsigned int*)&left[i], 1, ALT_UP_AUDIO_LEFT);
+        alt_up_audio_write_fifo(audio_dev, (unsigned int*)&right[i], 1, ALT_UP_AUDIO_RIGHT);
+    }
+    account_frames(count);
+
+    if (audio_read_ptr >= shared_ctrl->chunk_size) {
+        alt_printf("Chunk %d completado (%d bytes ADPCM)\n",
+                  shared_ctrl->current_chunk, audio_read_ptr);
+        request_next_chunk();
+    }
+    return count;
+}
+
+// --- Alta tasa: copiar PCM24 del slot al FIFO escribiendo los registros ---
+// Una lectura de FIFOSPACE por lote y dos escrituras por frame, sin pasar
+// por el driver (que relee FIFOSPACE en cada palabra). Lo llaman el loop y
+// el ISR de audio: el estado del slot se toca con IRQs deshabilitadas.
+static uint32_t fill_audio_fifo_pcm24(void) {
+    alt_irq_context context = alt_irq_disable_all();
+
+    // El HPS arrancó un stream nuevo en el slot 0 (canción nueva o búsqueda)
+    if (shared_ctrl->chunk_ready) {
+        shared_ctrl->chunk_ready = 0;
+        hirate_slot = 0;
+        audio_read_ptr = 0;
+        hirate_primed = 0;
+        if (shared_ctrl->current_chunk == 0) {
+            song_frames = 0;
+        }
+    }
+
+    // Fallback pedido: dejar de consumir hasta que el HPS reinicie a 48 kHz
+    if (shared_ctrl->hirate_fallback) {
+        audio_read_ptr = 0;
+        alt_irq_enable_all(context);
+        return 0;
+    }
+
+    uint32_t slot_bytes = shared_ctrl->slot_bytes[hirate_slot];
+    if (slot_bytes == 0) {
+        shared_ctrl->buffer_level = 0;
+        alt_irq_enable_all(context);
+        return 0;     // El HPS todavía no cargó el slot
+    }
+
+    uint32_t start = timestamp_ticks();
+    uint32_t fifospace = IORD_ALT_UP_AUDIO_FIFOSPACE(AUDIO_BASE);
+    uint32_t frames = (fifospace & ALT_UP_AUDIO_FIFOSPACE_WSLC_MSK) >> ALT_UP_AUDIO_FIFOSPACE_WSLC_OFST;
+    uint32_t space_right = (fifospace & ALT_UP_AUDIO_FIFOSPACE_WSRC_MSK) >> ALT_UP_AUDIO_FIFOSPACE_WSRC_OFST;
+    uint32_t remaining = (slot_bytes - audio_read_ptr) >> 3;
+
+    if (frames >= CODEC_FIFO_DEPTH && hirate_primed) {
+        hirate_underruns_acc++;
+    }
+    if (space_right < frames) frames = space_right;
+    if (remaining < frames) frames = remaining;
+
+    volatile uint32_t *src = (volatile uint32_t*)(shared_data + (hirate_slot ? HIRATE_SLOT_SIZE : 0) +
+                                                  audio_read_ptr);
+    volatile uint32_t *end = src + (frames << 1);
+    while (src < end) {
+        IOWR_ALT_UP_AUDIO_LEFTDATA(AUDIO_BASE, src[0]);
+        IOWR_ALT_UP_AUDIO_RIGHTDATA(AUDIO_BASE, src[1]);
+        src += 2;
+    }
+    audio_read_ptr += frames << 3;
+
+    uint32_t cycles = timestamp_ticks() - start;
+    if (frames > 0) {
+        hirate_primed = 1;
+        hirate_cycles_acc += cycles;
+        hirate_frames_acc += frames;
+        if (frames > hirate_batch_frames) {
+            hirate_batch_cycles = cycles;
+            hirate_batch_frames = frames;
+        }
+    }
+
+    // Slot terminado: devolverlo al HPS y seguir con el otro
+    if (audio_read_ptr >= slot_bytes) {
+        shared_ctrl->slot_bytes[hirate_slot] = 0;
+        hirate_slot ^= 1;
+        audio_read_ptr = 0;
+        shared_ctrl->request_next = 1;
+    }
+
+    account_frames(frames);
+    shared_ctrl->error_flags &= ~0x01;
+    alt_irq_enable_all(context);
+    return frames;
+}
+
+// --- Llenar el FIFO del codec desde el chunk compartido ---
+// Devuelve los frames escritos.
+static uint32_t fill_audio_fifo(void) {
     if (!check_hps_connection()) {
         shared_ctrl->error_flags |= 0x02;
-        return;
+        return 0;
+    }
+
+    if (shared_ctrl->sample_format == SAMPLE_FORMAT_PCM24) {
+        return fill_audio_fifo_pcm24();
     }
 
     if (shared_ctrl->chunk_ready == 0 || shared_ctrl->chunk_size == 0) {
@@ -150,44 +741,59 @@ void process_audio_data(void) {
             request_next_chunk();
         }
         shared_ctrl->buffer_level = 0;
-        return;
+        return 0;
     }
 
     // Verificar espacio en FIFO
     int write_space_left = alt_up_audio_write_fifo_space(audio_dev, ALT_UP_AUDIO_LEFT);
     int write_space_right = alt_up_audio_write_fifo_space(audio_dev, ALT_UP_AUDIO_RIGHT);
 
+    uint32_t written = 0;
     if (write_space_left > 0 && write_space_right > 0) {
         int samples_to_write = (write_space_left < 8) ? write_space_left : 8;
+        if (write_space_right < samples_to_write) {
+            samples_to_write = write_space_right;
+        }
 
-        for (int i = 0; i < samples_to_write; i++) {
-            if (audio_read_ptr >= shared_ctrl->chunk_size) {
-                alt_printf("Chunk %d completado (%d bytes)\n", 
-                          shared_ctrl->current_chunk, audio_read_ptr);
-                request_next_chunk();
-                break;
-            }
+        // Inicio de canción: el HPS entregó el chunk 0 (fin de canción, NEXT/PREV o STOP)
+        if (audio_read_ptr == 0 && shared_ctrl->current_chunk == 0) {
+            song_frames = 0;
+        }
 
-            if (audio_read_ptr + 4 > shared_ctrl->chunk_size) {
-                request_next_chunk();
-                break;
-            }
+        if (shared_ctrl->sample_format == SAMPLE_FORMAT_ADPCM) {
+            written = write_adpcm_frames(samples_to_write);
+        } else {
+            for (int i = 0; i < samples_to_write; i++) {
+                if (audio_read_ptr >= shared_ctrl->chunk_size) {
+                    alt_printf("Chunk %d completado (%d bytes)\n", 
+                              shared_ctrl->current_chunk, audio_read_ptr);
+                    request_next_chunk();
+                    break;
+                }
 
-            // Leer muestra stereo de 16 bits
-            uint16_t left_sample = *(uint16_t*)(shared_data + audio_read_ptr);
-            uint16_t right_sample = *(uint16_t*)(shared_data + audio_read_ptr + 2);
+                if (audio_read_ptr + 4 > shared_ctrl->chunk_size) {
+                    request_next_chunk();
+                    break;
+                }
 
-            // Convertir a 32-bit para codec
-            int32_t left_32 = (int32_t)((int16_t)left_sample) << 8;
-            int32_t right_32 = (int32_t)((int16_t)right_sample) << 8;
+                // Leer muestra stereo de 16 bits
+                uint16_t left_sample = *(uint16_t*)(shared_data + audio_read_ptr);
+                uint16_t right_sample = *(uint16_t*)(shared_data + audio_read_ptr + 2);
 
-            // Escribir al codec
-            if (alt_up_audio_write_fifo(audio_dev, (unsigned int*)&left_32, 1, ALT_UP_AUDIO_LEFT) == 0 &&
-                alt_up_audio_write_fifo(audio_dev, (unsigned int*)&right_32, 1, ALT_UP_AUDIO_RIGHT) == 0) {
-                audio_read_ptr += 4;
-            } else {
-                break;
+                // Convertir a 32-bit para codec
+                int32_t left_32 = (int32_t)((int16_t)left_sample) << 8;
+                int32_t right_32 = (int32_t)((int16_t)right_sample) << 8;
+
+                // Escribir al codec
+                if (alt_up_audio_write_fifo(audio_dev, (unsigned int*)&left_32, 1, ALT_UP_AUDIO_LEFT) == 1 &&
+                    alt_up_audio_write_fifo(audio_dev, (unsigned int*)&right_32, 1, ALT_UP_AUDIO_RIGHT) == 1) {
+                    audio_read_ptr += 4;
+                    written++;
+                } else {
+                    break;
+                }
             }
+            account_frames(written);
         }
 
         // Actualizar estadísticas
@@ -197,6 +803,35 @@ void process_audio_data(void) {
         
         shared_ctrl->error_flags &= ~0x01; // Limpiar buffer underrun
     }
+    return written;
+}
+
+// --- Ciclos por frame a la tasa actual del codec ---
+// Convierte ocupación del FIFO en tiempo. Tabla: sin divisor por hardware.
+static uint32_t cycles_per_frame(void) {
+    switch (codec_rate) {
+        case 8000:  return ALT_CPU_FREQ / 8000;
+        case 32000: return ALT_CPU_FREQ / 32000;
+        case 96000: return ALT_CPU_FREQ / 96000;
+        default:    return ALT_CPU_FREQ / 48000;
+    }
+}
+
+// --- Procesar datos de audio (instrumentado) ---
+// Latencia estimada: el FIFO vacía un frame cada cycles_per_frame(), así que
+// el espacio libre al entrar indica cuánto hace que hay lugar para escribir.
+void process_audio_data(void) {
+    uint32_t start = timestamp_ticks();
+    uint32_t space = alt_up_audio_write_fifo_space(audio_dev, ALT_UP_AUDIO_LEFT);
+
+    // Las pasadas sin nada que escribir no se registran: el loop las repite
+    // sin pausa y el registro costaría más que la pasada
+    if (fill_audio_fifo() == 0) {
+        return;
+    }
+
+    isr_stats_record(&isr_stats->sources[ISR_SRC_PROCESS].latency, space * cycles_per_frame());
+    isr_stats_record(&isr_stats->sources[ISR_SRC_PROCESS].duration, timestamp_ticks() - start);
 }
 
 // --- Interrupción Audio - USAR TU AUDIO_IRQ ---
@@ -204,7 +839,272 @@ static void audio_isr(void* context, alt_u32 id) {
     if (!is_playing || audio_dev == NULL)
         return;
 
+    // La IRQ se activa con BUF_THRESHOLD frames libres; lo que sobra es retardo
+    uint32_t start = timestamp_ticks();
+    uint32_t space = alt_up_audio_write_fifo_space(audio_dev, ALT_UP_AUDIO_LEFT);
+    uint32_t late_frames = (space > BUF_THRESHOLD) ? space - BUF_THRESHOLD : 0;
+
     process_audio_data();
+
+    isr_stats_record(&isr_stats->sources[ISR_SRC_AUDIO].latency, late_frames * cycles_per_frame());
+    isr_stats_record(&isr_stats->sources[ISR_SRC_AUDIO].duration, timestamp_ticks() - start);
+}
+
+// --- Grabación: vaciar los FIFOs de entrada al ring compartido ---
+// Un lote por llamada: una lectura de ocupación por canal y lecturas en bloque.
+void process_record_data(void) {
+    unsigned int left[RECORD_BATCH_FRAMES], right[RECORD_BATCH_FRAMES];
+    unsigned int avail_left = alt_up_audio_read_fifo_avail(audio_dev, ALT_UP_AUDIO_LEFT);
+    unsigned int avail_right = alt_up_audio_read_fifo_avail(audio_dev, ALT_UP_AUDIO_RIGHT);
+    unsigned int frames = (avail_left < avail_right) ? avail_left : avail_right;
+
+    if (frames == 0) {
+        return;
+    }
+    if (frames >= 128) {
+        shared_ctrl->rec_fifo_full++;   // FIFO lleno: el codec pudo haber descartado muestras
+    }
+    if (frames > RECORD_BATCH_FRAMES) {
+        frames = RECORD_BATCH_FRAMES;
+    }
+
+    frames = alt_up_audio_read_fifo(audio_dev, left, frames, ALT_UP_AUDIO_LEFT);
+    alt_up_audio_read_fifo(audio_dev, right, frames, ALT_UP_AUDIO_RIGHT);
+
+    // Si el HPS no vació el ring se descarta el lote (el FIFO igual se vacía)
+    uint32_t write_frames = shared_ctrl->rec_write_frames;
+    uint32_t used = write_frames - shared_ctrl->rec_read_frames;
+    if (used + frames > RECORD_RING_FRAMES) {
+        shared_ctrl->rec_dropped += frames;
+        return;
+    }
+
+    // Muestras de 24 bits del codec a 16 bits, L en la mitad baja
+    for (unsigned int i = 0; i < frames; i++) {
+        uint32_t l16 = (left[i] >> 8) & 0xFFFF;
+        uint32_t r16 = (right[i] >> 8) & 0xFFFF;
+        record_ring[record_ring_pos] = l16 | (r16 << 16);
+        record_ring_pos++;
+        if (record_ring_pos == RECORD_RING_FRAMES) {
+            record_ring_pos = 0;
+        }
+    }
+
+    shared_ctrl->rec_write_frames = write_frames + frames;
+}
+
+// --- Grabación: atender CMD_RECORD / CMD_RECORD_STOP del HPS ---
+void handle_record_command(void) {
+    uint32_t cmd = shared_ctrl->command;
+
+    if (cmd == CMD_RECORD && !is_recording) {
+        is_playing = 0;
+        record_ring_pos = 0;
+        shared_ctrl->rec_write_frames = 0;
+        shared_ctrl->rec_read_frames = 0;
+        shared_ctrl->rec_dropped = 0;
+        shared_ctrl->rec_fifo_full = 0;
+        if (shared_ctrl->sample_rate != codec_rate) {
+            codec_set_sample_rate(shared_ctrl->sample_rate);
+        }
+        alt_up_audio_reset_audio_core(audio_dev);   // Descartar muestras viejas
+        is_recording = 1;
+        shared_ctrl->status = STATUS_RECORDING;
+        shared_ctrl->command = CMD_NONE;
+        alt_printf("*** GRABANDO ***\n");
+    } else if (cmd == CMD_RECORD_STOP) {
+        is_recording = 0;
+        shared_ctrl->status = STATUS_READY;
+        shared_ctrl->command = CMD_NONE;
+        alt_printf("*** GRABACIÓN DETENIDA: %d frames, %d perdidos ***\n",
+                  shared_ctrl->rec_write_frames, shared_ctrl->rec_dropped);
+    }
+}
+
+// --- Latencia: pulso en la salida, detección en line-in ---
+// Las dos cuentas usan el reloj del codec: al escribir un pulso se anota el
+// índice del frame de entrada que se está capturando en ese momento, y la
+// latencia es la distancia hasta el frame de entrada donde aparece. Incluye
+// la cola del FIFO de salida (como en reproducción, se mantiene llena de
+// silencio) más el DAC, el cable y el ADC.
+static void run_latency_test(uint32_t seen_ticks) {
+    unsigned int silence[RECORD_BATCH_FRAMES], in_buf[RECORD_BATCH_FRAMES], discard[RECORD_BATCH_FRAMES];
+    uint32_t in_frames = 0;          // Frames leídos del FIFO de entrada
+    uint32_t in_mark = 0;            // Frame de entrada capturado al escribir el pulso
+    uint32_t pulse_left = 0;         // Frames del pulso pendientes de escribir
+    uint32_t silence_left = 0;       // Frames de silencio antes del próximo pulso
+    uint32_t detected = 0;
+    int waiting = 0;
+
+    for (int i = 0; i < RECORD_BATCH_FRAMES; i++) {
+        silence[i] = 0;
+    }
+
+    alt_up_audio_reset_audio_core(audio_dev);
+
+    while (detected + shared_ctrl->lat_timeouts < LATENCY_PULSES) {
+        // Salida: empezar un pulso o rellenar con silencio
+        unsigned int space = alt_up_audio_write_fifo_space(audio_dev, ALT_UP_AUDIO_LEFT);
+        if (!waiting && silence_left == 0 && pulse_left == 0 && space > 0) {
+            in_mark = in_frames + alt_up_audio_read_fifo_avail(audio_dev, ALT_UP_AUDIO_LEFT);
+            shared_ctrl->lat_queue_sum += 128 - space;
+            if (detected == 0 && shared_ctrl->lat_timeouts == 0) {
+                shared_ctrl->lat_cmd_ticks = timestamp_ticks() - seen_ticks;
+            }
+            pulse_left = LATENCY_PULSE_FRAMES;
+            waiting = 1;
+        }
+        if (space > RECORD_BATCH_FRAMES) {
+            space = RECORD_BATCH_FRAMES;
+        }
+        if (pulse_left > 0 && space > 0) {
+            unsigned int pulse[LATENCY_PULSE_FRAMES];
+            unsigned int n = (pulse_left < space) ? pulse_left : space;
+            for (unsigned int i = 0; i < n; i++) {
+                pulse[i] = LATENCY_PULSE_LEVEL;
+            }
+            alt_up_audio_write_fifo(audio_dev, pulse, n, ALT_UP_AUDIO_LEFT);
+            alt_up_audio_write_fifo(audio_dev, pulse, n, ALT_UP_AUDIO_RIGHT);
+            pulse_left -= n;
+        } else if (space > 0) {
+            unsigned int n = alt_up_audio_write_fifo(audio_dev, silence, space, ALT_UP_AUDIO_LEFT);
+            alt_up_audio_write_fifo(audio_dev, silence, n, ALT_UP_AUDIO_RIGHT);
+            silence_left = (silence_left > n) ? silence_left - n : 0;
+        }
+
+        // Entrada: buscar el flanco del pulso en L
+        unsigned int avail = alt_up_audio_read_fifo_avail(audio_dev, ALT_UP_AUDIO_LEFT);
+        if (avail > RECORD_BATCH_FRAMES) {
+            avail = RECORD_BATCH_FRAMES;
+        }
+        avail = alt_up_audio_read_fifo(audio_dev, in_buf, avail, ALT_UP_AUDIO_LEFT);
+        alt_up_audio_read_fifo(audio_dev, discard, avail, ALT_UP_AUDIO_RIGHT);
+
+        for (unsigned int i = 0; i < avail && waiting; i++) {
+            int32_t sample = (int32_t)(in_buf[i] << 8) >> 8;
+            // Lo que ya estaba en la FIFO antes del pulso no es eco: in_mark
+            // cuenta esas muestras, así que van antes de la marca
+            if ((int32_t)(in_frames + i - in_mark) < 0) {
+                continue;
+            }
+            if (sample > LATENCY_THRESHOLD || sample < -LATENCY_THRESHOLD) {
+                uint32_t latency = in_frames + i - in_mark;
+                if (detected == 0) {
+                    shared_ctrl->lat_first = latency;
+                    shared_ctrl->lat_min = latency;
+                }
+                if (latency < shared_ctrl->lat_min) shared_ctrl->lat_min = latency;
+                if (latency > shared_ctrl->lat_max) shared_ctrl->lat_max = latency;
+                shared_ctrl->lat_sum += latency;
+                detected++;
+                shared_ctrl->lat_pulses = detected;
+                waiting = 0;
+                silence_left = LATENCY_GAP_FRAMES;
+            }
+        }
+        in_frames += avail;
+
+        if (waiting && (int32_t)(in_frames - in_mark) > LATENCY_TIMEOUT_FRAMES) {
+            shared_ctrl->lat_timeouts++;
+            waiting = 0;
+            silence_left = LATENCY_GAP_FRAMES;
+        }
+
+        if (!check_hps_connection()) {
+            break;
+        }
+    }
+}
+
+// --- Latencia: atender CMD_LATENCY del HPS ---
+void handle_latency_command(void) {
+    if (shared_ctrl->command != CMD_LATENCY) {
+        return;
+    }
+
+    // Reprogramar el codec fuera de la medición del comando
+    if (shared_ctrl->sample_rate != codec_rate) {
+        codec_set_sample_rate(shared_ctrl->sample_rate);
+    }
+    uint32_t seen_ticks = timestamp_ticks();
+    is_playing = 0;
+    is_recording = 0;
+    shared_ctrl->lat_pulses = 0;
+    shared_ctrl->lat_timeouts = 0;
+    shared_ctrl->lat_min = 0;
+    shared_ctrl->lat_max = 0;
+    shared_ctrl->lat_sum = 0;
+    shared_ctrl->lat_queue_sum = 0;
+    shared_ctrl->lat_first = 0;
+    shared_ctrl->lat_cmd_ticks = 0;
+    shared_ctrl->status = STATUS_MEASURING;
+    shared_ctrl->command = CMD_NONE;
+
+    run_latency_test(seen_ticks);
+
+    alt_up_audio_reset_audio_core(audio_dev);
+    shared_ctrl->status = STATUS_READY;
+    alt_printf("*** LATENCIA: %d pulsos, min %d, max %d frames, %d perdidos ***\n",
+              shared_ctrl->lat_pulses, shared_ctrl->lat_min, shared_ctrl->lat_max,
+              shared_ctrl->lat_timeouts);
+}
+
+// --- Codec: escritura de un registro del WM8731 por I2C (AUDIO_CONFIG) ---
+static int codec_write(uint32_t reg, uint32_t value) {
+    for (int i = 0; i < CODEC_DRAIN_TIMEOUT; i++) {
+        if (alt_up_av_config_read_ready(av_config)) {
+            return alt_up_av_config_write_audio_cfg_register(av_config, reg, value);
+        }
+    }
+    return -1;
+}
+
+// Registro de muestreo (R8) para MCLK = 12.288 MHz, BOSR = 0, ADC y DAC a la misma tasa.
+// 44.1 kHz necesita MCLK de 11.2896 MHz: el HPS la convierte a 48 kHz.
+static int codec_sampling_value(uint32_t rate) {
+    switch (rate) {
+        case 8000:  return 0x0C;
+        case 32000: return 0x18;
+        case 48000: return 0x00;
+        case 96000: return 0x1C;
+        default:    return -1;
+    }
+}
+
+// --- Codec: cambiar la tasa de muestreo entre canciones ---
+// Secuencia: vaciar el FIFO de salida, soft mute, desactivar la interfaz
+// digital, escribir R8, reactivar, descartar los FIFOs y quitar el mute.
+int codec_set_sample_rate(uint32_t rate) {
+    int sampling = codec_sampling_value(rate);
+    if (sampling < 0 || av_config == NULL) {
+        alt_printf("⚠ Tasa no soportada por el codec: %d Hz\n", rate);
+        return -1;
+    }
+
+    // Lo que queda en el FIFO es el final de la canción anterior, a la tasa vieja
+    for (int i = 0; i < CODEC_DRAIN_TIMEOUT; i++) {
+        if (alt_up_audio_write_fifo_space(audio_dev, ALT_UP_AUDIO_LEFT) >= 128) {
+            break;
+        }
+    }
+
+    int result = codec_write(WM8731_DAC_PATH, WM8731_DAC_PATH_MUTE);
+    usleep(WM8731_MUTE_US);
+    result |= codec_write(WM8731_ACTIVE, 0);
+    result |= codec_write(WM8731_SAMPLING, sampling);
+    result |= codec_write(WM8731_ACTIVE, 1);
+    alt_up_audio_reset_audio_core(audio_dev);
+    result |= codec_write(WM8731_DAC_PATH, WM8731_DAC_PATH_PLAY);
+
+    if (result != 0) {
+        alt_printf("ERROR: Escritura I2C al codec falló\n");
+        return -1;
+    }
+    // Cambio a mitad de canción (fallback de alta tasa): conservar el tiempo reproducido
+    song_frames = (uint32_t)(((uint64_t)song_frames * rate) / codec_rate);
+    codec_rate = rate;
+    alt_printf("✓ Codec a %d Hz\n", rate);
+    return 0;
 }
 
 // --- Enviar comando al HPS ---
@@ -220,7 +1120,6 @@ void send_command_to_hps(uint32_t cmd) {
 
 // --- Display 7 segmentos ---
 void update_seven_segment_display(void) {
-    volatile unsigned int * sevenseg = (unsigned int *) SEVEN_SEGMENTS_BASE;
     unsigned char min_tens = elapsed_minutes / 10;
     unsigned char min_ones = elapsed_minutes % 10;
     unsigned char sec_tens = elapsed_seconds / 10;
@@ -232,15 +1131,16 @@ void update_seven_segment_display(void) {
         ((unsigned int)seven_seg_patterns[sec_tens] << 7)  |
         ((unsigned int)seven_seg_patterns[sec_ones]);
 
-    *sevenseg = display_value;
+    IOWR(SEVEN_SEGMENTS_BASE, 0, display_value);
 }
 
-// --- Manejar botones - USAR TU BUTTONS_BASE ---
+// --- Manejar botones capturados por buttons_isr ---
 void handle_buttons(void) {
-    static int prev_button_state = 0x7;
-    volatile unsigned int * button_ptr = (unsigned int *) BUTTONS_BASE;
-    int button_state = *button_ptr;
-    int button_pressed = (~button_state) & prev_button_state;
+    // Tomar y borrar las pulsaciones capturadas por el ISR (sin acceso al PIO)
+    alt_irq_context context = alt_irq_disable_all();
+    int button_pressed = buttons_pending;
+    buttons_pending = 0;
+    alt_irq_enable_all(context);
 
     if (button_pressed & 0x1) { // KEY0: Play/Pause
         if (!check_hps_connection()) {
@@ -268,7 +1168,7 @@ void handle_buttons(void) {
         }
 
         send_command_to_hps(CMD_NEXT);
-        elapsed_ms = 0;
+        song_frames = 0;
         elapsed_seconds = 0;
         elapsed_minutes = 0;
         audio_read_ptr = 0;
@@ -283,7 +1183,7 @@ void handle_buttons(void) {
         }
 
         send_command_to_hps(CMD_PREV);
-        elapsed_ms = 0;
+        song_frames = 0;
         elapsed_seconds = 0;
         elapsed_minutes = 0;
         audio_read_ptr = 0;
@@ -291,7 +1191,6 @@ void handle_buttons(void) {
         alt_printf("*** ANTERIOR ***\n");
     }
 
-    prev_button_state = button_state;
 }
 
 int main(void) {
@@ -318,6 +1217,12 @@ int main(void) {
     }
     alt_printf("✓ Audio device: %s OK\n", AUDIO_NAME);
 
+    // Configuración del codec: la tasa se reprograma por canción
+    av_config = alt_up_av_config_open_dev(AUDIO_CONFIG_NAME);
+    if (av_config == NULL) {
+        alt_printf("⚠ No se pudo abrir %s, el codec queda a %d Hz\n", AUDIO_CONFIG_NAME, SAMPLE_RATE);
+    }
+
     // Limpiar memoria compartida
     for (int i = 0; i < sizeof(compact_shared_control_t)/4; i++) {
         ((volatile uint32_t*)shared_ctrl)[i] = 0;
@@ -344,12 +1249,23 @@ int main(void) {
     shared_ctrl->error_flags = 0;
     shared_ctrl->bytes_played = 0;
     shared_ctrl->chunks_loaded = 0;
+    shared_ctrl->sample_format = SAMPLE_FORMAT_PCM16;
+    shared_ctrl->decode_cycles = 0;
+    shared_ctrl->decode_cycles_max = 0;
+    shared_ctrl->ticks_freq = TIMER_FREQ;
 
     alt_printf("✓ Estructura inicializada:\n");
     alt_printf("  Magic: 0x%x\n", shared_ctrl->magic);
     alt_printf("  Sample Rate: %d Hz\n", shared_ctrl->sample_rate);
     alt_printf("  Channels: %d\n", shared_ctrl->channels);
 
+    // Perfil estadístico e histogramas de ISR en la memoria compartida
+    // (los lee el HPS con --profile / --isr-stats)
+    profile_init();
+    isr_stats_init();
+    alt_printf("✓ Perfil: .text 0x%x - 0x%x, %d buckets\n",
+              profile->text_start, profile->text_end, profile->num_buckets);
+
     // Registrar interrupciones usando valores de system.h
     if (alt_irq_register(TIMER_IRQ, NULL, timer_isr) != 0) {
         alt_printf("ERROR: Timer IRQ %d registro falló\n", TIMER_IRQ);
@@ -360,16 +1276,36 @@ int main(void) {
         alt_printf("ERROR: Audio IRQ %d registro falló\n", AUDIO_IRQ);
         return -1;
     }
-    alt_printf("✓ IRQs registradas: Timer=%d, Audio=%d\n", TIMER_IRQ, AUDIO_IRQ);
+
+    if (alt_irq_register(BUTTONS_IRQ, NULL, buttons_isr) != 0) {
+        alt_printf("ERROR: Buttons IRQ %d registro falló\n", BUTTONS_IRQ);
+        return -1;
+    }
+    alt_printf("✓ IRQs registradas: Timer=%d, Audio=%d, Botones=%d\n", TIMER_IRQ, AUDIO_IRQ, BUTTONS_IRQ);
+
+#ifdef PROFILE_TIMER_BASE
+    if (alt_irq_register(PROFILE_TIMER_IRQ, NULL, profile_timer_isr) != 0) {
+        alt_printf("ERROR: Profile timer IRQ %d registro falló\n", PROFILE_TIMER_IRQ);
+        return -1;
+    }
+#endif
+
+    // Botones: limpiar flancos viejos y habilitar IRQ por flanco de bajada
+    IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTONS_BASE, BUTTONS_ALL);
+    IOWR_ALTERA_AVALON_PIO_IRQ_MASK(BUTTONS_BASE, BUTTONS_ALL);
 
     // Configurar Timer (ya está configurado para 500ms según system.h)
-    volatile unsigned int* timer_control = (unsigned int*)(TIMER_BASE + 4);
-    *timer_control = 0x7; // Start, continuous, interrupt enable
+    IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER_BASE, 0x7); // Start, continuous, interrupt enable
     alt_printf("✓ Timer configurado: Base=0x%x, Period=%dms\n", TIMER_BASE, TIMER_PERIOD);
 
+#ifdef PROFILE_TIMER_BASE
+    IOWR_ALTERA_AVALON_TIMER_CONTROL(PROFILE_TIMER_BASE, 0x7);
+    alt_printf("✓ Timer de perfil: Base=0x%x, Period=%dms\n", PROFILE_TIMER_BASE, PROFILE_TIMER_PERIOD);
+#endif
+
     // Inicializar variables
     is_playing = 0;
-    elapsed_ms = 0;
+    song_frames = 0;
     elapsed_seconds = 0;
     elapsed_minutes = 0;
     audio_read_ptr = 0;
@@ -394,12 +1330,28 @@ int main(void) {
     while (1) {
         handle_buttons();
 
+        // Chunk de una canción a otra tasa: reprogramar el codec antes de tocar el FIFO
+        if (shared_ctrl->chunk_ready && shared_ctrl->sample_rate != codec_rate &&
+            check_hps_connection()) {
+            if (codec_set_sample_rate(shared_ctrl->sample_rate) != 0) {
+                shared_ctrl->error_flags |= 0x04;
+                shared_ctrl->sample_rate = codec_rate;
+            }
+        }
+
         if (is_playing && check_hps_connection()) {
             process_audio_data();
         }
 
-        // Debug cada 10 segundos
-        if ((loop_counter % 100000) == 0) {
+        handle_record_command();
+        handle_latency_command();
+        if (is_recording) {
+            process_record_data();
+        }
+
+        // Debug cada 10 segundos (no al grabar: el JTAG UART puede bloquear
+        // más de lo que aguantan los FIFOs de entrada)
+        if ((loop_counter % 100000) == 0 && !is_recording) {
             alt_printf("=== ESTADO (loop %d) ===\n", loop_counter);
             alt_printf("HPS: %d | Magic: 0x%x | Estado: %d\n", 
                       shared_ctrl->hps_connected, shared_ctrl->magic, shared_ctrl->status);
@@ -412,6 +1364,11 @@ int main(void) {
                       shared_ctrl->fpga_heartbeat, is_playing, elapsed_minutes, elapsed_seconds);
             alt_printf("Errores: 0x%x | Bytes: %d\n", 
                       shared_ctrl->error_flags, shared_ctrl->bytes_played);
+            if (shared_ctrl->sample_format == SAMPLE_FORMAT_ADPCM) {
+                alt_printf("ADPCM: %d ciclos/frame | Peor lote: %d | Presupuesto: %d\n",
+                          shared_ctrl->decode_cycles, shared_ctrl->decode_cycles_max,
+                          ALT_CPU_FREQ / SAMPLE_RATE);
+            }
             alt_printf("========================\n");
         }
 
@@ -424,7 +1381,7 @@ int main(void) {
                           shared_ctrl->song_id, shared_ctrl->total_chunks, shared_ctrl->song_total_size);
                 
                 audio_read_ptr = 0;
-                elapsed_ms = 0;
+                song_frames = 0;
                 elapsed_seconds = 0;
                 elapsed_minutes = 0;
                 shared_ctrl->error_flags = 0;
@@ -432,6 +1389,7 @@ int main(void) {
             } else {
                 alt_printf("*** HPS DESCONECTADO ***\n");
                 is_playing = 0;
+                is_recording = 0;
                 shared_ctrl->status = STATUS_READY;
                 shared_ctrl->error_flags |= 0x02;
             }